@@ -0,0 +1,87 @@
+/-
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+import Lean
+open System
+
+/-!
+Maintenance of the persistent kernel check cache (see `Lean.Kernel.setCheckCacheDir`).
+
+Usage: `lean --run script/kernelCheckCache.lean <command> <dir>` where `<command>` is
+* `stats`: print the number of valid, stale (written by a different Lean commit) and invalid entries
+  (e.g., truncated, or whose recorded key does not match the file name);
+* `verify`: remove invalid entries and leftover temporary files;
+* `evict-stale`: remove stale and invalid entries;
+* `evict-all`: remove all entries.
+-/
+
+def magic := "lean-kernel-check-cache 2"
+
+def isKey (s : String) : Bool :=
+  s.length == 64 && s.all fun c => c.isDigit || ('a' ≤ c && c ≤ 'f')
+
+inductive Status where
+  | valid | stale | invalid
+  deriving BEq
+
+/-- Entries of the cache, and files that are not entries (e.g., leftover temporary files). -/
+def collect (dir : FilePath) : IO (Array FilePath × Array FilePath) := do
+  let mut entries := #[]
+  let mut others := #[]
+  for sub in (← dir.readDir) do
+    if (← sub.path.isDir) then
+      for e in (← sub.path.readDir) do
+        if isKey e.fileName && e.fileName.take 2 == sub.fileName then
+          entries := entries.push e.path
+        else
+          others := others.push e.path
+    else
+      others := others.push sub.path
+  return (entries, others)
+
+def status (entry : FilePath) : IO Status := do
+  match (← IO.FS.readFile entry).splitOn "\n" with
+  | m :: k :: h :: n :: _ =>
+    if m != magic || k != entry.fileName.getD "" || n.isEmpty then
+      return .invalid
+    else if h == Lean.githash then
+      return .valid
+    else
+      return .stale
+  | _ => return .invalid
+
+def main (args : List String) : IO UInt32 := do
+  let (cmd, dir) ← match args with
+    | [cmd, dir] => pure (cmd, (dir : FilePath))
+    | _ =>
+      IO.eprintln "usage: lean --run kernelCheckCache.lean (stats|verify|evict-stale|evict-all) <dir>"
+      return 1
+  let (entries, others) ← collect dir
+  let mut valid := 0
+  let mut stale := 0
+  let mut invalid := 0
+  let mut removed := 0
+  for e in entries do
+    let s ← status e
+    match s with
+    | .valid => valid := valid + 1
+    | .stale => stale := stale + 1
+    | .invalid => invalid := invalid + 1
+    let remove := match cmd, s with
+      | "verify", .invalid => true
+      | "evict-stale", .valid => false
+      | "evict-stale", _ => true
+      | "evict-all", _ => true
+      | _, _ => false
+    if remove then
+      IO.FS.removeFile e
+      removed := removed + 1
+  if cmd != "stats" then
+    for o in others do
+      IO.FS.removeFile o
+      removed := removed + 1
+  IO.println s!"{valid} valid, {stale} stale, {invalid} invalid entries, {others.size} other files"
+  unless cmd == "stats" do
+    IO.println s!"{removed} files removed"
+  return 0
@@ -478,9 +478,9 @@ def emitExternDeclAux (decl : Decl) (cNameStr : String) : M llvmctx Unit := do
   let extC := isExternC env decl.name
   let _ ← emitFnDeclAux (← getLLVMModule) decl cNameStr extC
 
-def emitFnDecls : M llvmctx Unit := do
+/-- Emit the declarations of `decls` and of the functions they use. -/
+def emitFnDeclsOf (decls : List Decl) : M llvmctx Unit := do
   let env ← getEnv
-  let decls := getDecls env
   let modDecls  : NameSet := decls.foldl (fun s d => s.insert d.name) {}
   let usedDecls : NameSet := decls.foldl (fun s d => collectUsedDecls env d (s.insert d.name)) {}
   let usedDecls := usedDecls.toList
@@ -491,6 +491,9 @@ def emitFnDecls : M llvmctx Unit := do
     | none       => emitFnDecl decl (!modDecls.contains n)
   return ()
 
+def emitFnDecls : M llvmctx Unit := do
+  emitFnDeclsOf (getDecls (← getEnv))
+
 def emitLhsSlot_ (x : VarId) : M llvmctx (LLVM.LLVMType llvmctx × LLVM.Value llvmctx) := do
   let state ← get
   match state.var2val.find? x with
@@ -1536,6 +1539,12 @@ def main : M llvmctx Unit := do
   emitFns (← getLLVMModule) builder
   emitInitFn (← getLLVMModule) builder
   emitMainFnIfNeeded (← getLLVMModule) builder
+
+/-- Emit the functions `decls`, without a module initializer. Used by the interpreter for compiling functions just in time. -/
+def emitJIT (decls : List Decl) : M llvmctx Unit := do
+  emitFnDeclsOf decls
+  let builder ← LLVM.createBuilderInContext llvmctx
+  decls.forM (emitDecl (← getLLVMModule) builder)
 end EmitLLVM
 
 def getLeanHBcPath : IO System.FilePath := do
@@ -1564,6 +1573,33 @@ partial def getModuleFunctions (mod : LLVM.Module llvmctx) : IO (Array (LLVM.Val
     else go (← LLVM.getNextFunction v) (acc.push v)
   go (← LLVM.getFirstFunction mod) #[]
 
+/-- Link the inline functions of `lean.h` into `mod`, with internal linkage. -/
+def linkLeanRuntime (mod : LLVM.Module llvmctx) : IO Unit := do
+  let membuf ← LLVM.createMemoryBufferWithContentsOfFile (← getLeanHBcPath).toString
+  let modruntime ← LLVM.parseBitcode llvmctx membuf
+  /- It is important that we extract the names here because
+     pointers into modruntime get invalidated by linkModules -/
+  let runtimeGlobals ← (← getModuleGlobals modruntime).mapM (·.getName)
+  let filter func := do
+    -- | Do not insert internal linkage for
+    -- intrinsics such as `@llvm.umul.with.overflow.i64` which clang generates, and also
+    -- for declarations such as `lean_inc_ref_cold` which are externally defined.
+    if (← LLVM.isDeclaration func) then
+      return none
+    else
+      return some (← func.getName)
+  let runtimeFunctions ← (← getModuleFunctions modruntime).filterMapM filter
+  LLVM.linkModules (dest := mod) (src := modruntime)
+  -- Mark every global and function as having internal linkage.
+  for name in runtimeGlobals do
+    let some global ← LLVM.getNamedGlobal mod name
+       | throw <| IO.Error.userError s!"ERROR: linked module must have global from runtime module: '{name}'"
+    LLVM.setLinkage global LLVM.Linkage.internal
+  for name in runtimeFunctions do
+    let some fn ← LLVM.getNamedFunction mod name
+       | throw <| IO.Error.userError s!"ERROR: linked module must have function from runtime module: '{name}'"
+    LLVM.setLinkage fn LLVM.Linkage.internal
+
 /--
 `emitLLVM` is the entrypoint for the lean shell to code generate LLVM.
 -/
@@ -1577,31 +1613,7 @@ def emitLLVM (env : Environment) (modName : Name) (filepath : String) (tripleStr
   let out? ← ((EmitLLVM.main (llvmctx := llvmctx)).run initState).run emitLLVMCtx
   match out? with
   | .ok _ => do
-         let membuf ← LLVM.createMemoryBufferWithContentsOfFile (← getLeanHBcPath).toString
-         let modruntime ← LLVM.parseBitcode llvmctx membuf
-         /- It is important that we extract the names here because
-            pointers into modruntime get invalidated by linkModules -/
-         let runtimeGlobals ← (← getModuleGlobals modruntime).mapM (·.getName)
-         let filter func := do
-           -- | Do not insert internal linkage for
-           -- intrinsics such as `@llvm.umul.with.overflow.i64` which clang generates, and also
-           -- for declarations such as `lean_inc_ref_cold` which are externally defined.
-           if (← LLVM.isDeclaration func) then
-             return none
-           else
-             return some (← func.getName)
-         let runtimeFunctions ← (← getModuleFunctions modruntime).filterMapM filter
-         LLVM.linkModules (dest := emitLLVMCtx.llvmmodule) (src := modruntime)
-         -- Mark every global and function as having internal linkage.
-         for name in runtimeGlobals do
-           let some global ← LLVM.getNamedGlobal emitLLVMCtx.llvmmodule name
-              | throw <| IO.Error.userError s!"ERROR: linked module must have global from runtime module: '{name}'"
-           LLVM.setLinkage global LLVM.Linkage.internal
-         for name in runtimeFunctions do
-           let some fn ← LLVM.getNamedFunction emitLLVMCtx.llvmmodule name
-              | throw <| IO.Error.userError s!"ERROR: linked module must have function from runtime module: '{name}'"
-           LLVM.setLinkage fn LLVM.Linkage.internal
-
+         linkLeanRuntime emitLLVMCtx.llvmmodule
          optimizeLLVMModule emitLLVMCtx.llvmmodule
          LLVM.writeBitcodeToFile emitLLVMCtx.llvmmodule filepath
          let tripleStr := tripleStr?.getD (← LLVM.getDefaultTargetTriple)
@@ -1614,4 +1626,33 @@ def emitLLVM (env : Environment) (modName : Name) (filepath : String) (tripleStr
          LLVM.disposeModule emitLLVMCtx.llvmmodule
          LLVM.disposeTargetMachine targetMachine
   | .error err => throw (IO.Error.userError err)
+
+/--
+`emitLLVMJIT` is the entrypoint for the interpreter to compile the IR functions `fns` just in time
+(see `ir_jit.cpp`). The functions they use that are not in `fns` are only declared, so they must be
+available in the JIT already. Returns the LLVM context and module, which are owned by the caller.
+-/
+@[export lean_ir_emit_llvm_jit]
+def emitLLVMJIT (env : Environment) (fns : Array Name) : IO (USize × USize) := do
+  LLVM.llvmInitializeTargetInfo
+  let llvmctx ← LLVM.createContext
+  let module ← LLVM.createModule llvmctx "jit"
+  let emitLLVMCtx : EmitLLVM.Context llvmctx := {env := env, modName := `jit, llvmmodule := module}
+  let initState := { var2val := default, jp2bb := default : EmitLLVM.State llvmctx}
+  try
+    let decls ← fns.mapM fun fn => match findEnvDecl env fn with
+      | some decl => pure decl
+      | none      => throw <| IO.Error.userError s!"unknown declaration '{fn}'"
+    let out? ← ((EmitLLVM.emitJIT decls.toList (llvmctx := llvmctx)).run initState).run emitLLVMCtx
+    match out? with
+    | .ok _ => do
+           linkLeanRuntime module
+           optimizeLLVMModule module
+    | .error err => throw (IO.Error.userError err)
+  catch e =>
+    -- the caller only owns the context and module if we succeed
+    LLVM.disposeModule module
+    LLVM.disposeContext llvmctx
+    throw e
+  return (llvmctx.ptr, module.ptr)
 end Lean.IR
@@ -97,6 +97,9 @@ opaque llvmInitializeTargetInfo : BaseIO (Unit)
 @[extern "lean_llvm_create_context"]
 opaque createContext : BaseIO (Context)
 
+@[extern "lean_llvm_dispose_context"]
+opaque disposeContext (ctx : Context) : BaseIO Unit
+
 @[extern "lean_llvm_create_module"]
 opaque createModule (ctx : Context) (name : @&String) : BaseIO (Module ctx)
 
@@ -282,14 +282,27 @@ def Exception.isMaxHeartbeat (ex : Exception) : Bool :=
 def mkArrow (d b : Expr) : CoreM Expr :=
   return Lean.mkForall (← mkFreshUserName `x) BinderInfo.default d b
 
+register_builtin_option kernel.stats : Bool := {
+  defValue := false
+  group    := "profiler"
+  descr    := "report the performance counters of the kernel (calls and cache hits of whnf and type inference, constants unfolded by lazy delta reduction, etc.) for each declaration"
+}
+
 def addDecl (decl : Declaration) : CoreM Unit := do
   profileitM Exception "type checking" (← getOptions) do
     withTraceNode `Kernel (fun _ => return m!"typechecking declaration") do
       if !(← MonadLog.hasErrors) && decl.hasSorry then
         logWarning "declaration uses 'sorry'"
-      match (← getEnv).addDecl decl with
-      | Except.ok    env => setEnv env
-      | Except.error ex  => throwKernelException ex
+      if kernel.stats.get (← getOptions) then
+        match (← getEnv).addDeclWithStats decl with
+        | Except.ok (env, stats) =>
+          setEnv env
+          logInfo m!"kernel statistics\n{stats}"
+        | Except.error ex => throwKernelException ex
+      else
+        match (← getEnv).addDecl decl with
+        | Except.ok    env => setEnv env
+        | Except.error ex  => throwKernelException ex
 
 private def supportedRecursors :=
   #[``Empty.rec, ``False.rec, ``Eq.ndrec, ``Eq.rec, ``Eq.recOn, ``Eq.casesOn, ``False.casesOn, ``Empty.casesOn, ``And.rec, ``And.casesOn]
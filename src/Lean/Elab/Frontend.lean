@@ -99,6 +99,7 @@ def runFrontend
     (mainModuleName : Name)
     (trustLevel : UInt32 := 0)
     (ileanFileName? : Option String := none)
+    (keepUnchangedOutputs := false)
     : IO (Environment × Bool) := do
   let inputCtx := Parser.mkInputContext input fileName
   let (header, parserState, messages) ← Parser.parseHeader inputCtx
@@ -118,7 +119,16 @@ def runFrontend
     let trees := s.commandState.infoState.trees.toArray
     let references := Lean.Server.findModuleRefs inputCtx.fileMap trees (localVars := false)
     let ilean := { module := mainModuleName, references : Lean.Server.Ilean }
-    IO.FS.writeFile ileanFileName $ Json.compress $ toJson ilean
+    let contents := Json.compress $ toJson ilean
+    -- Do not touch an unchanged file if requested by a build system comparing contents,
+    -- see `saveModuleData`
+    let unchanged ← do
+      if keepUnchangedOutputs && (← System.FilePath.pathExists ileanFileName) then
+        pure ((← IO.FS.readFile ileanFileName) == contents)
+      else
+        pure false
+    unless unchanged do
+      IO.FS.writeFile ileanFileName contents
 
   pure (s.commandState.env, !s.commandState.messages.hasErrors)
 
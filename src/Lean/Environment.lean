@@ -12,6 +12,7 @@ import Lean.Util.Path
 import Lean.Util.FindExpr
 import Lean.Util.Profile
 import Lean.Util.InstantiateLevelParams
+import Lean.Data.Json.FromToJson
 
 namespace Lean
 /-- Opaque environment extension state. -/
@@ -203,6 +204,17 @@ private def getTrustLevel (env : Environment) : UInt32 :=
 def getModuleIdxFor? (env : Environment) (declName : Name) : Option ModuleIdx :=
   env.const2ModIdx.find? declName
 
+@[export lean_environment_is_imported_const]
+private def isImportedConst (env : Environment) (declName : Name) : Bool :=
+  env.const2ModIdx.contains declName
+
+/--
+  Used by the kernel to identify environments with the same imports: the regions are only set at import time. Unlike
+  `const2ModIdx`, the array only has one entry per imported module, so it is cheap to mark as multi-threaded. -/
+@[export lean_environment_imports_key]
+private def importsKey (env : Environment) : Array CompactedRegion :=
+  env.header.regions
+
 def isConstructor (env : Environment) (declName : Name) : Bool :=
   match env.find? declName with
   | ConstantInfo.ctorInfo _ => true
@@ -232,12 +244,71 @@ inductive KernelException where
   | deepRecursion
   | interrupted
 
+/-- Performance counters of the kernel type checker for one declaration. See `Environment.addDeclWithStats`. -/
+structure Kernel.Stats where
+  inferTypeCalls        : Nat := 0
+  inferTypeCacheHits    : Nat := 0
+  inferTypeCacheMisses  : Nat := 0
+  whnfCoreCalls         : Nat := 0
+  whnfCoreCacheHits     : Nat := 0
+  whnfCoreCacheMisses   : Nat := 0
+  whnfCalls             : Nat := 0
+  whnfCacheHits         : Nat := 0
+  whnfCacheMisses       : Nat := 0
+  isDefEqCoreCalls      : Nat := 0
+  /-- Number of definitional equality problems skipped because they had already failed. -/
+  failedBeforeHits      : Nat := 0
+  /-- Number of `Nat` operations reduced using literal arithmetic. -/
+  reduceNatHits         : Nat := 0
+  /-- Number of subterms of cached results replaced with an existing structurally equal term (`LEAN_KERNEL_HASH_CONS`). -/
+  hashConsHits          : Nat := 0
+  /-- Number of new terms added to the hash-consing table. -/
+  hashConsMisses        : Nat := 0
+  /-- Number of bound variable instantiations. -/
+  instantiateCalls      : Nat := 0
+  /-- Number of times each constant was unfolded by lazy delta reduction. -/
+  unfoldings            : Array (Name × Nat) := #[]
+  deriving Inhabited
+
+/-- Human-readable summary of `s`, listing the `maxUnfoldings` constants that were unfolded most often. -/
+def Kernel.Stats.toString (s : Kernel.Stats) (maxUnfoldings := 10) : String := Id.run do
+  let mut out :=
+    s!"infer_type: {s.inferTypeCalls} calls, {s.inferTypeCacheHits} cache hits, {s.inferTypeCacheMisses} cache misses\n" ++
+    s!"whnf_core: {s.whnfCoreCalls} calls, {s.whnfCoreCacheHits} cache hits, {s.whnfCoreCacheMisses} cache misses\n" ++
+    s!"whnf: {s.whnfCalls} calls, {s.whnfCacheHits} cache hits, {s.whnfCacheMisses} cache misses\n" ++
+    s!"is_def_eq_core: {s.isDefEqCoreCalls} calls, {s.failedBeforeHits} failed before hits\n" ++
+    s!"reduce_nat: {s.reduceNatHits} hits\n" ++
+    s!"hash_cons: {s.hashConsHits} hits, {s.hashConsMisses} misses\n" ++
+    s!"instantiate: {s.instantiateCalls} calls"
+  let unfoldings := s.unfoldings.qsort fun a b => a.2 > b.2 || (a.2 == b.2 && Name.quickLt a.1 b.1)
+  unless unfoldings.isEmpty do
+    out := out ++ s!"\nlazy delta unfoldings ({unfoldings.size} constants):"
+    for (declName, n) in unfoldings[:maxUnfoldings] do
+      out := out ++ s!"\n  {declName}: {n}"
+  return out
+
+instance : ToString Kernel.Stats := ⟨(Kernel.Stats.toString ·)⟩
+
 namespace Environment
 
 /-- Type check given declaration and add it to the environment -/
 @[extern "lean_add_decl"]
 opaque addDecl (env : Environment) (decl : @& Declaration) : Except KernelException Environment
 
+/--
+Add given declaration to the environment without type checking it.
+Inductive declarations are still checked, since the kernel generates their auxiliary declarations.
+-/
+@[extern "lean_add_decl_without_checking"]
+opaque addDeclWithoutChecking (env : Environment) (decl : @& Declaration) : Except KernelException Environment
+
+instance : Nonempty (Environment × Kernel.Stats) :=
+  let ⟨env⟩ := (inferInstance : Nonempty Environment); ⟨(env, {})⟩
+
+/-- Like `addDecl`, but also returns the performance counters of the kernel for `decl`. -/
+@[extern "lean_add_decl_with_stats"]
+opaque addDeclWithStats (env : Environment) (decl : @& Declaration) : Except KernelException (Environment × Kernel.Stats)
+
 end Environment
 
 namespace ConstantInfo
@@ -622,11 +693,23 @@ def contains [Inhabited α] (ext : MapDeclarationExtension α) (env : Environmen
 
 end MapDeclarationExtension
 
+/--
+Save `data` to the .olean file `fname`. If `keepUnchanged` is set and `fname` already has the same contents, it is
+not rewritten, so that its modification time is preserved. This must only be requested on behalf of build systems
+that compare contents (e.g. Lake in its default mode): for the ones comparing modification times (`lake --old`,
+`leanmake`), the file would remain older than its changed source, and would be rebuilt again and again. -/
 @[extern "lean_save_module_data"]
-opaque saveModuleData (fname : @& System.FilePath) (mod : @& Name) (data : @& ModuleData) : IO Unit
+opaque saveModuleData (fname : @& System.FilePath) (mod : @& Name) (data : @& ModuleData) (keepUnchanged : Bool := false) : IO Unit
 @[extern "lean_read_module_data"]
 opaque readModuleData (fname : @& System.FilePath) : IO (ModuleData × CompactedRegion)
 
+/--
+Request the given memory-mapped regions to be read ahead in the given order, if enabled
+by the environment variable `LEAN_OLEAN_PREFETCH=background`. See `module.cpp`.
+-/
+@[extern "lean_prefetch_module_regions"]
+opaque prefetchModuleRegions (regions : @& Array CompactedRegion) : IO Unit
+
 /--
   Free compacted regions of imports. No live references to imported objects may exist at the time of invocation; in
   particular, `env` should be the last reference to any `Environment` derived from these imports. -/
@@ -663,8 +746,8 @@ def mkModuleData (env : Environment) : IO ModuleData := do
   }
 
 @[export lean_write_module]
-def writeModule (env : Environment) (fname : System.FilePath) : IO Unit := do
-  saveModuleData fname env.mainModule (← mkModuleData env)
+def writeModule (env : Environment) (fname : System.FilePath) (keepUnchanged := false) : IO Unit := do
+  saveModuleData fname env.mainModule (← mkModuleData env) keepUnchanged
 
 /--
 Construct a mapping from persistent extension name to entension index at the array of persistent extensions.
@@ -708,7 +791,32 @@ private def setImportedEntries (env : Environment) (mods : Array ModuleData) (st
 /-- "Forward declaration" for retrieving the number of builtin attributes. -/
 @[extern 1 "lean_get_num_attributes"] opaque getNumBuiltinAttributes : IO Nat
 
-private partial def finalizePersistentExtensions (env : Environment) (mods : Array ModuleData) (opts : Options) : IO Environment := do
+register_builtin_option profiler.importTrace : String := {
+  defValue := ""
+  group    := "profiler"
+  descr    := "write the cost of importing each module and of finalizing each persistent environment extension to the given file, in JSON Lines format. It can also be set using the environment variable `LEAN_IMPORT_TRACE`"
+}
+
+/--
+Open the file selected by `profiler.importTrace` or `LEAN_IMPORT_TRACE`, if any. The file is opened in append mode,
+so that the processes of a parallel build can share it, see `writeImportTraceRecord`. -/
+private def openImportTrace? (opts : Options) : IO (Option IO.FS.Handle) := do
+  let mut file := profiler.importTrace.get opts
+  if file.isEmpty then
+    file := (← IO.getEnv "LEAN_IMPORT_TRACE").getD ""
+  if file.isEmpty then
+    return none
+  return some (← IO.FS.Handle.mk file .append)
+
+/--
+Write a record to the import trace. Each record is written and flushed at once, so that records of concurrent
+processes are not interleaved. -/
+private def writeImportTraceRecord (h : IO.FS.Handle) (fields : List (String × Json)) : IO Unit := do
+  h.putStr <| Json.compress (Json.mkObj fields) ++ "\n"
+  h.flush
+
+private partial def finalizePersistentExtensions (env : Environment) (mods : Array ModuleData) (opts : Options)
+    (trace? : Option IO.FS.Handle := none) : IO Environment := do
   loop 0 env
 where
   loop (i : Nat) (env : Environment) : IO Environment := do
@@ -719,7 +827,17 @@ where
       let s := extDescr.toEnvExtension.getState env
       let prevSize := (← persistentEnvExtensionsRef.get).size
       let prevAttrSize ← getNumBuiltinAttributes
+      let start ← IO.monoNanosNow
       let newState ← extDescr.addImportedFn s.importedEntries { env := env, opts := opts }
+      if let some h := trace? then
+        let numEntries := s.importedEntries.foldl (init := 0) fun n es => n + es.size
+        let ns := (← IO.monoNanosNow) - start
+        writeImportTraceRecord h [
+          ("event", toJson "extension"),
+          ("extension", toJson extDescr.name),
+          ("entries", toJson numEntries),
+          ("ns", toJson ns)
+        ]
       let mut env := extDescr.toEnvExtension.setState env { s with state := newState }
       env ← ensureExtensionsArraySize env
       if (← persistentEnvExtensionsRef.get).size > prevSize || (← getNumBuiltinAttributes) > prevAttrSize then
@@ -738,6 +856,10 @@ structure ImportState where
   moduleNames   : Array Name := #[]
   moduleData    : Array ModuleData := #[]
   regions       : Array CompactedRegion := #[]
+  /-- .olean file of each module in `moduleNames`. -/
+  moduleFiles   : Array System.FilePath := #[]
+  /-- Time spent in `readModuleData` for each module in `moduleNames`, in nanoseconds. -/
+  readTimes     : Array Nat := #[]
 
 def throwAlreadyImported (s : ImportState) (const2ModIdx : HashMap Name ModuleIdx) (modIdx : Nat) (cname : Name) : IO α := do
   let modName := s.moduleNames[modIdx]!
@@ -757,12 +879,16 @@ partial def importModulesCore (imports : Array Import) : ImportStateM Unit := do
     let mFile ← findOLean i.module
     unless (← mFile.pathExists) do
       throw <| IO.userError s!"object file '{mFile}' of module {i.module} does not exist"
+    let start ← IO.monoNanosNow
     let (mod, region) ← readModuleData mFile
+    let readTime := (← IO.monoNanosNow) - start
     importModulesCore mod.imports
     modify fun s => { s with
       moduleData  := s.moduleData.push mod
       regions     := s.regions.push region
       moduleNames := s.moduleNames.push i.module
+      moduleFiles := s.moduleFiles.push mFile
+      readTimes   := s.readTimes.push readTime
     }
 
 def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (trustLevel : UInt32 := 0) : IO Environment := do
@@ -797,8 +923,22 @@ def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (
       moduleData   := s.moduleData
     }
   }
+  let trace? ← openImportTrace? opts
+  if let some h := trace? then
+    for h':modIdx in [0:s.moduleData.size] do
+      let mod := s.moduleData[modIdx]'h'.upper
+      let bytes := (← s.moduleFiles[modIdx]!.metadata).byteSize
+      let mmap := s.regions[modIdx]?.any (·.isMemoryMapped)
+      writeImportTraceRecord h [
+        ("event", toJson "module"),
+        ("module", toJson s.moduleNames[modIdx]!),
+        ("bytes", toJson bytes.toNat),
+        ("mmap", toJson mmap),
+        ("readNs", toJson s.readTimes[modIdx]!),
+        ("constants", toJson mod.constants.size)
+      ]
   let env ← setImportedEntries env s.moduleData
-  let env ← finalizePersistentExtensions env s.moduleData opts
+  let env ← finalizePersistentExtensions env s.moduleData opts trace?
   pure env
 
 @[export lean_import_modules]
@@ -808,6 +948,7 @@ def importModules (imports : Array Import) (opts : Options) (trustLevel : UInt32
       throw <| IO.userError "import failed, trying to import module with anonymous name"
   withImporting do
     let (_, s) ← importModulesCore imports |>.run
+    prefetchModuleRegions s.regions
     finalizeImport s imports opts trustLevel
 
 /--
@@ -935,6 +1076,77 @@ def isDefEqGuarded (env : Environment) (lctx : LocalContext) (a b : Expr) : Bool
 @[extern "lean_kernel_whnf"]
 opaque whnf (env : Environment) (lctx : LocalContext) (a : Expr) : Except KernelException Expr
 
+/--
+  Kernel `whnf_core` function: weak head normal form without unfolding definitions.
+  If `useMachine := true`, beta and zeta reduction are performed by an abstract machine with delayed
+  substitutions instead of `instantiate`. Both must produce the same result; this function is used
+  to test them against each other. The machine is used by default if the environment variable
+  `LEAN_KERNEL_WHNF_MACHINE` is set. -/
+@[extern "lean_kernel_whnf_core"]
+opaque whnfCore (env : Environment) (lctx : LocalContext) (a : Expr) (useMachine : Bool) : Except KernelException Expr
+
+/--
+  Evaluate the closed term `e` using the kernel evaluator based on normalization by evaluation, and return the
+  constructor at the head of the result. Return `none` if `e` is not closed or the evaluator gets stuck
+  (e.g., at an axiom or opaque constant). The type checker uses it for closed `t =?= true` problems
+  (e.g., `decide` proofs) if the environment variable `LEAN_KERNEL_NBE` is set. -/
+@[extern "lean_kernel_nbe_eval_constructor"]
+opaque nbeEvalConstructor? (env : @& Environment) (e : @& Expr) : Option Name
+
+/-- Statistics of the kernel cache for closed terms. See `setClosedTermCacheSize`. -/
+structure ClosedTermCacheStats where
+  hits   : Nat
+  misses : Nat
+  size   : Nat
+  deriving Repr, Inhabited
+
+/--
+  Set the maximal number of entries in the kernel cache for closed terms.
+  This cache stores `whnf` and type inference results across declarations (and threads),
+  but only for terms containing only imported constants.
+  It is disabled (size `0`) by default, unless the environment variable `LEAN_KERNEL_CACHE_SIZE` is set.
+  The cache is experimental: its effect on the checking time of large developments has not been measured yet. -/
+@[extern "lean_kernel_set_closed_term_cache_size"]
+opaque setClosedTermCacheSize (size : @& Nat) : BaseIO Unit
+
+@[extern "lean_kernel_get_closed_term_cache_stats"]
+opaque getClosedTermCacheStats : BaseIO ClosedTermCacheStats
+
+/--
+  Counters of the caches used by the expression traversals `replace` (which implements `instantiate` and
+  `abstract`) and `Expr.eqv`, accumulated over all threads. A collision is an insertion that evicted an entry,
+  and a resize happens when a single traversal has too many collisions. Counters are published in batches,
+  so recent traversals may not be included yet. -/
+structure ExprCacheStats where
+  replaceHits       : Nat
+  replaceMisses     : Nat
+  replaceCollisions : Nat
+  replaceResizes    : Nat
+  eqHits            : Nat
+  eqMisses          : Nat
+  eqCollisions      : Nat
+  eqResizes         : Nat
+  deriving Repr, Inhabited
+
+@[extern "lean_kernel_get_expr_cache_stats"]
+opaque getExprCacheStats : BaseIO ExprCacheStats
+
+/--
+  Set the directory of the persistent kernel check cache, or disable it (`none`).
+  Each entry of the cache records that a declaration with a given SHA-256 digest (which includes the digests of
+  all constants it depends on and the Lean commit) has already been type checked. Entries are added whenever the
+  cache is enabled, but `addDecl` only skips checking such declarations again if the trust level is at least
+  `2048` (e.g., `lean --trust=2048`), and if the entry records the full digest, the Lean commit and the name of
+  the declaration. Inductive declarations are always checked.
+  The cache is disabled by default, unless the environment variable `LEAN_KERNEL_CHECK_CACHE` is set.
+  See `script/kernelCheckCache.lean` for verifying and evicting entries. -/
+@[extern "lean_kernel_set_check_cache_dir"]
+opaque setCheckCacheDir (dir : @& Option System.FilePath) : BaseIO Unit
+
+/-- Key (hexadecimal SHA-256 digest) of `decl` in the persistent kernel check cache, or `none` if `decl` is not cached. -/
+@[extern "lean_kernel_check_cache_key"]
+opaque checkCacheKey? (env : @& Environment) (decl : @& Declaration) : Option String
+
 end Kernel
 
 class MonadEnv (m : Type → Type) where
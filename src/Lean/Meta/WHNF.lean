@@ -815,6 +815,8 @@ def reduceNat? (e : Expr) : MetaM (Option Expr) :=
     | Expr.app (Expr.const fn _) a                =>
       if fn == ``Nat.succ then
         reduceUnaryNatOp Nat.succ a
+      else if fn == ``Nat.log2 then
+        reduceUnaryNatOp Nat.log2 a
       else
         return none
     | Expr.app (Expr.app (Expr.const fn _) a1) a2 =>
@@ -827,6 +829,13 @@ def reduceNat? (e : Expr) : MetaM (Option Expr) :=
       else if fn == ``Nat.gcd then reduceBinNatOp Nat.gcd a1 a2
       else if fn == ``Nat.beq then reduceBinNatPred Nat.beq a1 a2
       else if fn == ``Nat.ble then reduceBinNatPred Nat.ble a1 a2
+      else if fn == ``Nat.land then reduceBinNatOp Nat.land a1 a2
+      else if fn == ``Nat.lor then reduceBinNatOp Nat.lor a1 a2
+      else if fn == ``Nat.xor then reduceBinNatOp Nat.xor a1 a2
+      else if fn == ``Nat.shiftRight then reduceBinNatOp Nat.shiftRight a1 a2
+      else if fn == ``Nat.shiftLeft then
+        -- `Nat.shiftLeft` panics if the shift amount does not fit in 32 bits (same check as in the kernel)
+        withNatValue a2 fun b => if b < 2^32 then reduceBinNatOp Nat.shiftLeft a1 a2 else return none
       else return none
     | _ =>
       return none
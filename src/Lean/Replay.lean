@@ -20,6 +20,12 @@ after replaying any inductive definitions occurring in `constantMap`.
 * a verifier for an `Environment`, by sending everything to the kernel, or
 * a mechanism to safely transfer constants from one `Environment` to another.
 
+With `parallel := true`, definitions, theorems, opaque constants and axioms are added to the
+environment without checking, and are checked by separate tasks against the environment
+they were added to, which already contains all the constants they refer to.
+Inductive types and `Quot` are still checked sequentially.
+The resulting environment and the reported error, if any, are the same as in sequential mode.
+
 -/
 
 namespace Lean.Environment
@@ -28,6 +34,7 @@ namespace Replay
 
 structure Context where
   newConstants : HashMap Name ConstantInfo
+  parallel : Bool := false
 
 structure State where
   env : Environment
@@ -35,6 +42,8 @@ structure State where
   pending : NameSet := {}
   postponedConstructors : NameSet := {}
   postponedRecursors : NameSet := {}
+  /-- Kernel checks running in parallel mode, in the order the declarations were added. -/
+  pendingChecks : Array (Task (Option KernelException)) := #[]
 
 abbrev M := ReaderT Context <| StateRefT State IO
 
@@ -53,11 +62,40 @@ def throwKernelException (ex : KernelException) : M Unit := do
     let state := { env := (← get).env }
     Prod.fst <$> (Lean.Core.CoreM.toIO · ctx state) do Lean.throwKernelException ex
 
-/-- Add a declaration, possibly throwing a `KernelException`. -/
+/-- Wait for the kernel checks started in parallel mode, throwing the first error in declaration order. -/
+def waitPendingChecks : M Unit := do
+  for check in (← get).pendingChecks do
+    if let some ex := check.get then
+      throwKernelException ex
+
+/--
+Add a declaration, possibly throwing a `KernelException`.
+In parallel mode, errors of previously added declarations are reported first.
+-/
 def addDecl (d : Declaration) : M Unit := do
   match (← get).env.addDecl d with
   | .ok env => modify fun s => { s with env := env }
-  | .error ex => throwKernelException ex
+  | .error ex =>
+    waitPendingChecks
+    throwKernelException ex
+
+/--
+Add a declaration that does not generate auxiliary declarations (i.e., not an inductive type or `Quot`).
+In parallel mode, it is added without checking, and checked by a separate task.
+-/
+def addSimpleDecl (d : Declaration) : M Unit := do
+  unless (← read).parallel do
+    return (← addDecl d)
+  let env := (← get).env
+  let check := Task.spawn fun _ =>
+    match env.addDecl d with
+    | .ok _ => none
+    | .error ex => some ex
+  match env.addDeclWithoutChecking d with
+  | .ok env => modify fun s => { s with env := env, pendingChecks := s.pendingChecks.push check }
+  | .error ex =>
+    waitPendingChecks
+    throwKernelException ex
 
 mutual
 /--
@@ -77,13 +115,13 @@ partial def replayConstant (name : Name) : M Unit := do
     if (← get).pending.contains name then
       match ci with
       | .defnInfo   info =>
-        addDecl (Declaration.defnDecl   info)
+        addSimpleDecl (Declaration.defnDecl   info)
       | .thmInfo    info =>
-        addDecl (Declaration.thmDecl    info)
+        addSimpleDecl (Declaration.thmDecl    info)
       | .axiomInfo  info =>
-        addDecl (Declaration.axiomDecl  info)
+        addSimpleDecl (Declaration.axiomDecl  info)
       | .opaqueInfo info =>
-        addDecl (Declaration.opaqueDecl info)
+        addSimpleDecl (Declaration.opaqueDecl info)
       | .inductInfo info =>
         let lparams := info.levelParams
         let nparams := info.numParams
@@ -152,8 +190,10 @@ open Replay
 
 Throws a `IO.userError` if the kernel rejects a constant,
 or if there are malformed recursors or constructors for inductive types.
+
+If `parallel := true`, independent declarations are checked in parallel, see the module documentation.
 -/
-def replay (newConstants : HashMap Name ConstantInfo) (env : Environment) : IO Environment := do
+def replay (newConstants : HashMap Name ConstantInfo) (env : Environment) (parallel := false) : IO Environment := do
   let mut remaining : NameSet := ∅
   for (n, ci) in newConstants.toList do
     -- We skip unsafe constants, and also partial constants.
@@ -161,9 +201,10 @@ def replay (newConstants : HashMap Name ConstantInfo) (env : Environment) : IO E
     if !ci.isUnsafe && !ci.isPartial then
       remaining := remaining.insert n
   let (_, s) ← StateRefT'.run (s := { env, remaining }) do
-    ReaderT.run (r := { newConstants }) do
+    ReaderT.run (r := { newConstants, parallel }) do
       for n in remaining do
         replayConstant n
+      waitPendingChecks
       checkPostponedConstructors
       checkPostponedRecursors
   return s.env
@@ -0,0 +1,658 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "runtime/thread.h"
+#include "runtime/buffer.h"
+#include "runtime/io.h"
+#include "runtime/compact.h"
+#include "util/name_hash_set.h"
+#include "kernel/check_cache.h"
+#include "githash.h" // NOLINT
+
+namespace lean {
+extern "C" obj_res lean_io_create_dir(b_obj_arg p, obj_arg);
+extern "C" obj_res lean_io_rename(b_obj_arg from, b_obj_arg to, obj_arg);
+extern "C" obj_res lean_io_remove_file(b_obj_arg fname, obj_arg);
+extern "C" obj_res lean_io_process_get_pid(obj_arg);
+
+#ifndef LEAN_CHECK_CACHE_HASH_CAPACITY
+/* Maximum number of hashes of imported constants kept between declarations. */
+#define LEAN_CHECK_CACHE_HASH_CAPACITY 1024*64
+#endif
+
+static char const * g_check_cache_magic = "lean-kernel-check-cache 2";
+
+namespace {
+/* Hash combinator. The digests are persisted and entries are trusted without rechecking, so they must be collision
+   resistant and must not depend on addresses or on the platform. */
+class hasher {
+    sha256 m_sha;
+public:
+    void add(uint64 v) {
+        unsigned char bytes[8];
+        for (unsigned i = 0; i < 8; i++)
+            bytes[i] = static_cast<unsigned char>(v >> (8 * i));
+        m_sha.update(bytes, sizeof(bytes));
+    }
+    void add(char const * s, size_t sz) {
+        add(sz);
+        m_sha.update(s, sz);
+    }
+    void add(std::string const & s) { add(s.data(), s.size()); }
+    void add(sha256_digest const & d) { m_sha.update(d.data(), d.size()); }
+    sha256_digest get() const { return m_sha.digest(); }
+};
+
+/* Structural hash of declarations and constants. The names of the constants occurring in the hashed terms are
+   collected in `m_deps`. */
+class structural_hash_fn {
+    std::unordered_map<object *, sha256_digest> m_cache;
+    name_hash_set                        m_deps;
+    bool                                 m_has_nat_lit = false;
+    bool                                 m_has_str_lit = false;
+
+    static void hash_name(hasher & h, name const & n) {
+        buffer<name> cs;
+        for (name it = n; !it.is_anonymous(); it = it.get_prefix())
+            cs.push_back(it);
+        h.add(cs.size());
+        for (unsigned i = cs.size(); i > 0; i--) {
+            name const & c = cs[i-1];
+            if (c.is_string()) {
+                h.add(0);
+                h.add(c.get_string().data(), c.get_string().num_bytes());
+            } else {
+                h.add(1);
+                hash_nat(h, c.get_numeral());
+            }
+        }
+    }
+
+    static void hash_names(hasher & h, names const & ns) {
+        h.add(length(ns));
+        for (name const & n : ns)
+            hash_name(h, n);
+    }
+
+    static void hash_nat(hasher & h, nat const & n) {
+        if (n.is_small()) {
+            h.add(0);
+            h.add(n.get_small_value());
+        } else {
+            h.add(1);
+            h.add(n.to_std_string());
+        }
+    }
+
+    static void hash_level(hasher & h, level const & l) {
+        h.add(static_cast<uint64>(kind(l)));
+        switch (kind(l)) {
+        case level_kind::Zero:
+            break;
+        case level_kind::Succ:
+            hash_level(h, succ_of(l));
+            break;
+        case level_kind::Max: case level_kind::IMax:
+            hash_level(h, level_lhs(l));
+            hash_level(h, level_rhs(l));
+            break;
+        case level_kind::Param: case level_kind::MVar:
+            hash_name(h, level_id(l));
+            break;
+        }
+    }
+
+    /* Hash of the data stored in the node `e` itself, the hashes of its children are combined in `hash_expr`. */
+    void hash_node(hasher & h, expr const & e) {
+        h.add(static_cast<uint64>(e.kind()));
+        switch (e.kind()) {
+        case expr_kind::BVar:
+            hash_nat(h, bvar_idx(e));
+            break;
+        case expr_kind::FVar:
+            hash_name(h, fvar_name(e));
+            break;
+        case expr_kind::MVar:
+            hash_name(h, mvar_name(e));
+            break;
+        case expr_kind::Sort:
+            hash_level(h, sort_level(e));
+            break;
+        case expr_kind::Const:
+            hash_name(h, const_name(e));
+            h.add(length(const_levels(e)));
+            for (level const & l : const_levels(e))
+                hash_level(h, l);
+            m_deps.insert(const_name(e));
+            break;
+        case expr_kind::Lit:
+            if (lit_value(e).kind() == literal_kind::Nat) {
+                hash_nat(h, lit_value(e).get_nat());
+                m_has_nat_lit = true;
+            } else {
+                h.add(lit_value(e).get_string().to_std_string());
+                m_has_str_lit = true;
+            }
+            break;
+        case expr_kind::Proj:
+            hash_name(h, proj_sname(e));
+            hash_nat(h, proj_idx(e));
+            break;
+        case expr_kind::MData: case expr_kind::App:
+        case expr_kind::Lambda: case expr_kind::Pi: case expr_kind::Let:
+            /* The type checker ignores metadata, binder names and binder annotations. */
+            break;
+        }
+    }
+
+    sha256_digest hash_expr(expr const & e) {
+        buffer<std::pair<expr const *, bool>> todo;
+        buffer<sha256_digest> results;
+        todo.emplace_back(&e, false);
+        while (!todo.empty()) {
+            expr const & c = *todo.back().first;
+            bool expanded  = todo.back().second;
+            bool shared    = !is_exclusive(c.raw());
+            if (!expanded && shared) {
+                auto it = m_cache.find(c.raw());
+                if (it != m_cache.end()) {
+                    todo.pop_back();
+                    results.push_back(it->second);
+                    continue;
+                }
+            }
+            unsigned nchildren = 0;
+            switch (c.kind()) {
+            case expr_kind::MData: case expr_kind::Proj: nchildren = 1; break;
+            case expr_kind::App: case expr_kind::Lambda: case expr_kind::Pi: nchildren = 2; break;
+            case expr_kind::Let: nchildren = 3; break;
+            default: break;
+            }
+            if (!expanded && nchildren > 0) {
+                todo.back().second = true;
+                switch (c.kind()) {
+                case expr_kind::MData:  todo.emplace_back(&mdata_expr(c), false); break;
+                case expr_kind::Proj:   todo.emplace_back(&proj_expr(c), false); break;
+                case expr_kind::App:
+                    todo.emplace_back(&app_arg(c), false);
+                    todo.emplace_back(&app_fn(c), false);
+                    break;
+                case expr_kind::Lambda: case expr_kind::Pi:
+                    todo.emplace_back(&binding_body(c), false);
+                    todo.emplace_back(&binding_domain(c), false);
+                    break;
+                case expr_kind::Let:
+                    todo.emplace_back(&let_body(c), false);
+                    todo.emplace_back(&let_value(c), false);
+                    todo.emplace_back(&let_type(c), false);
+                    break;
+                default:
+                    lean_unreachable();
+                }
+                continue;
+            }
+            todo.pop_back();
+            hasher h;
+            hash_node(h, c);
+            for (unsigned i = results.size() - nchildren; i < results.size(); i++)
+                h.add(results[i]);
+            results.shrink(results.size() - nchildren);
+            sha256_digest r = h.get();
+            if (shared)
+                m_cache.insert(mk_pair(c.raw(), r));
+            results.push_back(r);
+        }
+        lean_assert(results.size() == 1);
+        return results[0];
+    }
+
+public:
+    /* Hash of the data of `info`, the hashes of its dependencies are not included. */
+    sha256_digest hash_constant(constant_info const & info) {
+        hasher h;
+        h.add(static_cast<uint64>(info.kind()));
+        hash_name(h, info.get_name());
+        hash_names(h, info.get_lparams());
+        h.add(hash_expr(info.get_type()));
+        h.add(info.is_unsafe());
+        switch (info.kind()) {
+        case constant_info_kind::Axiom:
+            break;
+        case constant_info_kind::Definition: {
+            definition_val const & v = info.to_definition_val();
+            h.add(hash_expr(v.get_value()));
+            h.add(static_cast<uint64>(v.get_safety()));
+            h.add(static_cast<uint64>(v.get_hints().kind()));
+            if (v.get_hints().is_regular())
+                h.add(v.get_hints().get_height());
+            break;
+        }
+        case constant_info_kind::Theorem:
+            h.add(hash_expr(info.to_theorem_val().get_value()));
+            break;
+        case constant_info_kind::Opaque:
+            h.add(hash_expr(info.to_opaque_val().get_value()));
+            break;
+        case constant_info_kind::Quot:
+            h.add(static_cast<uint64>(info.to_quot_val().get_quot_kind()));
+            break;
+        case constant_info_kind::Inductive: {
+            inductive_val const & v = info.to_inductive_val();
+            h.add(v.get_nparams());
+            h.add(v.get_nindices());
+            hash_names(h, v.get_all());
+            hash_names(h, v.get_cnstrs());
+            h.add(v.is_rec());
+            h.add(v.is_reflexive());
+            h.add(v.is_nested());
+            break;
+        }
+        case constant_info_kind::Constructor: {
+            constructor_val const & v = info.to_constructor_val();
+            hash_name(h, v.get_induct());
+            h.add(v.get_cidx());
+            h.add(v.get_nparams());
+            h.add(v.get_nfields());
+            break;
+        }
+        case constant_info_kind::Recursor: {
+            recursor_val const & v = info.to_recursor_val();
+            hash_names(h, v.get_all());
+            h.add(v.get_nparams());
+            h.add(v.get_nindices());
+            h.add(v.get_nmotives());
+            h.add(v.get_nminors());
+            h.add(v.is_k());
+            h.add(length(v.get_rules()));
+            for (recursor_rule const & r : v.get_rules()) {
+                hash_name(h, r.get_cnstr());
+                h.add(r.get_nfields());
+                h.add(hash_expr(r.get_rhs()));
+            }
+            break;
+        }
+        }
+        return h.get();
+    }
+
+    /* Names of the constants occurring in the terms hashed so far, sorted. Literals depend on the constants
+       the type checker uses to type and reduce them. */
+    std::vector<name> get_deps() {
+        if (m_has_nat_lit) {
+            m_deps.insert(name("Nat"));
+        }
+        if (m_has_str_lit) {
+            m_deps.insert(name("String"));
+            m_deps.insert(name{"String", "mk"});
+            m_deps.insert(name("Char"));
+            m_deps.insert(name{"Char", "ofNat"});
+            m_deps.insert(name{"List", "nil"});
+            m_deps.insert(name{"List", "cons"});
+        }
+        std::vector<name> r(m_deps.begin(), m_deps.end());
+        std::sort(r.begin(), r.end());
+        return r;
+    }
+};
+
+/* Hashes of constants including (transitively) the hashes of the constants they depend on.
+
+   Constants that depend on each other (e.g., through the recursors of mutual inductive types, or unsafe
+   definitions) are hashed together: the strongly connected components of the dependency graph are computed
+   using Tarjan's algorithm, and the hash of each component combines the data of all its members and the hashes
+   of the components they depend on. So, the hash of a constant does not depend on the order in which the graph
+   is traversed, and changes whenever a constant it (transitively) depends on changes.
+
+   Only the hashes of imported constants are kept across calls: imported constants only depend on imported
+   constants, so their hashes are determined by the imports (see `environment::get_imports_key`). Like the other
+   kernel caches, the cache is flushed when the imports change or are freed, and when it exceeds
+   `LEAN_CHECK_CACHE_HASH_CAPACITY` entries. The hashes of the constants added after the imports are memoized by the
+   caller (`local`), i.e., once per cache key; the cost is proportional to the size of the dependencies that are
+   not imported.
+
+   The mutex only protects the imported entries: the constants are hashed without holding it, so keys can be
+   computed concurrently. Threads hashing the same constants compute the same hashes. */
+class constant_hash_cache {
+public:
+    typedef std::unordered_map<name, sha256_digest, name_hash_fn> name2digest;
+private:
+    mutex                m_mutex;
+    optional<object_ref> m_imports_key;
+    name2digest          m_imported;
+
+    optional<sha256_digest> find_imported(environment const & env, name const & n) {
+        object_ref key = env.get_imports_key();
+        lock_guard<mutex> _(m_mutex);
+        if (!m_imports_key || m_imports_key->raw() != key.raw())
+            return optional<sha256_digest>();
+        auto it = m_imported.find(n);
+        if (it == m_imported.end())
+            return optional<sha256_digest>();
+        return optional<sha256_digest>(it->second);
+    }
+
+    void insert_imported(environment const & env, name const & n, sha256_digest const & h) {
+        object_ref key = env.get_imports_key();
+        lock_guard<mutex> _(m_mutex);
+        if (!m_imports_key || m_imports_key->raw() != key.raw()) {
+            m_imported.clear();
+            /* The key is shared by all threads. */
+            mark_mt(key.raw());
+            m_imports_key = key;
+        }
+        if (m_imported.size() >= LEAN_CHECK_CACHE_HASH_CAPACITY)
+            m_imported.clear();
+        mark_mt(n.raw());
+        m_imported.insert(mk_pair(n, h));
+    }
+
+    struct node {
+        name                    m_name;
+        optional<constant_info> m_info;
+        bool                    m_imported;
+        /* Hash of the data of the constant, see `structural_hash_fn::hash_constant`. */
+        sha256_digest           m_hash;
+        std::vector<name>       m_deps;
+        /* Next dependency to visit. */
+        size_t                  m_next = 0;
+        /* Smallest index of a node reachable from this one that is still on the component stack. */
+        unsigned                m_lowlink;
+        bool                    m_on_stack = true;
+    };
+
+    static node mk_node(environment const & env, name const & n, unsigned idx) {
+        node f;
+        f.m_name     = n;
+        f.m_info     = env.find(n);
+        f.m_imported = env.is_imported(n);
+        f.m_lowlink  = idx;
+        if (f.m_info) {
+            structural_hash_fn fn;
+            f.m_hash = fn.hash_constant(*f.m_info);
+            f.m_deps = fn.get_deps();
+        } else {
+            hasher h;
+            h.add(n.to_string());
+            f.m_hash = h.get();
+        }
+        return f;
+    }
+
+public:
+    void clear() {
+        lock_guard<mutex> _(m_mutex);
+        m_imported.clear();
+        m_imports_key = optional<object_ref>();
+    }
+
+    /* Return the hash of `n` in `env`, the hashes of constants that are not imported are stored in `local`.
+       The dependency graph is traversed using an explicit stack. */
+    sha256_digest get(environment const & env, name const & n, name2digest & local) {
+        auto get_hash = [&](name const & d) -> optional<sha256_digest> {
+            auto it = local.find(d);
+            if (it != local.end())
+                return optional<sha256_digest>(it->second);
+            return find_imported(env, d);
+        };
+        if (optional<sha256_digest> r = get_hash(n))
+            return *r;
+        /* The index of a node is its position in `nodes`. */
+        std::vector<node> nodes;
+        std::unordered_map<name, unsigned, name_hash_fn> node_idx;
+        /* Hashes of the dependencies found so far and of the imported constants of the components processed so far. */
+        name2digest hashes;
+        std::vector<unsigned> todo;
+        std::vector<unsigned> component_stack;
+        auto visit = [&](name const & d) {
+            unsigned idx = nodes.size();
+            nodes.push_back(mk_node(env, d, idx));
+            node_idx.insert(mk_pair(d, idx));
+            todo.push_back(idx);
+            component_stack.push_back(idx);
+        };
+        auto get_dep_hash = [&](name const & d) -> optional<sha256_digest> {
+            auto it = hashes.find(d);
+            if (it != hashes.end())
+                return optional<sha256_digest>(it->second);
+            optional<sha256_digest> r = get_hash(d);
+            /* Imported entries may be evicted by other threads before the component using them is hashed. */
+            if (r)
+                hashes.insert(mk_pair(d, *r));
+            return r;
+        };
+        visit(n);
+        while (!todo.empty()) {
+            unsigned v = todo.back();
+            if (nodes[v].m_next < nodes[v].m_deps.size()) {
+                name d = nodes[v].m_deps[nodes[v].m_next++];
+                auto it = node_idx.find(d);
+                if (it != node_idx.end()) {
+                    if (nodes[it->second].m_on_stack)
+                        nodes[v].m_lowlink = std::min(nodes[v].m_lowlink, it->second);
+                } else if (!get_dep_hash(d)) {
+                    visit(d);
+                }
+                continue;
+            }
+            todo.pop_back();
+            if (!todo.empty())
+                nodes[todo.back()].m_lowlink = std::min(nodes[todo.back()].m_lowlink, nodes[v].m_lowlink);
+            if (nodes[v].m_lowlink != v)
+                continue;
+            /* `v` is the root of a component, its members are on top of `component_stack`. */
+            std::vector<node *> members;
+            while (true) {
+                unsigned w = component_stack.back();
+                component_stack.pop_back();
+                nodes[w].m_on_stack = false;
+                members.push_back(&nodes[w]);
+                if (w == v)
+                    break;
+            }
+            std::sort(members.begin(), members.end(), [](node const * n1, node const * n2) {
+                    return n1->m_name < n2->m_name;
+                });
+            name_hash_set member_names;
+            for (node const * m : members)
+                member_names.insert(m->m_name);
+            hasher h;
+            h.add(members.size());
+            for (node const * m : members) {
+                h.add(m->m_hash);
+                h.add(m->m_deps.size());
+                for (name const & d : m->m_deps) {
+                    if (member_names.count(d)) {
+                        /* Reference to a member of the component, its data is hashed above. */
+                        h.add(0);
+                        h.add(d.to_string());
+                    } else {
+                        h.add(1);
+                        h.add(*get_dep_hash(d));
+                    }
+                }
+            }
+            sha256_digest component_hash = h.get();
+            for (node const * m : members) {
+                hasher hm;
+                hm.add(component_hash);
+                hm.add(m->m_name.to_string());
+                sha256_digest r = hm.get();
+                if (m->m_imported) {
+                    hashes.insert(mk_pair(m->m_name, r));
+                    insert_imported(env, m->m_name, r);
+                } else {
+                    local.insert(mk_pair(m->m_name, r));
+                }
+            }
+        }
+        return *get_dep_hash(n);
+    }
+};
+
+class check_cache {
+    mutex                           m_mutex;
+    std::string                     m_dir;
+    /* Keys (in hexadecimal) of the entries known to be in the cache. */
+    std::unordered_set<std::string> m_known;
+    std::atomic<bool>               m_enabled{false};
+    std::atomic<unsigned>           m_counter{0};
+
+    std::string entry_dir(std::string const & hex) const { return m_dir + "/" + hex.substr(0, 2); }
+    std::string entry_path(std::string const & hex) const { return entry_dir(hex) + "/" + hex; }
+
+public:
+    check_cache() {
+        if (char const * dir = std::getenv("LEAN_KERNEL_CHECK_CACHE"))
+            set_dir(std::string(dir));
+    }
+
+    bool enabled() const { return m_enabled; }
+
+    void set_dir(std::string const & dir) {
+        lock_guard<mutex> _(m_mutex);
+        m_dir = dir;
+        m_known.clear();
+        m_enabled = !dir.empty();
+    }
+
+    /* An entry is only valid if it records the full key, the commit of the kernel and the name of the declaration,
+       so entries that have been truncated, renamed or written by another version of Lean are ignored. */
+    bool contains(sha256_digest const & key, name const & n) {
+        std::string hex = to_hex(key);
+        lock_guard<mutex> _(m_mutex);
+        if (m_known.find(hex) != m_known.end())
+            return true;
+        std::ifstream in(entry_path(hex));
+        std::string magic, digest, githash, decl_name;
+        if (!in.good() || !std::getline(in, magic) || !std::getline(in, digest) ||
+            !std::getline(in, githash) || !std::getline(in, decl_name))
+            return false;
+        if (magic != g_check_cache_magic || digest != hex || githash != LEAN_GITHASH || decl_name != n.to_string())
+            return false;
+        m_known.insert(hex);
+        return true;
+    }
+
+    void insert(sha256_digest const & key, name const & n) {
+        std::string hex = to_hex(key);
+        lock_guard<mutex> _(m_mutex);
+        if (!m_known.insert(hex).second)
+            return;
+        /* Errors are ignored, the cache is only an optimization. */
+        dec_ref(lean_io_create_dir(string_ref(m_dir).raw(), io_mk_world()));
+        dec_ref(lean_io_create_dir(string_ref(entry_dir(hex)).raw(), io_mk_world()));
+        object * pid = lean_io_process_get_pid(io_mk_world());
+        uint32 pid_val = io_result_is_ok(pid) ? unbox_uint32(io_result_get_value(pid)) : 0;
+        dec_ref(pid);
+        std::string tmp = entry_path(hex) + ".tmp." + std::to_string(pid_val) + "." + std::to_string(m_counter++);
+        {
+            std::ofstream out(tmp);
+            if (out.fail())
+                return;
+            out << g_check_cache_magic << "\n" << hex << "\n" << LEAN_GITHASH << "\n" << n.to_string() << "\n";
+            out.close();
+            if (out.fail()) {
+                dec_ref(lean_io_remove_file(string_ref(tmp).raw(), io_mk_world()));
+                return;
+            }
+        }
+        object * r = lean_io_rename(string_ref(tmp).raw(), string_ref(entry_path(hex)).raw(), io_mk_world());
+        if (!io_result_is_ok(r))
+            dec_ref(lean_io_remove_file(string_ref(tmp).raw(), io_mk_world()));
+        dec_ref(r);
+    }
+};
+}
+
+static constant_hash_cache * g_constant_hash_cache = nullptr;
+static check_cache *         g_check_cache         = nullptr;
+
+bool check_cache_enabled() {
+    return g_check_cache->enabled();
+}
+
+optional<sha256_digest> check_cache_key(environment const & env, declaration const & d) {
+    buffer<constant_info> infos;
+    switch (d.kind()) {
+    case declaration_kind::Definition: case declaration_kind::Theorem: case declaration_kind::Opaque:
+        infos.push_back(constant_info(d));
+        break;
+    case declaration_kind::MutualDefinition:
+        for (definition_val const & v : d.to_definition_vals())
+            infos.push_back(constant_info(v));
+        break;
+    default:
+        return optional<sha256_digest>();
+    }
+    structural_hash_fn fn;
+    hasher h;
+    h.add(std::string(LEAN_GITHASH));
+    h.add(static_cast<uint64>(d.kind()));
+    h.add(infos.size());
+    for (constant_info const & info : infos)
+        h.add(fn.hash_constant(info));
+    std::vector<name> deps = fn.get_deps();
+    constant_hash_cache::name2digest local;
+    h.add(deps.size());
+    for (name const & dep : deps) {
+        if (std::any_of(infos.begin(), infos.end(), [&](constant_info const & info) { return info.get_name() == dep; })) {
+            h.add(0);
+        } else {
+            h.add(g_constant_hash_cache->get(env, dep, local));
+        }
+    }
+    return optional<sha256_digest>(h.get());
+}
+
+bool check_cache_contains(sha256_digest const & key, name const & n) {
+    return g_check_cache->contains(key, n);
+}
+
+void check_cache_insert(sha256_digest const & key, name const & n) {
+    g_check_cache->insert(key, n);
+}
+
+/*
+@[extern "lean_kernel_set_check_cache_dir"]
+opaque setCheckCacheDir (dir : @& Option System.FilePath) : BaseIO Unit
+*/
+extern "C" LEAN_EXPORT object * lean_kernel_set_check_cache_dir(b_obj_arg dir, object *) {
+    g_check_cache->set_dir(is_scalar(dir) ? std::string() : string_to_std(cnstr_get(dir, 0)));
+    return io_result_mk_ok(box(0));
+}
+
+/*
+@[extern "lean_kernel_check_cache_key"]
+opaque checkCacheKey? (env : @& Environment) (decl : @& Declaration) : Option String
+*/
+extern "C" LEAN_EXPORT object * lean_kernel_check_cache_key(b_obj_arg env, b_obj_arg decl) {
+    if (optional<sha256_digest> key = check_cache_key(environment(env, true), declaration(decl, true)))
+        return mk_option_some(mk_string(to_hex(*key)));
+    return mk_option_none();
+}
+
+static void clear_constant_hash_cache() {
+    g_constant_hash_cache->clear();
+}
+
+void initialize_check_cache() {
+    g_constant_hash_cache = new constant_hash_cache();
+    g_check_cache         = new check_cache();
+    register_compacted_region_free_fn(clear_constant_hash_cache);
+}
+
+void finalize_check_cache() {
+    delete g_check_cache;
+    delete g_constant_hash_cache;
+}
+}
@@ -0,0 +1,36 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include "util/sha256.h"
+#include "kernel/environment.h"
+
+namespace lean {
+/** \brief Persistent cache of successful kernel checks.
+
+    Each entry is a file `<dir>/<xx>/<key>` where `key` is the hexadecimal representation of a SHA-256 digest
+    of the declaration (type, value, universe parameters, safety, ...), of the digests of all constants it
+    depends on (transitively), and of the commit of the kernel. An entry records that a declaration with this
+    key has already been successfully type checked, it contains the key, the commit and the name of the
+    declaration, which are all verified on lookup. Entries are written atomically (temporary file + rename),
+    so the cache can be shared by concurrent `lean` processes.
+
+    The cache is disabled unless a directory is set using the environment variable `LEAN_KERNEL_CHECK_CACHE`
+    or \c set_check_cache_dir. When it is enabled, entries are added for the declarations that have been
+    checked, but declarations are only added without checking them if the trust level of the environment is at
+    least `LEAN_CHECK_CACHE_TRUST_LEVEL`. */
+bool check_cache_enabled();
+
+/** \brief Return the cache key for \c d, or \c none if \c d is not cached (e.g., inductive declarations). */
+optional<sha256_digest> check_cache_key(environment const & env, declaration const & d);
+
+/** \brief Return true if there is a valid entry for \c key and the declaration \c n. */
+bool check_cache_contains(sha256_digest const & key, name const & n);
+
+/** \brief Record that the declaration \c n with cache key \c key has been type checked. */
+void check_cache_insert(sha256_digest const & key, name const & n);
+
+void initialize_check_cache();
+void finalize_check_cache();
+}
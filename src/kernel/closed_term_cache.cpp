@@ -0,0 +1,255 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <cstdlib>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include "runtime/thread.h"
+#include "runtime/io.h"
+#include "runtime/buffer.h"
+#include "runtime/compact.h"
+#include "kernel/closed_term_cache.h"
+
+#ifndef LEAN_CLOSED_TERM_CACHE_SHARDS
+#define LEAN_CLOSED_TERM_CACHE_SHARDS 16
+#endif
+
+namespace lean {
+/* The entries are distributed over independent shards by the hash of the term, each with its own mutex and LRU
+   list, so that type checkers running in different threads rarely wait for each other. */
+class closed_term_cache {
+    struct key {
+        closed_term_cache_kind m_kind;
+        expr                   m_expr;
+    };
+    struct key_hash {
+        unsigned operator()(key const & k) const { return hash(hash(k.m_expr), static_cast<unsigned>(k.m_kind)); }
+    };
+    struct key_eq {
+        bool operator()(key const & k1, key const & k2) const { return k1.m_kind == k2.m_kind && k1.m_expr == k2.m_expr; }
+    };
+    typedef std::list<std::pair<key, expr>> lru_list;
+    struct shard {
+        mutex                                                         m_mutex;
+        /* `get_imports_key()` of the environment the entries were computed in. */
+        optional<object_ref>                                          m_imports_key;
+        /* Most recently used entries first. */
+        lru_list                                                      m_entries;
+        std::unordered_map<key, lru_list::iterator, key_hash, key_eq> m_index;
+        size_t                                                        m_hits   = 0;
+        size_t                                                        m_misses = 0;
+
+        void clear() {
+            m_entries.clear();
+            m_index.clear();
+            m_imports_key = optional<object_ref>();
+        }
+
+        /* Make sure the cached entries were computed in an environment with the same imports as `env`. */
+        void set_env(environment const & env) {
+            object_ref imports_key = env.get_imports_key();
+            if (m_imports_key && m_imports_key->raw() == imports_key.raw())
+                return;
+            clear();
+            mark_mt(imports_key.raw());
+            m_imports_key = imports_key;
+        }
+
+        void shrink(size_t capacity) {
+            while (m_entries.size() > capacity) {
+                m_index.erase(m_entries.back().first);
+                m_entries.pop_back();
+            }
+        }
+    };
+    std::atomic<size_t> m_capacity{0};
+    shard               m_shards[LEAN_CLOSED_TERM_CACHE_SHARDS];
+
+    shard & get_shard(closed_term_cache_kind k, expr const & e) {
+        return m_shards[key_hash()(key{k, e}) % LEAN_CLOSED_TERM_CACHE_SHARDS];
+    }
+
+    size_t shard_capacity() const {
+        return (m_capacity + LEAN_CLOSED_TERM_CACHE_SHARDS - 1) / LEAN_CLOSED_TERM_CACHE_SHARDS;
+    }
+public:
+    closed_term_cache() {
+        if (char const * v = std::getenv("LEAN_KERNEL_CACHE_SIZE"))
+            m_capacity = std::strtoull(v, nullptr, 10);
+    }
+
+    bool enabled() const { return m_capacity > 0; }
+
+    void set_capacity(size_t c) {
+        m_capacity = c;
+        for (shard & s : m_shards) {
+            lock_guard<mutex> _(s.m_mutex);
+            if (c == 0)
+                s.clear();
+            else
+                s.shrink(shard_capacity());
+        }
+    }
+
+    /* The entries may contain imported terms, so they are dropped before the imported modules are freed. */
+    void clear() {
+        for (shard & s : m_shards) {
+            lock_guard<mutex> _(s.m_mutex);
+            s.clear();
+        }
+    }
+
+    optional<expr> find(environment const & env, closed_term_cache_kind k, expr const & e) {
+        shard & s = get_shard(k, e);
+        lock_guard<mutex> _(s.m_mutex);
+        s.set_env(env);
+        auto it = s.m_index.find(key{k, e});
+        if (it == s.m_index.end()) {
+            s.m_misses++;
+            return none_expr();
+        }
+        s.m_hits++;
+        s.m_entries.splice(s.m_entries.begin(), s.m_entries, it->second);
+        return some_expr(it->second->second);
+    }
+
+    void insert(environment const & env, closed_term_cache_kind k, expr const & e, expr const & r) {
+        size_t capacity = shard_capacity();
+        if (capacity == 0)
+            return;
+        shard & s = get_shard(k, e);
+        lock_guard<mutex> _(s.m_mutex);
+        s.set_env(env);
+        key new_key{k, e};
+        if (s.m_index.find(new_key) != s.m_index.end())
+            return;
+        /* Entries are read by type checkers running in other threads. */
+        mark_mt(e.raw());
+        mark_mt(r.raw());
+        s.m_entries.emplace_front(new_key, r);
+        s.m_index.insert(mk_pair(new_key, s.m_entries.begin()));
+        s.shrink(capacity);
+    }
+
+    void get_stats(size_t & hits, size_t & misses, size_t & size) {
+        hits = misses = size = 0;
+        for (shard & s : m_shards) {
+            lock_guard<mutex> _(s.m_mutex);
+            hits   += s.m_hits;
+            misses += s.m_misses;
+            size   += s.m_entries.size();
+        }
+    }
+};
+
+static closed_term_cache * g_closed_term_cache = nullptr;
+
+/* Return true iff all constants in `e` were imported. The result for each subterm is stored in `memo`. */
+static bool has_only_imported_consts(environment const & env, expr const & e, expr_flat_map<bool> & memo) {
+    if (bool const * r = memo.find(e))
+        return *r;
+    buffer<expr> todo;
+    todo.push_back(e);
+    while (!todo.empty()) {
+        size_t sz = todo.size();
+        expr c    = todo.back();
+        if (memo.contains(c)) {
+            todo.pop_back();
+            continue;
+        }
+        /* Children that still have to be visited are pushed on top of `c`, which is processed again afterwards. */
+        bool pending = false;
+        bool r       = true;
+        auto visit = [&](expr const & child) {
+            if (bool const * rc = memo.find(child))
+                r = r && *rc;
+            else {
+                todo.push_back(child);
+                pending = true;
+            }
+        };
+        switch (c.kind()) {
+        case expr_kind::Const:
+            r = env.is_imported(const_name(c));
+            break;
+        case expr_kind::BVar: case expr_kind::FVar: case expr_kind::MVar:
+        case expr_kind::Sort: case expr_kind::Lit:
+            break;
+        case expr_kind::App:
+            visit(app_fn(c)); visit(app_arg(c));
+            break;
+        case expr_kind::Lambda: case expr_kind::Pi:
+            visit(binding_domain(c)); visit(binding_body(c));
+            break;
+        case expr_kind::Let:
+            visit(let_type(c)); visit(let_value(c)); visit(let_body(c));
+            break;
+        case expr_kind::MData:
+            visit(mdata_expr(c));
+            break;
+        case expr_kind::Proj:
+            visit(proj_expr(c));
+            break;
+        }
+        if (pending && r)
+            continue;
+        /* Either all children have been visited, or one of them already contains a local constant. In the
+           latter case, the children pushed above are not needed. */
+        todo.shrink(sz - 1);
+        memo.insert(c, r);
+    }
+    return *memo.find(e);
+}
+
+bool is_closed_term_cache_candidate(environment const & env, expr const & e, expr_flat_map<bool> & memo) {
+    if (!g_closed_term_cache->enabled() || has_fvar(e) || has_loose_bvars(e) || has_metavar(e))
+        return false;
+    return has_only_imported_consts(env, e, memo);
+}
+
+optional<expr> closed_term_cache_find(environment const & env, closed_term_cache_kind k, expr const & e) {
+    return g_closed_term_cache->find(env, k, e);
+}
+
+void closed_term_cache_insert(environment const & env, closed_term_cache_kind k, expr const & e, expr const & r) {
+    g_closed_term_cache->insert(env, k, e, r);
+}
+
+/*
+@[extern "lean_kernel_set_closed_term_cache_size"]
+opaque setClosedTermCacheSize (size : @& Nat) : BaseIO Unit
+*/
+extern "C" LEAN_EXPORT object * lean_kernel_set_closed_term_cache_size(b_obj_arg size, object *) {
+    g_closed_term_cache->set_capacity(lean_is_scalar(size) ? lean_unbox(size) : LEAN_MAX_SMALL_NAT);
+    return io_result_mk_ok(box(0));
+}
+
+/*
+@[extern "lean_kernel_get_closed_term_cache_stats"]
+opaque getClosedTermCacheStats : BaseIO ClosedTermCacheStats
+*/
+extern "C" LEAN_EXPORT object * lean_kernel_get_closed_term_cache_stats(object *) {
+    size_t hits, misses, size;
+    g_closed_term_cache->get_stats(hits, misses, size);
+    object * r = alloc_cnstr(0, 3, 0);
+    cnstr_set(r, 0, lean_usize_to_nat(hits));
+    cnstr_set(r, 1, lean_usize_to_nat(misses));
+    cnstr_set(r, 2, lean_usize_to_nat(size));
+    return io_result_mk_ok(r);
+}
+
+static void clear_closed_term_cache() {
+    g_closed_term_cache->clear();
+}
+
+void initialize_closed_term_cache() {
+    g_closed_term_cache = new closed_term_cache();
+    register_compacted_region_free_fn(clear_closed_term_cache);
+}
+
+void finalize_closed_term_cache() {
+    delete g_closed_term_cache;
+}
+}
@@ -0,0 +1,38 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include "kernel/environment.h"
+#include "kernel/expr_flat_map.h"
+
+namespace lean {
+enum class closed_term_cache_kind { Whnf, InferOnly };
+
+/** \brief Return `true` if the results of `whnf` and `infer_type` (in `infer_only` mode) for `e` can be
+    shared across type checkers using environments that have the same imports.
+
+    This is the case when `e` has no free, loose bound or meta variables, and all its constants were
+    imported. Then, the reduction of `e` only unfolds imported definitions, which cannot be changed by the
+    current module.
+
+    \c memo caches, for each visited subterm, whether all its constants were imported. It must only be used
+    with environments with the same imports as \c env, e.g., it is stored in `type_checker::state`. So, the
+    subterms shared by the terms of a declaration are only traversed once.
+
+    Always returns `false` if the cache is disabled. */
+bool is_closed_term_cache_candidate(environment const & env, expr const & e, expr_flat_map<bool> & memo);
+
+/** \brief Bounded LRU cache of `whnf` and `infer_type` results for closed terms, shared by all type
+    checkers. The cache is experimental and disabled (size 0) by default: its benefit on large developments
+    has not been measured yet. Its size can be set using the environment variable `LEAN_KERNEL_CACHE_SIZE`
+    or `Lean.Kernel.setClosedTermCacheSize`.
+
+    Entries are only valid for environments with the same imports. The cache is flushed whenever it is
+    used with an environment with different imports, and when imported modules are freed. */
+optional<expr> closed_term_cache_find(environment const & env, closed_term_cache_kind k, expr const & e);
+void closed_term_cache_insert(environment const & env, closed_term_cache_kind k, expr const & e, expr const & r);
+
+void initialize_closed_term_cache();
+void finalize_closed_term_cache();
+}
@@ -15,6 +15,7 @@ Author: Leonardo de Moura
 #include "kernel/kernel_exception.h"
 #include "kernel/type_checker.h"
 #include "kernel/quot.h"
+#include "kernel/check_cache.h"
 
 namespace lean {
 extern "C" object* lean_environment_add(object*, object*);
@@ -28,6 +29,8 @@ extern "C" object* lean_get_extension(object*, object*);
 extern "C" object* lean_set_extension(object*, object*, object*);
 extern "C" object* lean_environment_set_main_module(object*, object*);
 extern "C" object* lean_environment_main_module(object*);
+extern "C" uint8 lean_environment_is_imported_const(object*, object*);
+extern "C" object* lean_environment_imports_key(object*);
 
 environment mk_empty_environment(uint32 trust_lvl) {
     return get_io_result<environment>(lean_mk_empty_environment(trust_lvl, io_mk_world()));
@@ -61,6 +64,14 @@ optional<constant_info> environment::find(name const & n) const {
     return to_optional<constant_info>(lean_environment_find(to_obj_arg(), n.to_obj_arg()));
 }
 
+bool environment::is_imported(name const & n) const {
+    return lean_environment_is_imported_const(to_obj_arg(), n.to_obj_arg()) != 0;
+}
+
+object_ref environment::get_imports_key() const {
+    return object_ref(lean_environment_imports_key(to_obj_arg()));
+}
+
 constant_info environment::get(name const & n) const {
     object * o = lean_environment_find(to_obj_arg(), n.to_obj_arg());
     if (is_scalar(o))
@@ -234,6 +245,30 @@ environment environment::add_mutual(declaration const & d, bool check) const {
 }
 
 environment environment::add(declaration const & d, bool check) const {
+    optional<sha256_digest> key;
+    name n;
+    if (check && check_cache_enabled()) {
+        key = check_cache_key(*this, d);
+        if (key)
+            n = d.is_mutual() ? head(d.to_definition_vals()).get_name() : constant_info(d).get_name();
+        if (key && trust_lvl() >= LEAN_CHECK_CACHE_TRUST_LEVEL && check_cache_contains(*key, n)) {
+            /* The declaration has already been checked, but its names may already be used in this environment. */
+            if (d.is_mutual()) {
+                for (definition_val const & v : d.to_definition_vals())
+                    check_name(v.get_name());
+            } else {
+                check_name(n);
+            }
+            return add_declaration(d, false);
+        }
+    }
+    environment new_env = add_declaration(d, check);
+    if (key)
+        check_cache_insert(*key, n);
+    return new_env;
+}
+
+environment environment::add_declaration(declaration const & d, bool check) const {
     switch (d.kind()) {
     case declaration_kind::Axiom:            return add_axiom(d, check);
     case declaration_kind::Definition:       return add_definition(d, check);
@@ -252,6 +287,47 @@ extern "C" LEAN_EXPORT object * lean_add_decl(object * env, object * decl) {
         });
 }
 
+extern "C" LEAN_EXPORT object * lean_add_decl_without_checking(object * env, object * decl) {
+    return catch_kernel_exceptions<environment>([&]() {
+            return environment(env).add(declaration(decl, true), false);
+        });
+}
+
+static object_ref type_checker_stats_to_object(type_checker_stats const & s) {
+    size_t counters[] = {
+        s.m_infer_type_calls, s.m_infer_type_cache_hits, s.m_infer_type_cache_misses,
+        s.m_whnf_core_calls, s.m_whnf_core_cache_hits, s.m_whnf_core_cache_misses,
+        s.m_whnf_calls, s.m_whnf_cache_hits, s.m_whnf_cache_misses,
+        s.m_is_def_eq_core_calls, s.m_failed_before_hits, s.m_reduce_nat_hits,
+        s.m_hash_cons_hits, s.m_hash_cons_misses, s.m_instantiate_calls
+    };
+    unsigned num_counters = sizeof(counters) / sizeof(counters[0]);
+    object * unfoldings = lean_mk_empty_array_with_capacity(box(s.m_unfoldings.size()));
+    for (auto const & p : s.m_unfoldings)
+        unfoldings = lean_array_push(unfoldings, mk_cnstr(0, p.first, object_ref(lean_usize_to_nat(p.second))).steal());
+    object * r = alloc_cnstr(0, num_counters + 1, 0);
+    for (unsigned i = 0; i < num_counters; i++)
+        cnstr_set(r, i, lean_usize_to_nat(counters[i]));
+    cnstr_set(r, num_counters, unfoldings);
+    return object_ref(r);
+}
+
+/*
+@[extern "lean_add_decl_with_stats"]
+opaque addDeclWithStats (env : Environment) (decl : @& Declaration) : Except KernelException (Environment × Kernel.Stats)
+*/
+extern "C" LEAN_EXPORT object * lean_add_decl_with_stats(object * env, object * decl) {
+    return catch_kernel_exceptions<object_ref>([&]() {
+            type_checker_stats stats;
+            optional<environment> new_env;
+            {
+                scoped_type_checker_stats scope(stats);
+                new_env = environment(env).add(declaration(decl, true));
+            }
+            return mk_cnstr(0, *new_env, type_checker_stats_to_object(stats));
+        });
+}
+
 void environment::for_each_constant(std::function<void(constant_info const & d)> const & f) const {
     smap_foreach(cnstr_get(raw(), 1), [&](object *, object * v) {
             constant_info cinfo(v, true);
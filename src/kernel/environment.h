@@ -23,6 +23,14 @@ Author: Leonardo de Moura
 #define LEAN_BELIEVER_TRUST_LEVEL 1024
 #endif
 
+#ifndef LEAN_CHECK_CACHE_TRUST_LEVEL
+/* If an environment E is created with a trust level >= LEAN_CHECK_CACHE_TRUST_LEVEL, then
+   declarations found in the persistent check cache (see `kernel/check_cache.h`) are added to E
+   without type checking them. It is above the default trust level of `lean`, so this must be requested
+   explicitly (e.g., `lean --trust=2048`). */
+#define LEAN_CHECK_CACHE_TRUST_LEVEL 2048
+#endif
+
 namespace lean {
 class environment_extension {
 public:
@@ -45,6 +53,7 @@ class environment : public object_ref {
     environment add_mutual(declaration const & d, bool check) const;
     environment add_quot() const;
     environment add_inductive(declaration const & d) const;
+    environment add_declaration(declaration const & d, bool check) const;
 public:
     environment(unsigned trust_lvl = 0);
     environment(environment const & other):object_ref(other) {}
@@ -71,6 +80,15 @@ public:
     /** \brief Return information for the constant with name \c n. Throws and exception if constant declaration does not exist in this environment. */
     constant_info get(name const & n) const;
 
+    /** \brief Return true iff the constant \c n was declared in an imported module. */
+    bool is_imported(name const & n) const;
+
+    /** \brief Return an object identifying the imports of this environment: environments with the same key have
+        the same imported constants. It is set at import time, and shared by all environments obtained from this one
+        using \c add. Caches keyed on it must also be cleared when the imported modules are freed, see
+        `register_compacted_region_free_fn`. */
+    object_ref get_imports_key() const;
+
     /** \brief Extends the current environment with the given declaration */
     environment add(declaration const & d, bool check = true) const;
 
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <utility>
 #include "runtime/interrupt.h"
 #include "runtime/flet.h"
 #include "kernel/equiv_manager.h"
@@ -14,6 +15,7 @@ auto equiv_manager::mk_node() -> node_ref {
     node n;
     n.m_parent = r;
     n.m_rank   = 0;
+    n.m_generation = 0;
     m_nodes.push_back(n);
     return r;
 }
@@ -23,7 +25,10 @@ auto equiv_manager::find(node_ref n) -> node_ref {
         node_ref p = m_nodes[n].m_parent;
         if (p == n)
             return p;
-        n = p;
+        /* path halving */
+        node_ref g = m_nodes[p].m_parent;
+        m_nodes[n].m_parent = g;
+        n = g;
     }
 }
 
@@ -35,21 +40,23 @@ void equiv_manager::merge(node_ref n1, node_ref n2) {
         node & ref2 = m_nodes[r2];
         if (ref1.m_rank < ref2.m_rank) {
             ref1.m_parent = r2;
+            ref2.m_generation++;
         } else if (ref1.m_rank > ref2.m_rank) {
             ref2.m_parent = r1;
+            ref1.m_generation++;
         } else {
             ref2.m_parent = r1;
             ref1.m_rank++;
+            ref1.m_generation++;
         }
     }
 }
 
 auto equiv_manager::to_node(expr const & e) -> node_ref {
-    auto it = m_to_node.find(e);
-    if (it != m_to_node.end())
-        return it->second;
+    if (node_ref const * n = m_to_node.find(e))
+        return *n;
     node_ref r = mk_node();
-    m_to_node.insert(mk_pair(e, r));
+    m_to_node.insert(e, r);
     return r;
 }
 
@@ -124,4 +131,20 @@ void equiv_manager::add_equiv(expr const & e1, expr const & e2) {
     node_ref r2 = to_node(e2);
     merge(r1, r2);
 }
+
+auto equiv_manager::mk_diff_key(expr const & e1, expr const & e2) -> diff_key {
+    node_ref r1 = find(to_node(e1));
+    node_ref r2 = find(to_node(e2));
+    if (r1 > r2)
+        std::swap(r1, r2);
+    return diff_key{r1, r2, m_nodes[r1].m_generation, m_nodes[r2].m_generation};
+}
+
+bool equiv_manager::is_known_different(expr const & e1, expr const & e2) {
+    return m_different.contains(mk_diff_key(e1, e2));
+}
+
+void equiv_manager::add_known_different(expr const & e1, expr const & e2) {
+    m_different.insert(mk_diff_key(e1, e2), unit());
+}
 }
@@ -6,29 +6,60 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <vector>
-#include "kernel/expr_maps.h"
+#include "util/unit.h"
+#include "kernel/expr_flat_map.h"
 
 namespace lean {
+/** \brief Union-find over the expressions compared by the type checker.
+
+    It records the equivalence classes of expressions that are known to be definitionally equal, and pairs of
+    classes that are known to be different. Expressions are mapped to nodes using a flat table that stores their
+    (cached) hash codes, and nodes are stored in a contiguous arena with path compression.
+
+    A class is "known different" from another one if comparing the arguments of two applications with the same
+    head (one in each class) failed. This is only used to skip this comparison in `lazy_delta_reduction_step`.
+    Each root has a generation counter that is incremented when its class grows, and facts about a class are
+    recorded with the generation of its root, so that facts about the smaller class are not used for the new one. */
 class equiv_manager {
     typedef unsigned node_ref;
 
     struct node {
         node_ref m_parent;
         unsigned m_rank;
+        unsigned m_generation;
+    };
+
+    struct diff_key {
+        node_ref m_r1, m_r2;
+        unsigned m_g1, m_g2;
+    };
+    struct diff_key_hash {
+        unsigned operator()(diff_key const & k) const {
+            return hash(hash(k.m_r1, k.m_g1), hash(k.m_r2, k.m_g2));
+        }
+    };
+    struct diff_key_eq {
+        bool operator()(diff_key const & k1, diff_key const & k2) const {
+            return k1.m_r1 == k2.m_r1 && k1.m_r2 == k2.m_r2 && k1.m_g1 == k2.m_g1 && k1.m_g2 == k2.m_g2;
+        }
     };
 
-    std::vector<node>  m_nodes;
-    expr_map<node_ref> m_to_node;
-    bool               m_use_hash;
+    std::vector<node>                                              m_nodes;
+    expr_flat_map<node_ref>                                        m_to_node;
+    expr_flat_table<diff_key, unit, diff_key_hash, diff_key_eq>    m_different;
+    bool                                                           m_use_hash;
 
     node_ref mk_node();
     node_ref find(node_ref n);
     void merge(node_ref n1, node_ref n2);
     node_ref to_node(expr const & e);
+    diff_key mk_diff_key(expr const & e1, expr const & e2);
     bool is_equiv_core(expr const & e1, expr const & e2);
 public:
     equiv_manager():m_use_hash(false) {}
     bool is_equiv(expr const & e1, expr const & e2, bool use_hash = false);
     void add_equiv(expr const & e1, expr const & e2);
+    bool is_known_different(expr const & e1, expr const & e2);
+    void add_known_different(expr const & e1, expr const & e2);
 };
 }
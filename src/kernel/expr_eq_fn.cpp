@@ -10,43 +10,44 @@ Author: Leonardo de Moura
 #include "runtime/thread.h"
 #include "kernel/expr.h"
 #include "kernel/expr_sets.h"
+#include "kernel/set_assoc_cache.h"
 
 #ifndef LEAN_EQ_CACHE_CAPACITY
 #define LEAN_EQ_CACHE_CAPACITY 1024*8
 #endif
 
+#ifndef LEAN_MAX_EQ_CACHE_CAPACITY
+#define LEAN_MAX_EQ_CACHE_CAPACITY 1024*256
+#endif
+
 namespace lean {
+struct eq_cache_entry {
+    object * m_a = nullptr;
+    object * m_b;
+    unsigned m_hash;
+    bool empty() const { return m_a == nullptr; }
+};
+
 struct eq_cache {
-    struct entry {
-        object * m_a;
-        object * m_b;
-        entry():m_a(nullptr), m_b(nullptr) {}
-    };
-    unsigned              m_capacity;
-    std::vector<entry>    m_cache;
-    std::vector<unsigned> m_used;
-    eq_cache():m_capacity(LEAN_EQ_CACHE_CAPACITY), m_cache(LEAN_EQ_CACHE_CAPACITY) {}
+    set_assoc_cache<eq_cache_entry> m_cache;
+    eq_cache():m_cache(LEAN_EQ_CACHE_CAPACITY, LEAN_MAX_EQ_CACHE_CAPACITY, get_eq_cache_stats()) {}
 
+    /* Return true if `a` and `b` were already compared, and record them otherwise. */
     bool check(expr const & a, expr const & b) {
         if (!is_shared(a) || !is_shared(b))
             return false;
-        unsigned i = hash(hash(a), hash(b)) % m_capacity;
-        if (m_cache[i].m_a == a.raw() && m_cache[i].m_b == b.raw()) {
+        unsigned h = hash(hash(a), hash(b));
+        if (m_cache.find(h, [&](eq_cache_entry const & e) { return e.m_a == a.raw() && e.m_b == b.raw(); }))
             return true;
-        } else {
-            if (m_cache[i].m_a == nullptr)
-                m_used.push_back(i);
-            m_cache[i].m_a = a.raw();
-            m_cache[i].m_b = b.raw();
-            return false;
-        }
+        eq_cache_entry e;
+        e.m_a    = a.raw();
+        e.m_b    = b.raw();
+        e.m_hash = h;
+        m_cache.insert(std::move(e));
+        return false;
     }
 
-    void clear() {
-        for (unsigned i : m_used)
-            m_cache[i].m_a = nullptr;
-        m_used.clear();
-    }
+    void clear() { m_cache.clear(); }
 };
 
 /* CACHE_RESET: No */
@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <vector>
+#include <utility>
+#include "kernel/expr.h"
+#include "kernel/expr_eq_fn.h"
+
+namespace lean {
+/** \brief Flat (open-addressing, linear probing) hash table for the caches of the type checker.
+
+    Each slot stores the hash code of its key next to the key itself. Thus, probing only compares keys
+    when the hash codes match, and growing the table does not recompute hash codes. Keys are compared
+    using pointer equality first, and structural equality only if the pointers are different.
+
+    The capacity is always a power of two, and the table is rehashed when it is more than 3/4 full.
+    Entries are never removed individually. */
+template<typename Key, typename T, typename Hash, typename Eq>
+class expr_flat_table {
+    struct entry {
+        unsigned m_hash = 0;
+        bool     m_used = false;
+        Key      m_key;
+        T        m_value;
+    };
+    std::vector<entry> m_table;
+    size_t             m_size = 0;
+
+    size_t find_slot(Key const & k, unsigned h) const {
+        size_t mask = m_table.size() - 1;
+        size_t i    = h & mask;
+        while (true) {
+            entry const & e = m_table[i];
+            if (!e.m_used || (e.m_hash == h && Eq()(e.m_key, k)))
+                return i;
+            i = (i + 1) & mask;
+        }
+    }
+
+    void grow() {
+        std::vector<entry> old_table(m_table.empty() ? 16 : 2 * m_table.size());
+        old_table.swap(m_table);
+        size_t mask = m_table.size() - 1;
+        for (entry & e : old_table) {
+            if (!e.m_used)
+                continue;
+            size_t i = e.m_hash & mask;
+            while (m_table[i].m_used)
+                i = (i + 1) & mask;
+            m_table[i] = std::move(e);
+        }
+    }
+public:
+    T const * find(Key const & k) const {
+        if (m_size == 0)
+            return nullptr;
+        entry const & e = m_table[find_slot(k, Hash()(k))];
+        return e.m_used ? &e.m_value : nullptr;
+    }
+
+    bool contains(Key const & k) const { return find(k) != nullptr; }
+
+    /** \brief Associate `v` with `k`. If `k` is already in the table, its value is *not* updated,
+        as in `std::unordered_map::insert`. */
+    void insert(Key const & k, T const & v) {
+        if (4 * (m_size + 1) > 3 * m_table.size())
+            grow();
+        unsigned h = Hash()(k);
+        entry & e = m_table[find_slot(k, h)];
+        if (e.m_used)
+            return;
+        e.m_hash  = h;
+        e.m_used  = true;
+        e.m_key   = k;
+        e.m_value = v;
+        m_size++;
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    void clear() {
+        m_table.clear();
+        m_size = 0;
+    }
+};
+
+struct expr_eqp_or_eq {
+    bool operator()(expr const & a, expr const & b) const { return is_eqp(a, b) || a == b; }
+};
+
+template<typename T>
+using expr_flat_map = expr_flat_table<expr, T, expr_hash, expr_eqp_or_eq>;
+}
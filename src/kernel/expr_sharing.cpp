@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include "runtime/interrupt.h"
+#include "runtime/buffer.h"
+#include "kernel/expr_sharing.h"
+
+namespace lean {
+expr expr_sharing_table::share(expr const & e) {
+    struct frame {
+        expr const & m_expr;
+        bool         m_expanded;
+        frame(expr const & e):m_expr(e), m_expanded(false) {}
+    };
+    buffer<frame, 64> todo;
+    buffer<expr, 64>  results;
+    /* Shared nodes of `e` that are not in the table yet. They are visited once, since comparing them
+       structurally with their canonical representative would be linear in their size. */
+    std::unordered_map<lean_object *, expr> visited;
+    todo.emplace_back(e);
+    while (!todo.empty()) {
+        frame & f = todo.back();
+        expr const & a = f.m_expr;
+        if (!f.m_expanded) {
+            if (is_shared(a)) {
+                auto it = visited.find(a.raw());
+                if (it != visited.end()) {
+                    results.push_back(it->second);
+                    todo.pop_back();
+                    continue;
+                }
+            }
+            auto it = m_table.find(a);
+            if (it != m_table.end()) {
+                if (!is_eqp(*it, a))
+                    m_hits++;
+                results.push_back(*it);
+                todo.pop_back();
+                continue;
+            }
+            switch (a.kind()) {
+            case expr_kind::BVar: case expr_kind::Lit:  case expr_kind::MVar:
+            case expr_kind::FVar: case expr_kind::Sort: case expr_kind::Const:
+                m_table.insert(a);
+                m_misses++;
+                results.push_back(a);
+                todo.pop_back();
+                continue;
+            default:
+                break;
+            }
+            check_system("hash-consing");
+            f.m_expanded = true;
+            /* `f` is invalidated by the following `emplace_back`s. Children are pushed in reverse order. */
+            switch (a.kind()) {
+            case expr_kind::MData: todo.emplace_back(mdata_expr(a)); break;
+            case expr_kind::Proj:  todo.emplace_back(proj_expr(a)); break;
+            case expr_kind::App:
+                todo.emplace_back(app_arg(a));
+                todo.emplace_back(app_fn(a));
+                break;
+            case expr_kind::Lambda: case expr_kind::Pi:
+                todo.emplace_back(binding_body(a));
+                todo.emplace_back(binding_domain(a));
+                break;
+            case expr_kind::Let:
+                todo.emplace_back(let_body(a));
+                todo.emplace_back(let_value(a));
+                todo.emplace_back(let_type(a));
+                break;
+            default:
+                lean_unreachable();
+            }
+        } else {
+            expr r;
+            size_t sz = results.size();
+            switch (a.kind()) {
+            case expr_kind::MData:
+                r = update_mdata(a, results[sz-1]);
+                results.shrink(sz-1);
+                break;
+            case expr_kind::Proj:
+                r = update_proj(a, results[sz-1]);
+                results.shrink(sz-1);
+                break;
+            case expr_kind::App:
+                r = update_app(a, results[sz-2], results[sz-1]);
+                results.shrink(sz-2);
+                break;
+            case expr_kind::Lambda: case expr_kind::Pi:
+                r = update_binding(a, results[sz-2], results[sz-1]);
+                results.shrink(sz-2);
+                break;
+            case expr_kind::Let:
+                r = update_let(a, results[sz-3], results[sz-2], results[sz-1]);
+                results.shrink(sz-3);
+                break;
+            default:
+                lean_unreachable();
+            }
+            /* `a` was not in the table, and `r` is structurally equal to `a`. */
+            m_table.insert(r);
+            m_misses++;
+            if (is_shared(a))
+                visited.insert(mk_pair(a.raw(), r));
+            todo.pop_back();
+            results.push_back(r);
+        }
+    }
+    lean_assert(results.size() == 1);
+    return results.back();
+}
+
+bool get_expr_sharing_default() {
+    static bool r = [] {
+        char const * v = std::getenv("LEAN_KERNEL_HASH_CONS");
+        return v != nullptr && std::strcmp(v, "0") != 0;
+    }();
+    return r;
+}
+}
@@ -0,0 +1,34 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <unordered_set>
+#include "kernel/expr.h"
+#include "kernel/expr_eq_fn.h"
+
+namespace lean {
+/** \brief Incremental hash-consing table for expressions created by the type checker.
+
+    Unlike `max_sharing_fn`, the table is meant to be applied to many terms that share subterms with terms
+    that have already been processed (e.g., the results of `whnf` and `infer_type`): the traversal stops at
+    subterms that are already in the table, so only the nodes created since the last call are visited.
+    After `share(e)`, structurally equal subterms of all processed terms are pointer equal, and the pointer
+    based caches and fast paths (e.g., `is_eqp` in `quick_is_def_eq`) hit more often. */
+class expr_sharing_table {
+    std::unordered_set<expr, expr_hash, is_bi_equal_proc> m_table;
+    /* Number of nodes replaced with an existing structurally equal node. */
+    size_t m_hits   = 0;
+    /* Number of nodes added to the table. */
+    size_t m_misses = 0;
+public:
+    expr share(expr const & e);
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+    void clear() { m_table.clear(); }
+};
+
+/** \brief Return true if the kernel type checker should hash-cons the results it caches.
+    It is set using the environment variable `LEAN_KERNEL_HASH_CONS`. */
+bool get_expr_sharing_default();
+}
@@ -12,6 +12,9 @@ Author: Leonardo de Moura
 #include "kernel/local_ctx.h"
 #include "kernel/inductive.h"
 #include "kernel/quot.h"
+#include "kernel/closed_term_cache.h"
+#include "kernel/nbe.h"
+#include "kernel/check_cache.h"
 
 namespace lean {
 void initialize_kernel_module() {
@@ -23,9 +26,15 @@ void initialize_kernel_module() {
     initialize_local_ctx();
     initialize_inductive();
     initialize_quot();
+    initialize_closed_term_cache();
+    initialize_nbe();
+    initialize_check_cache();
 }
 
 void finalize_kernel_module() {
+    finalize_check_cache();
+    finalize_nbe();
+    finalize_closed_term_cache();
     finalize_quot();
     finalize_inductive();
     finalize_local_ctx();
@@ -6,15 +6,23 @@ Author: Leonardo de Moura
 */
 #include <algorithm>
 #include <limits>
+#include "runtime/thread.h"
 #include "kernel/replace_fn.h"
 #include "kernel/declaration.h"
 #include "kernel/kernel_exception.h"
 #include "kernel/instantiate.h"
 
 namespace lean {
+LEAN_THREAD_VALUE(uint64, g_num_instantiate_calls, 0);
+
+uint64 get_num_instantiate_calls() {
+    return g_num_instantiate_calls;
+}
+
 expr instantiate(expr const & a, unsigned s, unsigned n, expr const * subst) {
     if (s >= get_loose_bvar_range(a) || n == 0)
         return a;
+    g_num_instantiate_calls++;
     return replace(a, [=](expr const & m, unsigned offset) -> optional<expr> {
             unsigned s1 = s + offset;
             if (s1 < s)
@@ -99,6 +107,7 @@ extern "C" LEAN_EXPORT object * lean_expr_instantiate_range(b_obj_arg a, b_obj_a
 expr instantiate_rev(expr const & a, unsigned n, expr const * subst) {
     if (!has_loose_bvars(a))
         return a;
+    g_num_instantiate_calls++;
     return replace(a, [=](expr const & m, unsigned offset) -> optional<expr> {
             if (offset >= get_loose_bvar_range(m))
                 return some_expr(m); // expression m does not contain loose bound variables with idx >= offset
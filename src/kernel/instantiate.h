@@ -24,6 +24,10 @@ inline expr instantiate_rev(expr const & e, buffer<expr> const & s) {
     return instantiate_rev(e, s.size(), s.data());
 }
 
+/** \brief Number of calls to \c instantiate and \c instantiate_rev with loose bound variables to replace
+    performed by the current thread. It is used to report kernel statistics. */
+uint64 get_num_instantiate_calls();
+
 expr apply_beta(expr f, unsigned num_rev_args, expr const * rev_args);
 bool is_head_beta(expr const & t);
 expr head_beta_reduce(expr const & t);
@@ -8,14 +8,21 @@ Author: Leonardo de Moura
 #include <algorithm>
 #include <vector>
 #include <unordered_set>
+#include <unordered_map>
 #include "runtime/debug.h"
+#include "runtime/thread.h"
 #include "runtime/interrupt.h"
 #include "runtime/hash.h"
 #include "runtime/buffer.h"
+#include "runtime/compact.h"
 #include "util/list.h"
 #include "kernel/level.h"
 #include "kernel/environment.h"
 
+#ifndef LEAN_LEVEL_CACHE_CAPACITY
+#define LEAN_LEVEL_CACHE_CAPACITY 1024*64
+#endif
+
 namespace lean {
 
 extern "C" unsigned lean_level_hash(obj_arg l);
@@ -426,7 +433,7 @@ level mk_succ(level l, unsigned k) {
     return l;
 }
 
-level normalize(level const & l) {
+static level normalize_core(level const & l) {
     auto p = to_offset(l);
     level const & r = p.first;
     switch (kind(r)) {
@@ -490,6 +497,82 @@ level normalize(level const & l) {
     lean_unreachable(); // LCOV_EXCL_LINE
 }
 
+/* Memo tables for `normalize` and `is_geq`. Type checking universe polymorphic code compares the same level
+   expressions over and over again. The normal forms are hash-consed: structurally equal normal forms computed
+   by a thread are represented by the same object, so that they can be compared using pointer equality.
+   The levels of imported declarations are stored in compacted regions, so the tables are dropped when regions
+   are freed, see `check_epoch`. */
+struct level_cache {
+    struct level_pair_hash {
+        unsigned operator()(std::pair<level, level> const & p) const { return hash(hash(p.first), hash(p.second)); }
+    };
+    struct level_pair_eq {
+        bool operator()(std::pair<level, level> const & p1, std::pair<level, level> const & p2) const {
+            return p1.first == p2.first && p1.second == p2.second;
+        }
+    };
+    std::unordered_map<level, level, level_hash, level_eq>                            m_normalize;
+    std::unordered_map<std::pair<level, level>, bool, level_pair_hash, level_pair_eq> m_geq;
+    /* See `get_compacted_region_epoch`. */
+    size_t                                                                            m_epoch = get_compacted_region_epoch();
+
+    void clear() {
+        m_normalize.clear();
+        m_geq.clear();
+        m_epoch = get_compacted_region_epoch();
+    }
+
+    /* If regions have been freed since the entries were cached, they may refer to unmapped memory, so they are
+       leaked instead of released. */
+    bool check_epoch() {
+        if (m_epoch == get_compacted_region_epoch())
+            return true;
+        new std::unordered_map<level, level, level_hash, level_eq>(std::move(m_normalize));
+        new std::unordered_map<std::pair<level, level>, bool, level_pair_hash, level_pair_eq>(std::move(m_geq));
+        clear();
+        return false;
+    }
+
+    void check_capacity() {
+        check_epoch();
+        if (m_normalize.size() + m_geq.size() > LEAN_LEVEL_CACHE_CAPACITY)
+            clear();
+    }
+
+    ~level_cache() {
+        check_epoch();
+    }
+};
+
+/* CACHE_RESET: NO */
+MK_THREAD_LOCAL_GET_DEF(level_cache, get_level_cache);
+
+/* Called by `lean_compacted_region_free`, the tables of other threads are dropped by `level_cache::check_epoch`. */
+static void clear_level_cache() {
+    get_level_cache().clear();
+}
+
+level normalize(level const & l) {
+    level const * r = &l;
+    while (is_succ(*r))
+        r = &succ_of(*r);
+    if (!is_max(*r) && !is_imax(*r))
+        return l;
+    level_cache & c = get_level_cache();
+    c.check_capacity();
+    auto it = c.m_normalize.find(l);
+    if (it != c.m_normalize.end())
+        return it->second;
+    level n = normalize_core(l);
+    auto n_it = c.m_normalize.find(n);
+    if (n_it != c.m_normalize.end())
+        n = n_it->second;
+    else
+        c.m_normalize.insert(mk_pair(n, n));
+    c.m_normalize.insert(mk_pair(l, n));
+    return n;
+}
+
 bool is_equivalent(level const & lhs, level const & rhs) {
     check_system("level constraints");
     return lhs == rhs || normalize(lhs) == normalize(rhs);
@@ -515,7 +598,17 @@ bool is_geq_core(level l1, level l2) {
     return false;
 }
 bool is_geq(level const & l1, level const & l2) {
-    return is_geq_core(normalize(l1), normalize(l2));
+    if (is_eqp(l1, l2) || is_zero(l2))
+        return true;
+    level_cache & c = get_level_cache();
+    c.check_capacity();
+    auto key = mk_pair(l1, l2);
+    auto it  = c.m_geq.find(key);
+    if (it != c.m_geq.end())
+        return it->second;
+    bool r = is_geq_core(normalize(l1), normalize(l2));
+    c.m_geq.insert(mk_pair(key, r));
+    return r;
 }
 levels lparams_to_levels(names const & ps) {
     buffer<level> ls;
@@ -532,6 +625,7 @@ void initialize_level() {
     mark_persistent(g_level_zero->raw());
     g_level_one  = new level(mk_succ(*g_level_zero));
     mark_persistent(g_level_one->raw());
+    register_compacted_region_free_fn(clear_level_cache);
 }
 
 void finalize_level() {
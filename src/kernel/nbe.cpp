@@ -0,0 +1,556 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include "runtime/interrupt.h"
+#include "runtime/exception.h"
+#include "runtime/thread.h"
+#include "runtime/compact.h"
+#include "util/nat.h"
+#include "kernel/nbe.h"
+
+/* Maximum number of values and environment cells kept alive by the values of imported constants cached in a
+   thread, see `nbe_thread_state::m_num_cells`. */
+#ifndef LEAN_NBE_CACHE_CAPACITY
+#define LEAN_NBE_CACHE_CAPACITY 1024*16
+#endif
+
+namespace lean {
+enum class nbe_nat_op { Succ, Log2, Add, Sub, Mul, Div, Mod, Gcd, Pow, Beq, Ble, Land, Lor, Xor, ShiftLeft, ShiftRight };
+static std::unordered_map<name, nbe_nat_op, name_hash_fn> * g_nbe_nat_ops = nullptr;
+static name * g_nbe_nat_zero   = nullptr;
+static name * g_nbe_nat_succ   = nullptr;
+static name * g_nbe_bool_true  = nullptr;
+static name * g_nbe_bool_false = nullptr;
+
+namespace {
+/* Thrown when the evaluator gets stuck. */
+struct nbe_stuck {};
+
+struct value;
+struct env_cell;
+typedef std::shared_ptr<value>    value_ptr;
+typedef std::shared_ptr<env_cell> env_ptr;
+
+/* Environments are persistent lists of values, the value of bound variable `#0` is at the head. */
+struct env_cell {
+    value_ptr m_head;
+    env_ptr   m_tail;
+    env_cell(value_ptr const & h, env_ptr const & t);
+    ~env_cell();
+};
+
+enum class value_kind { Thunk, Nat, Closure, ConstApp, Type };
+
+struct value {
+    value_kind              m_kind;
+    /* `Thunk`: code and environment of a delayed computation.
+       `Closure`: a lambda and the environment of its loose bound variables. */
+    optional<expr>          m_expr;
+    env_ptr                 m_env;
+    /* `Thunk`: cached result after it has been forced. */
+    value_ptr               m_result;
+    /* `Nat`: a literal. */
+    optional<nat>           m_nat;
+    /* `ConstApp`: constant (constructor, recursor, quotient, `Nat` primitive, axiom, ...) applied to arguments. */
+    optional<constant_info> m_info;
+    std::vector<value_ptr>  m_args;
+    explicit value(value_kind k);
+    ~value();
+};
+
+/* State of the evaluator shared by all calls in the same thread. */
+struct nbe_thread_state {
+    /* Values and environments are released iteratively, as kernel expressions are: the destructors of `value`
+       and `env_cell` move the children that are about to be deleted to these buffers instead of deleting them
+       recursively. Otherwise, releasing a long evaluated list or environment could overflow the stack. */
+    std::vector<value_ptr>                            m_dead_values;
+    std::vector<env_ptr>                              m_dead_envs;
+    bool                                              m_releasing = false;
+    /* Values of imported definitions and theorems. They are only valid for environments with the same
+       imports, see `set_env`. */
+    optional<object_ref>                              m_imports_key;
+    std::unordered_map<name, value_ptr, name_hash_fn> m_const_values;
+    /* Number of live values and environment cells of this thread. Between evaluations, these are the ones kept
+       alive by `m_const_values`, so that `set_env` bounds the size of the cached values, which grow as their
+       thunks are forced, rather than their number. */
+    size_t                                            m_num_cells = 0;
+    /* See `get_compacted_region_epoch`. */
+    size_t                                            m_epoch     = get_compacted_region_epoch();
+
+    void release(value_ptr & v) {
+        if (v && v.use_count() == 1)
+            m_dead_values.push_back(std::move(v));
+        v.reset();
+    }
+
+    void release(env_ptr & e) {
+        if (e && e.use_count() == 1)
+            m_dead_envs.push_back(std::move(e));
+        e.reset();
+    }
+
+    void release_pending() {
+        if (m_releasing)
+            return;
+        m_releasing = true;
+        while (!m_dead_values.empty() || !m_dead_envs.empty()) {
+            if (!m_dead_values.empty()) {
+                value_ptr v = std::move(m_dead_values.back());
+                m_dead_values.pop_back();
+            } else {
+                env_ptr e = std::move(m_dead_envs.back());
+                m_dead_envs.pop_back();
+            }
+        }
+        m_releasing = false;
+    }
+
+    void clear() {
+        m_const_values.clear();
+        m_imports_key = optional<object_ref>();
+        m_epoch       = get_compacted_region_epoch();
+    }
+
+    /* If imported modules have been freed since the values were cached, they may refer to unmapped memory, so
+       they are leaked instead of released. */
+    bool check_epoch() {
+        if (m_epoch == get_compacted_region_epoch())
+            return true;
+        new std::unordered_map<name, value_ptr, name_hash_fn>(std::move(m_const_values));
+        m_num_cells = 0;
+        clear();
+        return false;
+    }
+
+    /* Make sure `m_const_values` was computed in an environment with the same imports as `env`, and that the
+       cached values are not too big. */
+    void set_env(environment const & env) {
+        check_epoch();
+        object_ref imports_key = env.get_imports_key();
+        if (m_imports_key && m_imports_key->raw() == imports_key.raw() && m_num_cells < LEAN_NBE_CACHE_CAPACITY)
+            return;
+        m_const_values.clear();
+        m_imports_key = imports_key;
+    }
+
+    ~nbe_thread_state() {
+        /* Release the cached values while the buffers above are still alive. */
+        if (check_epoch())
+            m_const_values.clear();
+    }
+};
+
+/* CACHE_RESET: NO */
+MK_THREAD_LOCAL_GET_DEF(nbe_thread_state, get_nbe_thread_state);
+
+/* Called by `lean_compacted_region_free`, the values of imported constants cached by other threads are dropped by
+   `nbe_thread_state::check_epoch`. */
+static void clear_nbe_thread_state() {
+    get_nbe_thread_state().clear();
+}
+
+env_cell::env_cell(value_ptr const & h, env_ptr const & t):m_head(h), m_tail(t) {
+    get_nbe_thread_state().m_num_cells++;
+}
+
+env_cell::~env_cell() {
+    nbe_thread_state & s = get_nbe_thread_state();
+    s.m_num_cells--;
+    s.release(m_head);
+    s.release(m_tail);
+    s.release_pending();
+}
+
+value::value(value_kind k):m_kind(k) {
+    get_nbe_thread_state().m_num_cells++;
+}
+
+value::~value() {
+    nbe_thread_state & s = get_nbe_thread_state();
+    s.m_num_cells--;
+    s.release(m_env);
+    s.release(m_result);
+    for (value_ptr & arg : m_args)
+        s.release(arg);
+    s.release_pending();
+}
+
+class nbe_fn {
+    environment const &                                            m_env;
+    nbe_thread_state &                                             m_thread_state;
+    std::unordered_map<name, optional<constant_info>, name_hash_fn> m_constants;
+    /* Values of definitions and theorems that were not imported; the values of imported ones are stored in
+       `m_thread_state`. Thus, each body is evaluated at most once. */
+    std::unordered_map<name, value_ptr, name_hash_fn>              m_const_values;
+    value_ptr                                                      m_type;
+
+    constant_info get_constant(name const & n) {
+        auto it = m_constants.find(n);
+        if (it == m_constants.end())
+            it = m_constants.insert(mk_pair(n, m_env.find(n))).first;
+        if (!it->second)
+            throw nbe_stuck();
+        return *it->second;
+    }
+
+    value_ptr mk_nat(nat const & n) {
+        value_ptr r = std::make_shared<value>(value_kind::Nat);
+        r->m_nat = n;
+        return r;
+    }
+
+    value_ptr mk_closure(expr const & e, env_ptr const & env) {
+        value_ptr r = std::make_shared<value>(value_kind::Closure);
+        r->m_expr = e;
+        r->m_env  = env;
+        return r;
+    }
+
+    value_ptr mk_const_app(constant_info const & info) {
+        value_ptr r = std::make_shared<value>(value_kind::ConstApp);
+        r->m_info = info;
+        return r;
+    }
+
+    value_ptr mk_bool(bool b) {
+        return mk_const_app(get_constant(b ? *g_nbe_bool_true : *g_nbe_bool_false));
+    }
+
+    static env_ptr cons(value_ptr const & v, env_ptr const & env) {
+        return std::make_shared<env_cell>(v, env);
+    }
+
+    static value_ptr const & lookup(env_ptr const & env, expr const & e) {
+        nat const & idx = bvar_idx(e);
+        if (!idx.is_small())
+            throw nbe_stuck();
+        env_cell const * it = env.get();
+        for (size_t i = idx.get_small_value(); it && i > 0; i--)
+            it = it->m_tail.get();
+        if (!it)
+            throw nbe_stuck(); // loose bound variable
+        return it->m_head;
+    }
+
+    value_ptr mk_thunk(expr const & e, env_ptr const & env) {
+        switch (e.kind()) {
+        case expr_kind::BVar:
+            return lookup(env, e);
+        case expr_kind::Lit:
+            if (lit_value(e).kind() == literal_kind::Nat)
+                return mk_nat(lit_value(e).get_nat());
+            break;
+        case expr_kind::Sort: case expr_kind::Pi:
+            return m_type;
+        case expr_kind::Lambda:
+            return mk_closure(e, env);
+        default:
+            break;
+        }
+        value_ptr r = std::make_shared<value>(value_kind::Thunk);
+        r->m_expr = e;
+        r->m_env  = env;
+        return r;
+    }
+
+    value_ptr force(value_ptr const & v) {
+        if (v->m_kind != value_kind::Thunk)
+            return v;
+        if (!v->m_result) {
+            expr e      = *v->m_expr;
+            env_ptr env = v->m_env;
+            v->m_result = eval(e, env);
+            v->m_expr   = none_expr();
+            v->m_env.reset();
+        }
+        return v->m_result;
+    }
+
+    value_ptr eval_constant(expr const & e) {
+        name const & n = const_name(e);
+        if (n == *g_nbe_nat_zero)
+            return mk_nat(nat(0u));
+        bool imported = m_env.is_imported(n);
+        auto & const_values = imported ? m_thread_state.m_const_values : m_const_values;
+        auto it = const_values.find(n);
+        if (it != const_values.end())
+            return it->second;
+        constant_info info = get_constant(n);
+        value_ptr r;
+        if ((info.is_definition() || info.is_theorem()) && g_nbe_nat_ops->find(n) == g_nbe_nat_ops->end()) {
+            r = eval(info.get_value(), env_ptr());
+        } else {
+            r = mk_const_app(info);
+        }
+        const_values.insert(mk_pair(n, r));
+        return r;
+    }
+
+    value_ptr eval_proj(expr const & e, env_ptr const & env) {
+        value_ptr s = eval(proj_expr(e), env);
+        if (s->m_kind != value_kind::ConstApp || !s->m_info->is_constructor() || !proj_idx(e).is_small())
+            throw nbe_stuck();
+        size_t idx = s->m_info->to_constructor_val().get_nparams() + proj_idx(e).get_small_value();
+        if (idx >= s->m_args.size())
+            throw nbe_stuck();
+        return force(s->m_args[idx]);
+    }
+
+    value_ptr apply(value_ptr f, std::vector<value_ptr> const & args) {
+        size_t i = 0;
+        while (i < args.size()) {
+            switch (f->m_kind) {
+            case value_kind::Closure: {
+                expr body   = *f->m_expr;
+                env_ptr env = f->m_env;
+                while (is_lambda(body) && i < args.size()) {
+                    env  = cons(args[i], env);
+                    body = binding_body(body);
+                    i++;
+                }
+                if (is_lambda(body))
+                    return mk_closure(body, env);
+                f = eval(body, env);
+                break;
+            }
+            case value_kind::ConstApp: {
+                value_ptr r = std::make_shared<value>(value_kind::ConstApp);
+                r->m_info = f->m_info;
+                r->m_args = f->m_args;
+                r->m_args.insert(r->m_args.end(), args.begin() + i, args.end());
+                return reduce_const_app(r);
+            }
+            default:
+                throw nbe_stuck();
+            }
+        }
+        return f;
+    }
+
+    value_ptr reduce_const_app(value_ptr const & v) {
+        constant_info const & info = *v->m_info;
+        if (info.is_recursor())
+            return reduce_rec(v);
+        if (info.is_quot())
+            return reduce_quot(v);
+        auto it = g_nbe_nat_ops->find(info.get_name());
+        if (it != g_nbe_nat_ops->end())
+            return reduce_nat_op(it->second, v);
+        return v;
+    }
+
+    nat force_nat(value_ptr const & v) {
+        value_ptr r = force(v);
+        if (r->m_kind != value_kind::Nat)
+            throw nbe_stuck();
+        return *r->m_nat;
+    }
+
+    /* Same operations as `type_checker::reduce_nat`. */
+    value_ptr reduce_nat_op(nbe_nat_op op, value_ptr const & v) {
+        unsigned arity = (op == nbe_nat_op::Succ || op == nbe_nat_op::Log2) ? 1 : 2;
+        if (v->m_args.size() < arity)
+            return v;
+        if (v->m_args.size() > arity)
+            throw nbe_stuck();
+        nat a = force_nat(v->m_args[0]);
+        if (op == nbe_nat_op::Succ)
+            return mk_nat(a + nat(1u));
+        if (op == nbe_nat_op::Log2)
+            return mk_nat(nat(nat_log2(a.raw())));
+        nat b = force_nat(v->m_args[1]);
+        switch (op) {
+        case nbe_nat_op::Add:        return mk_nat(nat(nat_add(a.raw(), b.raw())));
+        case nbe_nat_op::Sub:        return mk_nat(nat(nat_sub(a.raw(), b.raw())));
+        case nbe_nat_op::Mul:        return mk_nat(nat(nat_mul(a.raw(), b.raw())));
+        case nbe_nat_op::Div:        return mk_nat(nat(nat_div(a.raw(), b.raw())));
+        case nbe_nat_op::Mod:        return mk_nat(nat(nat_mod(a.raw(), b.raw())));
+        case nbe_nat_op::Gcd:        return mk_nat(nat(nat_gcd(a.raw(), b.raw())));
+        case nbe_nat_op::Pow:        return mk_nat(nat(nat_pow(a.raw(), b.raw())));
+        case nbe_nat_op::Land:       return mk_nat(nat(nat_land(a.raw(), b.raw())));
+        case nbe_nat_op::Lor:        return mk_nat(nat(nat_lor(a.raw(), b.raw())));
+        case nbe_nat_op::Xor:        return mk_nat(nat(nat_lxor(a.raw(), b.raw())));
+        case nbe_nat_op::ShiftRight: return mk_nat(nat(nat_shiftr(a.raw(), b.raw())));
+        case nbe_nat_op::ShiftLeft:
+            if (!b.is_small() || b.get_small_value() > std::numeric_limits<unsigned>::max())
+                throw nbe_stuck();
+            return mk_nat(nat(nat_shiftl(a.raw(), b.raw())));
+        case nbe_nat_op::Beq:        return mk_bool(nat_eq(a.raw(), b.raw()));
+        case nbe_nat_op::Ble:        return mk_bool(nat_le(a.raw(), b.raw()));
+        case nbe_nat_op::Succ: case nbe_nat_op::Log2:
+            break;
+        }
+        lean_unreachable();
+    }
+
+    /* Same as `inductive_reduce_rec`, but K-like and structure eta reduction are not supported. */
+    value_ptr reduce_rec(value_ptr const & v) {
+        recursor_val const & rec_val = v->m_info->to_recursor_val();
+        unsigned major_idx = rec_val.get_major_idx();
+        if (v->m_args.size() <= major_idx)
+            return v;
+        value_ptr major = force(v->m_args[major_idx]);
+        name cnstr;
+        std::vector<value_ptr> major_args;
+        if (major->m_kind == value_kind::Nat) {
+            nat const & n = *major->m_nat;
+            if (n.is_zero()) {
+                cnstr = *g_nbe_nat_zero;
+            } else {
+                cnstr = *g_nbe_nat_succ;
+                major_args.push_back(mk_nat(n - nat(1u)));
+            }
+        } else if (major->m_kind == value_kind::ConstApp && major->m_info->is_constructor()) {
+            cnstr      = major->m_info->get_name();
+            major_args = major->m_args;
+        } else {
+            throw nbe_stuck();
+        }
+        optional<recursor_rule> rule;
+        for (recursor_rule const & r : rec_val.get_rules()) {
+            if (r.get_cnstr() == cnstr) {
+                rule = r;
+                break;
+            }
+        }
+        if (!rule || rule->get_nfields() > major_args.size())
+            throw nbe_stuck();
+        unsigned nfields = rule->get_nfields();
+        /* parameters, motives and minor premises, fields from major premise, and remaining arguments */
+        std::vector<value_ptr> args(v->m_args.begin(), v->m_args.begin() + rec_val.get_nparams() + rec_val.get_nmotives() + rec_val.get_nminors());
+        args.insert(args.end(), major_args.end() - nfields, major_args.end());
+        args.insert(args.end(), v->m_args.begin() + major_idx + 1, v->m_args.end());
+        return apply(eval(rule->get_rhs(), env_ptr()), args);
+    }
+
+    /* Same as `quot_reduce_rec`. */
+    value_ptr reduce_quot(value_ptr const & v) {
+        unsigned mk_pos;
+        switch (v->m_info->to_quot_val().get_quot_kind()) {
+        case quot_kind::Lift: mk_pos = 5; break;
+        case quot_kind::Ind:  mk_pos = 4; break;
+        default:              return v;
+        }
+        unsigned arg_pos = 3;
+        if (v->m_args.size() <= mk_pos)
+            return v;
+        value_ptr mk = force(v->m_args[mk_pos]);
+        if (mk->m_kind != value_kind::ConstApp || !mk->m_info->is_quot() ||
+            mk->m_info->to_quot_val().get_quot_kind() != quot_kind::Mk || mk->m_args.size() != 3)
+            throw nbe_stuck();
+        std::vector<value_ptr> args;
+        args.push_back(mk->m_args[2]);
+        args.insert(args.end(), v->m_args.begin() + mk_pos + 1, v->m_args.end());
+        return apply(force(v->m_args[arg_pos]), args);
+    }
+
+public:
+    nbe_fn(environment const & env):
+        m_env(env), m_thread_state(get_nbe_thread_state()), m_type(std::make_shared<value>(value_kind::Type)) {
+        m_thread_state.set_env(env);
+    }
+
+    value_ptr eval(expr const & e, env_ptr const & env) {
+        check_system("nbe", /* do_check_interrupted */ true);
+        switch (e.kind()) {
+        case expr_kind::BVar:
+            return force(lookup(env, e));
+        case expr_kind::Sort: case expr_kind::Pi:
+            return m_type;
+        case expr_kind::Lit:
+            if (lit_value(e).kind() == literal_kind::Nat)
+                return mk_nat(lit_value(e).get_nat());
+            throw nbe_stuck();
+        case expr_kind::MData:
+            return eval(mdata_expr(e), env);
+        case expr_kind::Lambda:
+            return mk_closure(e, env);
+        case expr_kind::Let:
+            return eval(let_body(e), cons(mk_thunk(let_value(e), env), env));
+        case expr_kind::App: {
+            buffer<expr> args;
+            expr const & f = get_app_args(e, args);
+            std::vector<value_ptr> vargs;
+            vargs.reserve(args.size());
+            for (expr const & arg : args)
+                vargs.push_back(mk_thunk(arg, env));
+            return apply(eval(f, env), vargs);
+        }
+        case expr_kind::Const:
+            return eval_constant(e);
+        case expr_kind::Proj:
+            return eval_proj(e, env);
+        case expr_kind::FVar: case expr_kind::MVar:
+            throw nbe_stuck();
+        }
+        lean_unreachable();
+    }
+};
+}
+
+optional<name> nbe_eval_constructor(environment const & env, expr const & e) {
+    if (has_fvar(e) || has_loose_bvars(e) || has_metavar(e))
+        return optional<name>();
+    try {
+        value_ptr v = nbe_fn(env).eval(e, env_ptr());
+        if (v->m_kind == value_kind::ConstApp && v->m_info->is_constructor())
+            return optional<name>(v->m_info->get_name());
+        if (v->m_kind == value_kind::Nat)
+            return optional<name>(v->m_nat->is_zero() ? *g_nbe_nat_zero : *g_nbe_nat_succ);
+    } catch (nbe_stuck &) {
+    } catch (stack_space_exception &) {
+    }
+    return optional<name>();
+}
+
+bool get_nbe_default() {
+    static bool r = [] {
+        char const * v = std::getenv("LEAN_KERNEL_NBE");
+        return v != nullptr && std::strcmp(v, "0") != 0;
+    }();
+    return r;
+}
+
+/*
+@[extern "lean_kernel_nbe_eval_constructor"]
+opaque nbeEvalConstructor? (env : @& Environment) (e : @& Expr) : Option Name
+*/
+extern "C" LEAN_EXPORT object * lean_kernel_nbe_eval_constructor(b_obj_arg env, b_obj_arg e) {
+    if (optional<name> r = nbe_eval_constructor(environment(env, true), expr(e, true)))
+        return mk_option_some(r->to_obj_arg());
+    return mk_option_none();
+}
+
+void initialize_nbe() {
+    g_nbe_nat_zero   = new name{"Nat", "zero"};
+    g_nbe_nat_succ   = new name{"Nat", "succ"};
+    g_nbe_bool_true  = new name{"Bool", "true"};
+    g_nbe_bool_false = new name{"Bool", "false"};
+    g_nbe_nat_ops    = new std::unordered_map<name, nbe_nat_op, name_hash_fn>();
+    std::pair<char const *, nbe_nat_op> ops[] = {
+        {"succ", nbe_nat_op::Succ}, {"log2", nbe_nat_op::Log2}, {"add", nbe_nat_op::Add}, {"sub", nbe_nat_op::Sub},
+        {"mul", nbe_nat_op::Mul}, {"div", nbe_nat_op::Div}, {"mod", nbe_nat_op::Mod}, {"gcd", nbe_nat_op::Gcd},
+        {"pow", nbe_nat_op::Pow}, {"beq", nbe_nat_op::Beq}, {"ble", nbe_nat_op::Ble}, {"land", nbe_nat_op::Land},
+        {"lor", nbe_nat_op::Lor}, {"xor", nbe_nat_op::Xor}, {"shiftLeft", nbe_nat_op::ShiftLeft},
+        {"shiftRight", nbe_nat_op::ShiftRight}
+    };
+    for (auto const & p : ops)
+        g_nbe_nat_ops->insert(mk_pair(name{"Nat", p.first}, p.second));
+    register_compacted_region_free_fn(clear_nbe_thread_state);
+}
+
+void finalize_nbe() {
+    delete g_nbe_nat_ops;
+    delete g_nbe_bool_false;
+    delete g_nbe_bool_true;
+    delete g_nbe_nat_succ;
+    delete g_nbe_nat_zero;
+}
+}
@@ -0,0 +1,31 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include "kernel/environment.h"
+
+namespace lean {
+/** \brief Evaluate the closed term \c e to weak head normal form, and return the name of the constructor at
+    its head, or \c none if \c e does not evaluate to a constructor application.
+
+    This is a fast path for checking closed computations (e.g., `Decidable.decide p =?= true`). The evaluator
+    uses call-by-need closures over the definitions stored in \c env: it performs only beta, zeta, delta
+    (definitions and theorems), iota (recursors and quotients), projection and `Nat` literal reductions,
+    exactly as the type checker does. It never uses code generated by the compiler nor `implemented_by`
+    annotations. It returns \c none whenever it gets stuck (e.g., at an axiom, an opaque constant, a free
+    variable, or a recursor whose major premise requires K-like or structure eta reduction), so that the caller
+    can fall back to the type checker.
+
+    Universe levels are ignored, since they do not affect reduction. The values of imported definitions are
+    cached across calls in the same thread, as long as they are used with environments with the same imports,
+    the imported modules are not freed, and they are not too big (see `LEAN_NBE_CACHE_CAPACITY`). */
+optional<name> nbe_eval_constructor(environment const & env, expr const & e);
+
+/** \brief Return true if the kernel type checker should use \c nbe_eval_constructor for closed
+    `t =?= Bool.true` problems (e.g., `Decidable.decide p =?= true`). It is set using the environment variable `LEAN_KERNEL_NBE`. */
+bool get_nbe_default();
+
+void initialize_nbe();
+void finalize_nbe();
+}
@@ -6,111 +6,185 @@ Author: Leonardo de Moura
 */
 #include <vector>
 #include <memory>
+#include "runtime/buffer.h"
+#include "runtime/memory.h"
 #include "kernel/replace_fn.h"
 #include "kernel/cache_stack.h"
+#include "kernel/set_assoc_cache.h"
 
 #ifndef LEAN_DEFAULT_REPLACE_CACHE_CAPACITY
 #define LEAN_DEFAULT_REPLACE_CACHE_CAPACITY 1024*8
 #endif
 
+#ifndef LEAN_MAX_REPLACE_CACHE_CAPACITY
+#define LEAN_MAX_REPLACE_CACHE_CAPACITY 1024*256
+#endif
+
 namespace lean {
+struct replace_cache_entry {
+    object *   m_cell = nullptr;
+    unsigned   m_offset;
+    unsigned   m_hash;
+    expr       m_result;
+    bool empty() const { return m_cell == nullptr; }
+};
+
 struct replace_cache {
-    struct entry {
-        object  *  m_cell;
-        unsigned   m_offset;
-        expr       m_result;
-        entry():m_cell(nullptr) {}
-    };
-    unsigned              m_capacity;
-    std::vector<entry>    m_cache;
-    std::vector<unsigned> m_used;
-    replace_cache(unsigned c):m_capacity(c), m_cache(c) {}
+    set_assoc_cache<replace_cache_entry> m_cache;
+    replace_cache(unsigned c):m_cache(c, LEAN_MAX_REPLACE_CACHE_CAPACITY, get_replace_cache_stats()) {}
 
     expr * find(expr const & e, unsigned offset) {
-        unsigned i = hash(hash(e), offset) % m_capacity;
-        if (m_cache[i].m_cell == e.raw() && m_cache[i].m_offset == offset)
-            return &m_cache[i].m_result;
-        else
-            return nullptr;
+        replace_cache_entry * r = m_cache.find(hash(hash(e), offset), [&](replace_cache_entry const & entry) {
+                return entry.m_cell == e.raw() && entry.m_offset == offset;
+            });
+        return r ? &r->m_result : nullptr;
     }
 
     void insert(expr const & e, unsigned offset, expr const & v) {
-        unsigned i = hash(hash(e), offset) % m_capacity;
-        if (m_cache[i].m_cell == nullptr)
-            m_used.push_back(i);
-        m_cache[i].m_cell   = e.raw();
-        m_cache[i].m_offset = offset;
-        m_cache[i].m_result = v;
+        replace_cache_entry entry;
+        entry.m_cell   = e.raw();
+        entry.m_offset = offset;
+        entry.m_hash   = hash(hash(e), offset);
+        entry.m_result = v;
+        m_cache.insert(std::move(entry));
     }
 
-    void clear() {
-        for (unsigned i : m_used) {
-            m_cache[i].m_cell   = nullptr;
-            m_cache[i].m_result = expr();
-        }
-        m_used.clear();
-    }
+    void clear() { m_cache.clear(); }
 };
 
 /* CACHE_RESET: NO */
 MK_CACHE_STACK(replace_cache, LEAN_DEFAULT_REPLACE_CACHE_CAPACITY)
 
+/* `replace` uses an explicit stack instead of native recursion, so that deeply nested terms (e.g., long list
+   literals and `do` blocks) do not exhaust the C++ stack. Subterms are visited (and `m_f` is invoked) in the
+   same order as the recursive traversal, and the same results are cached. */
 class replace_rec_fn {
+    /* A subterm whose children have been scheduled, the result is built once all children have been processed. */
+    struct frame {
+        expr const & m_expr;
+        unsigned     m_offset;
+        bool         m_shared;
+        bool         m_expanded;
+        frame(expr const & e, unsigned offset):m_expr(e), m_offset(offset), m_shared(false), m_expanded(false) {}
+    };
     replace_cache_ref                                     m_cache;
     std::function<optional<expr>(expr const &, unsigned)> m_f;
     bool                                                  m_use_cache;
+    buffer<frame, 64>                                     m_todo;
+    buffer<expr, 64>                                      m_results;
 
-    expr save_result(expr const & e, unsigned offset, expr const & r, bool shared) {
+    void save_result(expr const & e, unsigned offset, expr const & r, bool shared) {
         if (shared)
             m_cache->insert(e, offset, r);
-        return r;
+        m_results.push_back(r);
     }
 
-    expr apply(expr const & e, unsigned offset) {
-        bool shared = false;
+    /* Pop the results of the children of `e`, and push the result for `e`. */
+    void build(frame const & fr) {
+        expr const & e  = fr.m_expr;
+        size_t sz       = m_results.size();
+        switch (e.kind()) {
+        case expr_kind::MData: {
+            expr new_e = update_mdata(e, m_results[sz-1]);
+            m_results.shrink(sz-1);
+            return save_result(e, fr.m_offset, new_e, fr.m_shared);
+        }
+        case expr_kind::Proj: {
+            expr new_e = update_proj(e, m_results[sz-1]);
+            m_results.shrink(sz-1);
+            return save_result(e, fr.m_offset, new_e, fr.m_shared);
+        }
+        case expr_kind::App: {
+            expr new_e = update_app(e, m_results[sz-2], m_results[sz-1]);
+            m_results.shrink(sz-2);
+            return save_result(e, fr.m_offset, new_e, fr.m_shared);
+        }
+        case expr_kind::Pi: case expr_kind::Lambda: {
+            expr new_e = update_binding(e, m_results[sz-2], m_results[sz-1]);
+            m_results.shrink(sz-2);
+            return save_result(e, fr.m_offset, new_e, fr.m_shared);
+        }
+        case expr_kind::Let: {
+            expr new_e = update_let(e, m_results[sz-3], m_results[sz-2], m_results[sz-1]);
+            m_results.shrink(sz-3);
+            return save_result(e, fr.m_offset, new_e, fr.m_shared);
+        }
+        default:
+            lean_unreachable();
+        }
+    }
+
+    /* Process `e` if it is cached, `m_f` replaces it, or it is atomic. Otherwise, schedule its children. */
+    void visit(frame & fr) {
+        expr const & e  = fr.m_expr;
+        unsigned offset = fr.m_offset;
         if (m_use_cache && is_shared(e)) {
-            if (auto r = m_cache->find(e, offset))
-                return *r;
-            shared = true;
+            if (auto r = m_cache->find(e, offset)) {
+                m_results.push_back(*r);
+                m_todo.pop_back();
+                return;
+            }
+            fr.m_shared = true;
         }
-        check_system("replace");
+        check_memory("replace");
+        check_heartbeat();
 
+        bool shared = fr.m_shared;
         if (optional<expr> r = m_f(e, offset)) {
+            m_todo.pop_back();
             return save_result(e, offset, *r, shared);
-        } else {
-            switch (e.kind()) {
-            case expr_kind::Const: case expr_kind::Sort:
-            case expr_kind::BVar:  case expr_kind::Lit:
-            case expr_kind::MVar:  case expr_kind::FVar:
-                return save_result(e, offset, e, shared);
-            case expr_kind::MData: {
-                expr new_e = apply(mdata_expr(e), offset);
-                return save_result(e, offset, update_mdata(e, new_e), shared);
-            }
-            case expr_kind::Proj: {
-                expr new_e = apply(proj_expr(e), offset);
-                return save_result(e, offset, update_proj(e, new_e), shared);
-            }
-            case expr_kind::App: {
-                expr new_f = apply(app_fn(e), offset);
-                expr new_a = apply(app_arg(e), offset);
-                return save_result(e, offset, update_app(e, new_f, new_a), shared);
-            }
-            case expr_kind::Pi: case expr_kind::Lambda: {
-                expr new_d = apply(binding_domain(e), offset);
-                expr new_b = apply(binding_body(e), offset+1);
-                return save_result(e, offset, update_binding(e, new_d, new_b), shared);
-            }
-            case expr_kind::Let: {
-                expr new_t = apply(let_type(e), offset);
-                expr new_v = apply(let_value(e), offset);
-                expr new_b = apply(let_body(e), offset+1);
-                return save_result(e, offset, update_let(e, new_t, new_v, new_b), shared);
-            }
-            }
+        }
+        switch (e.kind()) {
+        case expr_kind::Const: case expr_kind::Sort:
+        case expr_kind::BVar:  case expr_kind::Lit:
+        case expr_kind::MVar:  case expr_kind::FVar:
+            m_todo.pop_back();
+            return save_result(e, offset, e, shared);
+        default:
+            break;
+        }
+        fr.m_expanded = true;
+        /* `fr` is invalidated by the following `emplace_back`s. Children are pushed in reverse order. */
+        switch (e.kind()) {
+        case expr_kind::MData:
+            m_todo.emplace_back(mdata_expr(e), offset);
+            return;
+        case expr_kind::Proj:
+            m_todo.emplace_back(proj_expr(e), offset);
+            return;
+        case expr_kind::App:
+            m_todo.emplace_back(app_arg(e), offset);
+            m_todo.emplace_back(app_fn(e), offset);
+            return;
+        case expr_kind::Pi: case expr_kind::Lambda:
+            m_todo.emplace_back(binding_body(e), offset+1);
+            m_todo.emplace_back(binding_domain(e), offset);
+            return;
+        case expr_kind::Let:
+            m_todo.emplace_back(let_body(e), offset+1);
+            m_todo.emplace_back(let_value(e), offset);
+            m_todo.emplace_back(let_type(e), offset);
+            return;
+        default:
             lean_unreachable();
         }
     }
+
+    expr apply(expr const & e, unsigned offset) {
+        m_todo.emplace_back(e, offset);
+        while (!m_todo.empty()) {
+            frame & fr = m_todo.back();
+            if (fr.m_expanded) {
+                frame done = fr;
+                m_todo.pop_back();
+                build(done);
+            } else {
+                visit(fr);
+            }
+        }
+        lean_assert(m_results.size() == 1);
+        return m_results.back();
+    }
 public:
     template<typename F>
     replace_rec_fn(F const & f, bool use_cache):m_f(f), m_use_cache(use_cache) {}
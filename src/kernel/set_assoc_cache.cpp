@@ -0,0 +1,33 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include "runtime/object.h"
+#include "runtime/io.h"
+#include "kernel/set_assoc_cache.h"
+
+namespace lean {
+static set_assoc_cache_stats g_replace_cache_stats;
+static set_assoc_cache_stats g_eq_cache_stats;
+
+set_assoc_cache_stats & get_replace_cache_stats() { return g_replace_cache_stats; }
+set_assoc_cache_stats & get_eq_cache_stats() { return g_eq_cache_stats; }
+
+static void set_stats_fields(object * r, unsigned i, set_assoc_cache_stats const & s) {
+    cnstr_set(r, i,   lean_uint64_to_nat(s.m_hits));
+    cnstr_set(r, i+1, lean_uint64_to_nat(s.m_misses));
+    cnstr_set(r, i+2, lean_uint64_to_nat(s.m_collisions));
+    cnstr_set(r, i+3, lean_uint64_to_nat(s.m_resizes));
+}
+
+/*
+@[extern "lean_kernel_get_expr_cache_stats"]
+opaque getExprCacheStats : BaseIO ExprCacheStats
+*/
+extern "C" LEAN_EXPORT object * lean_kernel_get_expr_cache_stats(object *) {
+    object * r = alloc_cnstr(0, 8, 0);
+    set_stats_fields(r, 0, g_replace_cache_stats);
+    set_stats_fields(r, 4, g_eq_cache_stats);
+    return io_result_mk_ok(r);
+}
+}
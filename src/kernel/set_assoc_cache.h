@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "runtime/debug.h"
+
+namespace lean {
+/** \brief Counters shared by all instances of a kind of traversal cache (e.g., all `replace` caches). */
+struct set_assoc_cache_stats {
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    /* Number of insertions that evicted an entry. */
+    std::atomic<uint64_t> m_collisions{0};
+    std::atomic<uint64_t> m_resizes{0};
+};
+
+set_assoc_cache_stats & get_replace_cache_stats();
+set_assoc_cache_stats & get_eq_cache_stats();
+
+/** \brief Set-associative cache used by expression traversals (`replace`, `is_equal`).
+
+    Entries are hashed into sets of \c Ways entries, and the oldest entry of a full set is evicted.
+    The number of sets doubles (up to \c max_capacity entries) when the number of evictions since the last
+    resize exceeds the capacity, i.e., when a traversal visits more shared subterms than the cache can hold.
+    `clear` only resets the sets that were used, so a cache that has grown is still cheap to reuse for small terms.
+
+    \c Entry must be default constructible, have a field `unsigned m_hash`, and a method `bool empty() const`
+    that returns true for default constructed entries. */
+template<typename Entry, unsigned Ways = 4>
+class set_assoc_cache {
+    unsigned                m_num_sets;
+    unsigned                m_max_sets;
+    std::vector<Entry>      m_entries;
+    /* Sets that contain at least one entry. */
+    std::vector<unsigned>   m_used;
+    set_assoc_cache_stats & m_stats;
+    uint64_t                m_hits       = 0;
+    uint64_t                m_misses     = 0;
+    uint64_t                m_collisions = 0;
+    uint64_t                m_resizes    = 0;
+    uint64_t                m_collisions_since_resize = 0;
+
+    static unsigned round_up_pow2(unsigned n) {
+        unsigned r = 1;
+        while (r < n) r <<= 1;
+        return r;
+    }
+
+    Entry * get_set(unsigned h) { return m_entries.data() + (h & (m_num_sets - 1)) * Ways; }
+
+    void insert_core(Entry && e, bool count) {
+        Entry * set = get_set(e.m_hash);
+        if (set[0].empty())
+            m_used.push_back(e.m_hash & (m_num_sets - 1));
+        if (!set[Ways-1].empty() && count) {
+            m_collisions++;
+            m_collisions_since_resize++;
+        }
+        for (unsigned i = Ways - 1; i > 0; i--)
+            set[i] = std::move(set[i-1]);
+        set[0] = std::move(e);
+    }
+
+    void grow() {
+        std::vector<Entry> old_entries(m_num_sets * 2 * Ways);
+        std::vector<unsigned> old_used;
+        old_entries.swap(m_entries);
+        old_used.swap(m_used);
+        m_num_sets *= 2;
+        m_resizes++;
+        m_collisions_since_resize = 0;
+        for (unsigned s : old_used) {
+            /* Reinsert the oldest entries first, so that the eviction order is preserved. */
+            for (unsigned i = Ways; i > 0; i--) {
+                Entry & e = old_entries[s * Ways + i - 1];
+                if (!e.empty())
+                    insert_core(std::move(e), false);
+            }
+        }
+    }
+
+    void flush_stats() {
+        m_stats.m_hits.fetch_add(m_hits, std::memory_order_relaxed);
+        m_stats.m_misses.fetch_add(m_misses, std::memory_order_relaxed);
+        m_stats.m_collisions.fetch_add(m_collisions, std::memory_order_relaxed);
+        m_stats.m_resizes.fetch_add(m_resizes, std::memory_order_relaxed);
+        m_hits = m_misses = m_collisions = m_resizes = 0;
+    }
+
+public:
+    set_assoc_cache(unsigned capacity, unsigned max_capacity, set_assoc_cache_stats & stats):
+        m_num_sets(round_up_pow2((capacity + Ways - 1) / Ways)),
+        m_max_sets(round_up_pow2((max_capacity + Ways - 1) / Ways)),
+        m_entries(m_num_sets * Ways),
+        m_stats(stats) {}
+
+    ~set_assoc_cache() { flush_stats(); }
+
+    unsigned capacity() const { return m_num_sets * Ways; }
+
+    /** \brief Return the entry with hash code \c h that satisfies \c is_key, or \c nullptr. */
+    template<typename P> Entry * find(unsigned h, P && is_key) {
+        Entry * set = get_set(h);
+        for (unsigned i = 0; i < Ways; i++) {
+            if (set[i].empty())
+                break;
+            if (set[i].m_hash == h && is_key(set[i])) {
+                m_hits++;
+                return set + i;
+            }
+        }
+        m_misses++;
+        return nullptr;
+    }
+
+    /** \brief Insert \c e, the caller must make sure it is not already in the cache. */
+    void insert(Entry && e) {
+        insert_core(std::move(e), true);
+        if (m_collisions_since_resize > capacity() && m_num_sets < m_max_sets)
+            grow();
+    }
+
+    void clear() {
+        for (unsigned s : m_used) {
+            Entry * set = m_entries.data() + s * Ways;
+            for (unsigned i = 0; i < Ways; i++)
+                set[i] = Entry();
+        }
+        m_used.clear();
+        m_collisions_since_resize = 0;
+        /* Counters are published in batches to avoid contention on the shared atomics. */
+        if (m_hits + m_misses >= 1024)
+            flush_stats();
+    }
+};
+}
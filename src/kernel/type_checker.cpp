@@ -6,9 +6,11 @@ Author: Leonardo de Moura
 */
 #include <utility>
 #include <vector>
+#include <limits>
 #include "runtime/interrupt.h"
 #include "runtime/sstream.h"
 #include "runtime/flet.h"
+#include "runtime/thread.h"
 #include "util/lbool.h"
 #include "kernel/type_checker.h"
 #include "kernel/expr_maps.h"
@@ -19,6 +21,10 @@ Author: Leonardo de Moura
 #include "kernel/for_each_fn.h"
 #include "kernel/quot.h"
 #include "kernel/inductive.h"
+#include "kernel/closed_term_cache.h"
+#include "kernel/whnf_machine.h"
+#include "kernel/nbe.h"
+#include "kernel/expr_sharing.h"
 
 namespace lean {
 static name * g_kernel_fresh = nullptr;
@@ -35,9 +41,65 @@ static expr * g_nat_mod      = nullptr;
 static expr * g_nat_div      = nullptr;
 static expr * g_nat_beq      = nullptr;
 static expr * g_nat_ble      = nullptr;
+static expr * g_nat_land     = nullptr;
+static expr * g_nat_lor      = nullptr;
+static expr * g_nat_xor      = nullptr;
+static expr * g_nat_shiftl   = nullptr;
+static expr * g_nat_shiftr   = nullptr;
+static expr * g_nat_log2     = nullptr;
+
+LEAN_THREAD_PTR(type_checker_stats, g_type_checker_stats);
+
+void type_checker_stats::add(type_checker_stats const & s) {
+    m_infer_type_calls        += s.m_infer_type_calls;
+    m_infer_type_cache_hits   += s.m_infer_type_cache_hits;
+    m_infer_type_cache_misses += s.m_infer_type_cache_misses;
+    m_whnf_core_calls         += s.m_whnf_core_calls;
+    m_whnf_core_cache_hits    += s.m_whnf_core_cache_hits;
+    m_whnf_core_cache_misses  += s.m_whnf_core_cache_misses;
+    m_whnf_calls              += s.m_whnf_calls;
+    m_whnf_cache_hits         += s.m_whnf_cache_hits;
+    m_whnf_cache_misses       += s.m_whnf_cache_misses;
+    m_is_def_eq_core_calls    += s.m_is_def_eq_core_calls;
+    m_failed_before_hits      += s.m_failed_before_hits;
+    m_reduce_nat_hits         += s.m_reduce_nat_hits;
+    m_hash_cons_hits          += s.m_hash_cons_hits;
+    m_hash_cons_misses        += s.m_hash_cons_misses;
+    m_instantiate_calls       += s.m_instantiate_calls;
+    for (auto const & p : s.m_unfoldings)
+        m_unfoldings[p.first] += p.second;
+}
+
+scoped_type_checker_stats::scoped_type_checker_stats(type_checker_stats & s):
+    m_old_stats(g_type_checker_stats), m_old_instantiate_calls(get_num_instantiate_calls()), m_stats(s) {
+    g_type_checker_stats = &s;
+}
+
+scoped_type_checker_stats::~scoped_type_checker_stats() {
+    m_stats.m_instantiate_calls += get_num_instantiate_calls() - m_old_instantiate_calls;
+    g_type_checker_stats = m_old_stats;
+}
 
 type_checker::state::state(environment const & env):
-    m_env(env), m_ngen(*g_kernel_fresh) {}
+    m_env(env), m_ngen(*g_kernel_fresh), m_use_whnf_machine(get_whnf_machine_default()),
+    m_use_nbe(get_nbe_default()), m_use_sharing(get_expr_sharing_default()) {}
+
+type_checker::state::~state() {
+    m_stats.m_hash_cons_hits   += m_sharing.hits();
+    m_stats.m_hash_cons_misses += m_sharing.misses();
+    if (g_type_checker_stats)
+        g_type_checker_stats->add(m_stats);
+}
+
+/** \brief Return a term structurally equal to \c e whose subterms are shared with the other cached results. */
+expr type_checker::share(expr const & e) {
+    return m_st->m_use_sharing ? m_st->m_sharing.share(e) : e;
+}
+
+void type_checker::count_unfolding(constant_info const & info) {
+    if (g_type_checker_stats)
+        m_st->m_stats.m_unfoldings[info.get_name()]++;
+}
 
 /** \brief Make sure \c e "is" a sort, and return the corresponding sort.
     If \c e is not a sort, then the whnf procedure is invoked.
@@ -289,9 +351,20 @@ expr type_checker::infer_type_core(expr const & e, bool infer_only) {
     lean_assert(!has_loose_bvars(e));
     check_system("type checker", /* do_check_interrupted */ true);
 
-    auto it = m_st->m_infer_type[infer_only].find(e);
-    if (it != m_st->m_infer_type[infer_only].end())
-        return it->second;
+    m_st->m_stats.m_infer_type_calls++;
+    if (expr const * r = m_st->m_infer_type[infer_only].find(e)) {
+        m_st->m_stats.m_infer_type_cache_hits++;
+        return *r;
+    }
+    m_st->m_stats.m_infer_type_cache_misses++;
+
+    bool shared = infer_only && is_closed_term_cache_candidate(env(), e, m_st->m_closed_term_candidates);
+    if (shared) {
+        if (optional<expr> r = closed_term_cache_find(env(), closed_term_cache_kind::InferOnly, e)) {
+            m_st->m_infer_type[infer_only].insert(e, *r);
+            return *r;
+        }
+    }
 
     expr r;
     switch (e.kind()) {
@@ -313,7 +386,10 @@ expr type_checker::infer_type_core(expr const & e, bool infer_only) {
     case expr_kind::Let:      r = infer_let(e, infer_only);            break;
     }
 
-    m_st->m_infer_type[infer_only].insert(mk_pair(e, r));
+    r = share(r);
+    m_st->m_infer_type[infer_only].insert(e, r);
+    if (shared)
+        closed_term_cache_insert(env(), closed_term_cache_kind::InferOnly, e, r);
     return r;
 }
 
@@ -411,6 +487,7 @@ static bool is_let_fvar(local_ctx const & lctx, expr const & e) {
     We also do not cache results. */
 expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
     check_system("type checker: whnf", /* do_check_interrupted */ true);
+    m_st->m_stats.m_whnf_core_calls++;
 
     // handle easy cases
     switch (e.kind()) {
@@ -431,9 +508,11 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
     }
 
     // check cache
-    auto it = m_st->m_whnf_core.find(e);
-    if (it != m_st->m_whnf_core.end())
-        return it->second;
+    if (expr const * r = m_st->m_whnf_core.find(e)) {
+        m_st->m_stats.m_whnf_core_cache_hits++;
+        return *r;
+    }
+    m_st->m_stats.m_whnf_core_cache_misses++;
 
     // do the actual work
     expr r;
@@ -452,6 +531,13 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
         break;
     }
     case expr_kind::App: {
+        if (m_st->m_use_whnf_machine) {
+            expr e1 = whnf_machine_beta_zeta(e);
+            if (!is_eqp(e1, e)) {
+                r = whnf_core(e1, cheap_rec, cheap_proj);
+                break;
+            }
+        }
         buffer<expr> args;
         expr f0 = get_app_rev_args(e, args);
         expr f = whnf_core(f0, cheap_rec, cheap_proj);
@@ -478,12 +564,16 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
         break;
     }
     case expr_kind::Let:
-        r = whnf_core(instantiate(let_body(e), let_value(e)), cheap_rec, cheap_proj);
+        if (m_st->m_use_whnf_machine)
+            r = whnf_core(whnf_machine_beta_zeta(e), cheap_rec, cheap_proj);
+        else
+            r = whnf_core(instantiate(let_body(e), let_value(e)), cheap_rec, cheap_proj);
         break;
     }
 
     if (!cheap_rec && !cheap_proj) {
-        m_st->m_whnf_core.insert(mk_pair(e, r));
+        r = share(r);
+        m_st->m_whnf_core.insert(e, r);
     }
     return r;
 }
@@ -586,7 +676,7 @@ template<typename F> optional<expr> type_checker::reduce_bin_nat_pred(F const &
     return f(v1.raw(), v2.raw()) ? some_expr(mk_bool_true()) : some_expr(mk_bool_false());
 }
 
-optional<expr> type_checker::reduce_nat(expr const & e) {
+optional<expr> type_checker::reduce_nat_core(expr const & e) {
     if (has_fvar(e)) return none_expr();
     unsigned nargs = get_app_num_args(e);
     if (nargs == 1) {
@@ -597,6 +687,12 @@ optional<expr> type_checker::reduce_nat(expr const & e) {
             nat v = get_nat_val(arg);
             return some_expr(mk_lit(literal(nat(v+nat(1)))));
         }
+        if (f == *g_nat_log2) {
+            expr arg = whnf(app_arg(e));
+            if (!is_nat_lit_ext(arg)) return none_expr();
+            nat v = get_nat_val(arg);
+            return some_expr(mk_lit(literal(nat(nat_log2(v.raw())))));
+        }
     } else if (nargs == 2) {
         expr const & f = app_fn(app_fn(e));
         if (!is_constant(f)) return none_expr();
@@ -609,12 +705,32 @@ optional<expr> type_checker::reduce_nat(expr const & e) {
         if (f == *g_nat_div) return reduce_bin_nat_op(nat_div, e);
         if (f == *g_nat_beq) return reduce_bin_nat_pred(nat_eq, e);
         if (f == *g_nat_ble) return reduce_bin_nat_pred(nat_le, e);
+        if (f == *g_nat_land) return reduce_bin_nat_op(nat_land, e);
+        if (f == *g_nat_lor) return reduce_bin_nat_op(nat_lor, e);
+        if (f == *g_nat_xor) return reduce_bin_nat_op(nat_lxor, e);
+        if (f == *g_nat_shiftr) return reduce_bin_nat_op(nat_shiftr, e);
+        if (f == *g_nat_shiftl) {
+            /* `nat_shiftl` panics if the shift amount does not fit in an `unsigned`. */
+            expr arg2 = whnf(app_arg(e));
+            if (!is_nat_lit_ext(arg2)) return none_expr();
+            nat v2 = get_nat_val(arg2);
+            if (!v2.is_small() || v2.get_small_value() > std::numeric_limits<unsigned>::max()) return none_expr();
+            return reduce_bin_nat_op(nat_shiftl, e);
+        }
     }
     return none_expr();
 }
 
+optional<expr> type_checker::reduce_nat(expr const & e) {
+    optional<expr> r = reduce_nat_core(e);
+    if (r)
+        m_st->m_stats.m_reduce_nat_hits++;
+    return r;
+}
+
 /** \brief Put expression \c t in weak head normal form */
 expr type_checker::whnf(expr const & e) {
+    m_st->m_stats.m_whnf_calls++;
     // Do not cache easy cases
     switch (e.kind()) {
     case expr_kind::BVar:  case expr_kind::Sort: case expr_kind::MVar: case expr_kind::Pi:
@@ -633,27 +749,42 @@ expr type_checker::whnf(expr const & e) {
     }
 
     // check cache
-    auto it = m_st->m_whnf.find(e);
-    if (it != m_st->m_whnf.end())
-        return it->second;
+    if (expr const * r = m_st->m_whnf.find(e)) {
+        m_st->m_stats.m_whnf_cache_hits++;
+        return *r;
+    }
+    m_st->m_stats.m_whnf_cache_misses++;
+
+    bool shared = is_closed_term_cache_candidate(env(), e, m_st->m_closed_term_candidates);
+    if (shared) {
+        if (optional<expr> r = closed_term_cache_find(env(), closed_term_cache_kind::Whnf, e)) {
+            m_st->m_whnf.insert(e, *r);
+            return *r;
+        }
+    }
 
     expr t = e;
+    expr r;
     while (true) {
         expr t1 = whnf_core(t);
         if (auto v = reduce_native(env(), t1)) {
-            m_st->m_whnf.insert(mk_pair(e, *v));
-            return *v;
+            r = *v;
+            break;
         } else if (auto v = reduce_nat(t1)) {
-            m_st->m_whnf.insert(mk_pair(e, *v));
-            return *v;
+            r = *v;
+            break;
         } else if (auto next_t = unfold_definition(t1)) {
             t = *next_t;
         } else {
-            auto r = t1;
-            m_st->m_whnf.insert(mk_pair(e, r));
-            return r;
+            r = t1;
+            break;
         }
     }
+    r = share(r);
+    m_st->m_whnf.insert(e, r);
+    if (shared)
+        closed_term_cache_insert(env(), closed_term_cache_kind::Whnf, e, r);
+    return r;
 }
 
 /** \brief Given lambda/Pi expressions \c t and \c s, return true iff \c t is def eq to \c s.
@@ -819,22 +950,14 @@ lbool type_checker::is_def_eq_proof_irrel(expr const & t, expr const & s) {
 }
 
 bool type_checker::failed_before(expr const & t, expr const & s) const {
-    if (hash(t) < hash(s)) {
-        return m_st->m_failure.find(mk_pair(t, s)) != m_st->m_failure.end();
-    } else if (hash(t) > hash(s)) {
-        return m_st->m_failure.find(mk_pair(s, t)) != m_st->m_failure.end();
-    } else {
-        return
-            m_st->m_failure.find(mk_pair(t, s)) != m_st->m_failure.end() ||
-            m_st->m_failure.find(mk_pair(s, t)) != m_st->m_failure.end();
-    }
+    bool r = m_st->m_eqv_manager.is_known_different(t, s);
+    if (r)
+        m_st->m_stats.m_failed_before_hits++;
+    return r;
 }
 
 void type_checker::cache_failure(expr const & t, expr const & s) {
-    if (hash(t) <= hash(s))
-        m_st->m_failure.insert(mk_pair(t, s));
-    else
-        m_st->m_failure.insert(mk_pair(s, t));
+    m_st->m_eqv_manager.add_known_different(t, s);
 }
 
 /**
@@ -874,6 +997,7 @@ auto type_checker::lazy_delta_reduction_step(expr & t_n, expr & s_n) -> reductio
         if (auto s_n_new = try_unfold_proj_app(s_n)) {
             s_n = *s_n_new;
         } else {
+            count_unfolding(*d_t);
             t_n = whnf_core(*unfold_definition(t_n), false, true);
         }
     } else if (!d_t && d_s) {
@@ -881,13 +1005,16 @@ auto type_checker::lazy_delta_reduction_step(expr & t_n, expr & s_n) -> reductio
         if (auto t_n_new = try_unfold_proj_app(t_n)) {
             t_n = *t_n_new;
         } else {
+            count_unfolding(*d_s);
             s_n = whnf_core(*unfold_definition(s_n), false, true);
         }
     } else {
         int c = compare(d_t->get_hints(), d_s->get_hints());
         if (c < 0) {
+            count_unfolding(*d_t);
             t_n = whnf_core(*unfold_definition(t_n), false, true);
         } else if (c > 0) {
+            count_unfolding(*d_s);
             s_n = whnf_core(*unfold_definition(s_n), false, true);
         } else {
             if (is_app(t_n) && is_app(s_n) && is_eqp(*d_t, *d_s) && d_t->get_hints().is_regular()) {
@@ -904,7 +1031,9 @@ auto type_checker::lazy_delta_reduction_step(expr & t_n, expr & s_n) -> reductio
                     }
                 }
             }
+            count_unfolding(*d_t);
             t_n = whnf_core(*unfold_definition(t_n), false, true);
+            count_unfolding(*d_s);
             s_n = whnf_core(*unfold_definition(s_n), false, true);
         }
     }
@@ -1003,6 +1132,7 @@ bool type_checker::is_def_eq_unit_like(expr const & t, expr const & s) {
 
 bool type_checker::is_def_eq_core(expr const & t, expr const & s) {
     check_system("is_definitionally_equal", /* do_check_interrupted */ true);
+    m_st->m_stats.m_is_def_eq_core_calls++;
     bool use_hash = true;
     lbool r = quick_is_def_eq(t, s, use_hash);
     if (r != l_undef) return r == l_true;
@@ -1011,6 +1141,11 @@ bool type_checker::is_def_eq_core(expr const & t, expr const & s) {
     // we fully reduce `t` and check whether result is `s`.
     // TODO: add metadata to control whether this optimization is used or not.
     if (!has_fvar(t) && is_constant(s, *g_bool_true)) {
+        if (m_st->m_use_nbe) {
+            optional<name> c = nbe_eval_constructor(env(), t);
+            if (c && *c == *g_bool_true)
+                return true;
+        }
         if (is_constant(whnf(t), *g_bool_true)) {
             return true;
         }
@@ -1135,6 +1270,14 @@ extern "C" LEAN_EXPORT lean_object * lean_kernel_whnf(lean_object * env, lean_ob
     });
 }
 
+extern "C" LEAN_EXPORT lean_object * lean_kernel_whnf_core(lean_object * env, lean_object * lctx, lean_object * a, uint8 use_machine) {
+    return catch_kernel_exceptions<object*>([&]() {
+        type_checker::state st{environment(env)};
+        st.set_use_whnf_machine(use_machine != 0);
+        return type_checker(st, local_ctx(lctx)).whnf_core(expr(a)).steal();
+    });
+}
+
 void initialize_type_checker() {
     g_dont_care    = new expr(mk_const("dontcare"));
     mark_persistent(g_dont_care->raw());
@@ -1163,6 +1306,18 @@ void initialize_type_checker() {
     mark_persistent(g_nat_beq->raw());
     g_nat_ble      = new expr(mk_constant(name{"Nat", "ble"}));
     mark_persistent(g_nat_ble->raw());
+    g_nat_land     = new expr(mk_constant(name{"Nat", "land"}));
+    mark_persistent(g_nat_land->raw());
+    g_nat_lor      = new expr(mk_constant(name{"Nat", "lor"}));
+    mark_persistent(g_nat_lor->raw());
+    g_nat_xor      = new expr(mk_constant(name{"Nat", "xor"}));
+    mark_persistent(g_nat_xor->raw());
+    g_nat_shiftl   = new expr(mk_constant(name{"Nat", "shiftLeft"}));
+    mark_persistent(g_nat_shiftl->raw());
+    g_nat_shiftr   = new expr(mk_constant(name{"Nat", "shiftRight"}));
+    mark_persistent(g_nat_shiftr->raw());
+    g_nat_log2     = new expr(mk_constant(name{"Nat", "log2"}));
+    mark_persistent(g_nat_log2->raw());
     g_string_mk    = new expr(mk_constant(name{"String", "mk"}));
     mark_persistent(g_string_mk->raw());
     g_lean_reduce_bool = new expr(mk_constant(name{"Lean", "reduceBool"}));
@@ -1186,6 +1341,12 @@ void finalize_type_checker() {
     delete g_nat_mod;
     delete g_nat_beq;
     delete g_nat_ble;
+    delete g_nat_land;
+    delete g_nat_lor;
+    delete g_nat_xor;
+    delete g_nat_shiftl;
+    delete g_nat_shiftr;
+    delete g_nat_log2;
     delete g_string_mk;
     delete g_lean_reduce_bool;
     delete g_lean_reduce_nat;
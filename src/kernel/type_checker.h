@@ -5,8 +5,8 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
-#include <unordered_set>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <algorithm>
 #include "util/lbool.h"
@@ -15,26 +15,79 @@ Author: Leonardo de Moura
 #include "kernel/environment.h"
 #include "kernel/local_ctx.h"
 #include "kernel/expr_maps.h"
+#include "kernel/expr_flat_map.h"
 #include "kernel/equiv_manager.h"
+#include "kernel/expr_sharing.h"
 
 namespace lean {
+/** \brief Performance counters of the type checker. They are always maintained by `type_checker::state`,
+    but only reported when a `scoped_type_checker_stats` object is alive. */
+struct type_checker_stats {
+    size_t m_infer_type_calls        = 0;
+    size_t m_infer_type_cache_hits   = 0;
+    size_t m_infer_type_cache_misses = 0;
+    size_t m_whnf_core_calls         = 0;
+    size_t m_whnf_core_cache_hits    = 0;
+    size_t m_whnf_core_cache_misses  = 0;
+    size_t m_whnf_calls              = 0;
+    size_t m_whnf_cache_hits         = 0;
+    size_t m_whnf_cache_misses       = 0;
+    size_t m_is_def_eq_core_calls    = 0;
+    size_t m_failed_before_hits      = 0;
+    size_t m_reduce_nat_hits         = 0;
+    /* Hash-consing of cached results, see `expr_sharing_table`. */
+    size_t m_hash_cons_hits          = 0;
+    size_t m_hash_cons_misses        = 0;
+    /* Set by `scoped_type_checker_stats`. */
+    size_t m_instantiate_calls       = 0;
+    /* Number of times each constant was unfolded by `lazy_delta_reduction_step`.
+       Only collected when a `scoped_type_checker_stats` object is alive. */
+    std::unordered_map<name, size_t, name_hash_fn> m_unfoldings;
+    void add(type_checker_stats const & s);
+};
+
+/** \brief While an object of this class is alive, the counters of every type checker state destroyed in the
+    current thread are added to the given `type_checker_stats` object. */
+class scoped_type_checker_stats {
+    type_checker_stats * m_old_stats;
+    uint64               m_old_instantiate_calls;
+    type_checker_stats & m_stats;
+public:
+    scoped_type_checker_stats(type_checker_stats & s);
+    ~scoped_type_checker_stats();
+};
+
 /** \brief Lean Type Checker. It can also be used to infer types, check whether a
     type \c A is convertible to a type \c B, etc. */
 class type_checker {
 public:
     class state {
-        typedef expr_map<expr> infer_cache;
-        typedef std::unordered_set<expr_pair, expr_pair_hash, expr_pair_eq> expr_pair_set;
+        typedef expr_flat_map<expr> infer_cache;
         environment               m_env;
         name_generator            m_ngen;
         infer_cache               m_infer_type[2];
-        expr_map<expr>            m_whnf_core;
-        expr_map<expr>            m_whnf;
+        expr_flat_map<expr>       m_whnf_core;
+        expr_flat_map<expr>       m_whnf;
+        /* Memo of `is_closed_term_cache_candidate`, only used if the closed term cache is enabled. */
+        expr_flat_map<bool>       m_closed_term_candidates;
+        /* Equivalence classes of definitionally equal terms, and pairs of classes whose arguments failed to be
+           definitionally equal (see `failed_before`). */
         equiv_manager             m_eqv_manager;
-        expr_pair_set             m_failure;
+        type_checker_stats        m_stats;
+        /* If true, `whnf_core` uses `whnf_machine_beta_zeta` for beta and zeta reduction. */
+        bool                      m_use_whnf_machine;
+        /* If true, closed `t =?= Bool.true` problems are first tried using `nbe_eval_constructor`. */
+        bool                      m_use_nbe;
+        /* If true, the results stored in `m_infer_type`, `m_whnf_core` and `m_whnf` are hash-consed using `m_sharing`. */
+        bool                      m_use_sharing;
+        expr_sharing_table        m_sharing;
         friend type_checker;
     public:
         state(environment const & env);
+        ~state();
+        void set_use_whnf_machine(bool b) { m_use_whnf_machine = b; }
+        void set_use_nbe(bool b) { m_use_nbe = b; }
+        void set_use_sharing(bool b) { m_use_sharing = b; }
         environment & env() { return m_env; }
         environment const & env() const { return m_env; }
         name_generator & ngen() { return m_ngen; }
@@ -48,6 +101,7 @@ private:
        are in `m_lparams`. */
     names const *             m_lparams;
 
+    expr share(expr const & e);
     expr ensure_sort_core(expr e, expr const & s);
     expr ensure_pi_core(expr e, expr const & s);
     void check_level(level const & l);
@@ -98,7 +152,9 @@ private:
 
     template<typename F> optional<expr> reduce_bin_nat_op(F const & f, expr const & e);
     template<typename F> optional<expr> reduce_bin_nat_pred(F const & f, expr const & e);
+    optional<expr> reduce_nat_core(expr const & e);
     optional<expr> reduce_nat(expr const & e);
+    void count_unfolding(constant_info const & info);
 public:
     type_checker(state & st, local_ctx const & lctx, definition_safety ds = definition_safety::safe);
     type_checker(state & st, definition_safety ds = definition_safety::safe):type_checker(st, local_ctx(), ds) {}
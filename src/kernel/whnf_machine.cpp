@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <limits>
+#include "runtime/buffer.h"
+#include "kernel/instantiate.h"
+#include "kernel/whnf_machine.h"
+
+namespace lean {
+namespace {
+constexpr unsigned g_nil_env = std::numeric_limits<unsigned>::max();
+
+/* A term `m_expr` whose loose bound variables are given by the environment `m_env`. */
+struct closure {
+    expr           m_expr;
+    unsigned       m_env;
+    /* Cached result of `read_back`. */
+    optional<expr> m_value;
+    closure(expr const & e, unsigned env):m_expr(e), m_env(env) {}
+};
+
+/* Environments are persistent lists of closures. The closure of bound variable `#0` is at the head. */
+struct env_node {
+    unsigned m_closure;
+    unsigned m_next;
+    unsigned m_size;
+};
+
+class beta_zeta_machine {
+    std::vector<closure>  m_closures;
+    std::vector<env_node> m_envs;
+
+    unsigned env_size(unsigned env) const { return env == g_nil_env ? 0 : m_envs[env].m_size; }
+
+    unsigned mk_closure(expr const & e, unsigned env) {
+        m_closures.emplace_back(e, env);
+        return m_closures.size() - 1;
+    }
+
+    unsigned push_env(unsigned c, unsigned env) {
+        m_envs.push_back(env_node{c, env, env_size(env) + 1});
+        return m_envs.size() - 1;
+    }
+
+    expr read_back(unsigned c) {
+        if (!m_closures[c].m_value) {
+            expr e     = m_closures[c].m_expr;
+            unsigned env = m_closures[c].m_env;
+            expr v = read_back(e, env);
+            m_closures[c].m_value = v;
+        }
+        return *m_closures[c].m_value;
+    }
+
+    /* Substitute the closures of `env` for the loose bound variables of `e`. */
+    expr read_back(expr const & e, unsigned env) {
+        unsigned n = std::min(get_loose_bvar_range(e), env_size(env));
+        if (n == 0)
+            return e;
+        buffer<expr> subst;
+        for (unsigned i = 0; i < n; i++) {
+            env_node const & node = m_envs[env];
+            unsigned next = node.m_next;
+            subst.push_back(read_back(node.m_closure));
+            env = next;
+        }
+        return instantiate(e, subst.size(), subst.data());
+    }
+
+public:
+    expr operator()(expr const & e) {
+        expr t       = e;
+        unsigned env = g_nil_env;
+        /* Closures of the pending arguments, the first argument is at the back. */
+        buffer<unsigned> stack;
+        bool progress = false;
+        while (true) {
+            switch (t.kind()) {
+            case expr_kind::App:
+                stack.push_back(mk_closure(app_arg(t), env));
+                t = app_fn(t);
+                continue;
+            case expr_kind::MData:
+                t = mdata_expr(t);
+                continue;
+            case expr_kind::Lambda:
+                if (stack.empty())
+                    break;
+                env = push_env(stack.back(), env);
+                stack.pop_back();
+                t = binding_body(t);
+                progress = true;
+                continue;
+            case expr_kind::Let:
+                env = push_env(mk_closure(let_value(t), env), env);
+                t = let_body(t);
+                progress = true;
+                continue;
+            case expr_kind::BVar: {
+                nat const & idx = bvar_idx(t);
+                if (!idx.is_small() || idx.get_small_value() >= env_size(env))
+                    break;
+                unsigned i = idx.get_small_value();
+                while (i > 0) {
+                    env = m_envs[env].m_next;
+                    i--;
+                }
+                closure const & c = m_closures[m_envs[env].m_closure];
+                t   = c.m_expr;
+                env = c.m_env;
+                continue;
+            }
+            default:
+                break;
+            }
+            break;
+        }
+        if (!progress)
+            return e;
+        expr r = read_back(t, env);
+        buffer<expr> args;
+        while (!stack.empty()) {
+            args.push_back(read_back(stack.back()));
+            stack.pop_back();
+        }
+        return mk_app(r, args.size(), args.data());
+    }
+};
+}
+
+expr whnf_machine_beta_zeta(expr const & e) {
+    return beta_zeta_machine()(e);
+}
+
+bool get_whnf_machine_default() {
+    static bool r = [] {
+        char const * v = std::getenv("LEAN_KERNEL_WHNF_MACHINE");
+        return v != nullptr && std::strcmp(v, "0") != 0;
+    }();
+    return r;
+}
+}
@@ -0,0 +1,23 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include "kernel/expr.h"
+
+namespace lean {
+/** \brief Reduce the head of \c e using only beta, zeta (`let`) and `mdata` removal steps, and return \c e itself
+    if no beta or zeta step can be applied.
+
+    The reduction is performed by a Krivine-style abstract machine: bound variables are mapped to closures
+    (delayed substitutions) instead of being instantiated at every step, and the result is read back to an
+    `expr` only once the head is stuck. Thus, a chain of `n` nested beta/zeta redexes is reduced with a single
+    `instantiate` per read back closure, instead of `n` traversals of the body.
+
+    The result is the same as repeatedly applying `instantiate`-based beta and zeta reduction to the head. */
+expr whnf_machine_beta_zeta(expr const & e);
+
+/** \brief Return true if the kernel type checker should use \c whnf_machine_beta_zeta in \c whnf_core by default.
+    It is set using the environment variable `LEAN_KERNEL_WHNF_MACHINE`. */
+bool get_whnf_machine_default();
+}
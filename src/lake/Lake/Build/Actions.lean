@@ -30,6 +30,9 @@ def compileLeanModule (name : String) (leanFile : FilePath)
     args := args ++ #["-c", cFile.toString]
   for dynlib in dynlibs do
     args := args.push s!"--load-dynlib={dynlib}"
+  -- Unchanged outputs keep their modification time, which is only safe if they are compared by hash
+  unless (← getIsOldMode) do
+    args := args.push "--keep-unchanged"
   proc {
     args
     cmd := lean.toString
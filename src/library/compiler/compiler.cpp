@@ -4,13 +4,24 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
 #include "util/option_declarations.h"
 #include "util/io.h"
+#include "runtime/thread.h"
+#include "runtime/alloc.h"
+#include "runtime/interrupt.h"
 #include "kernel/type_checker.h"
 #include "kernel/kernel_exception.h"
 #include "library/max_sharing.h"
 #include "library/trace.h"
 #include "library/time_task.h"
+#include "library/profiling.h"
 #include "library/compiler/util.h"
 #include "library/compiler/lcnf.h"
 #include "library/compiler/find_jp.h"
@@ -34,8 +45,11 @@ Author: Leonardo de Moura
 
 namespace lean {
 static name * g_extract_closed = nullptr;
+static name * g_parallel = nullptr;
+static name * g_pass_stats_csv = nullptr;
 
 bool is_extract_closed_enabled(options const & opts) { return opts.get_bool(*g_extract_closed, true); }
+bool is_parallel_enabled(options const & opts) { return opts.get_bool(*g_parallel, false); }
 
 static name get_real_name(name const & n) {
     if (optional<name> new_n = is_unsafe_rec_name(n))
@@ -55,14 +69,170 @@ static expr eta_expand(environment const & env, expr const & e) {
     return type_checker(env).eta_expand(e);
 }
 
+#if defined(LEAN_MULTI_THREAD)
+/* Parallel `apply` of a single `compile`. Each `apply` spawns helper tasks that claim declarations in order, like the
+   calling thread, and finish as soon as all declarations have been claimed. So, helpers do not hold task manager
+   workers between `apply`s, e.g., while the caller runs the sequential stages. The caller only waits for declarations
+   that have already been claimed, so `compile` cannot deadlock when it runs on a task manager worker itself: if no
+   worker is available, the caller processes all declarations. Without a task manager, helpers run synchronously when
+   they are spawned.
+
+   Heartbeats are thread local, so each declaration is processed starting from the heartbeat count the caller had at
+   the beginning of `apply` and with the caller's heartbeat limit, and the heartbeats used by all declarations are
+   added to the caller's afterwards. Thus, whether the limit is exceeded does not depend on which thread processed
+   which declaration. The helpers are canceled when the caller is. */
+class parallel_apply_pool {
+    /* State of one `apply`. Shared with its helpers because helpers that only start after `apply` has returned still
+       access it. */
+    struct state {
+        mutex                                     m_mutex;
+        condition_variable                        m_done_cv;
+        std::thread::id                           m_caller  = this_thread::get_id();
+        /* Reset when `apply` returns. Helpers only access `m_fn` and `m_in` after claiming a declaration, i.e., while
+           `apply` is waiting for them. */
+        std::function<expr(expr const &)> const * m_fn      = nullptr;
+        std::vector<expr>                         m_in;
+        std::vector<expr>                         m_out;
+        std::vector<std::exception_ptr>           m_errors;
+        unsigned                                  m_next    = 0;
+        /* Number of claimed declarations that have not been processed yet. */
+        unsigned                                  m_pending = 0;
+        size_t                                    m_heartbeat     = 0;
+        size_t                                    m_max_heartbeat = 0;
+        /* Heartbeats used by the declarations, and allocation heartbeats (see `get_num_heartbeats`) used by the
+           helpers running in other threads. */
+        size_t                                    m_heartbeats_used     = 0;
+        uint64_t                                  m_num_heartbeats_used = 0;
+    };
+    unsigned m_num_helpers;
+
+    /* Process declarations until all of them have been claimed. */
+    static void run(state & s) {
+        /* The allocations of the calling thread are already counted, and its results do not need to be marked. */
+        bool helper = this_thread::get_id() != s.m_caller;
+        while (true) {
+            unsigned i;
+            size_t heartbeat, max_heartbeat;
+            {
+                lock_guard<mutex> _(s.m_mutex);
+                if (!s.m_fn || s.m_next == s.m_in.size())
+                    return;
+                i = s.m_next++;
+                s.m_pending++;
+                heartbeat     = s.m_heartbeat;
+                max_heartbeat = s.m_max_heartbeat;
+            }
+            uint64_t num_heartbeats = get_num_heartbeats();
+            size_t used;
+            {
+                scope_heartbeat     set_heartbeat(heartbeat);
+                scope_max_heartbeat set_max_heartbeat(max_heartbeat);
+                try {
+                    expr r = (*s.m_fn)(s.m_in[i]);
+                    if (helper)
+                        mark_mt(r.raw());
+                    s.m_out[i] = r;
+                } catch (...) {
+                    s.m_errors[i] = std::current_exception();
+                }
+                used = get_heartbeat() - heartbeat;
+            }
+            lock_guard<mutex> _(s.m_mutex);
+            s.m_heartbeats_used += used;
+            if (helper)
+                s.m_num_heartbeats_used += get_num_heartbeats() - num_heartbeats;
+            if (--s.m_pending == 0)
+                s.m_done_cv.notify_all();
+        }
+    }
+
+    static obj_res helper_fn(obj_arg st, obj_arg) {
+        std::shared_ptr<state> * p = reinterpret_cast<std::shared_ptr<state> *>(unbox_size_t(st));
+        dec(st);
+        run(**p);
+        delete p;
+        return box(0);
+    }
+
+public:
+    explicit parallel_apply_pool(unsigned num_helpers):m_num_helpers(num_helpers) {}
+
+    comp_decls apply(std::function<expr(expr const &)> const & f, environment const * env, comp_decls const & ds) {
+        std::shared_ptr<state> st = std::make_shared<state>();
+        state & s = *st;
+        if (env)
+            mark_mt(env->raw());
+        for (comp_decl const & d : ds) {
+            mark_mt(d.snd().raw());
+            s.m_in.push_back(d.snd());
+        }
+        s.m_fn            = &f;
+        s.m_out.assign(s.m_in.size(), expr());
+        s.m_errors.assign(s.m_in.size(), std::exception_ptr());
+        s.m_heartbeat     = get_heartbeat();
+        s.m_max_heartbeat = get_max_heartbeat();
+        std::vector<object *> helpers;
+        unsigned num_helpers = std::min(m_num_helpers, static_cast<unsigned>(s.m_in.size()) - 1);
+        for (unsigned i = 0; i < num_helpers; i++) {
+            object * c = alloc_closure(reinterpret_cast<void *>(helper_fn), 2, 1);
+            closure_set(c, 0, box_size_t(reinterpret_cast<size_t>(new std::shared_ptr<state>(st))));
+            /* `keep_alive` makes sure the helper runs, and frees its reference to the state, after we drop the task. */
+            helpers.push_back(task_spawn(c, 0, /* keep_alive */ true));
+        }
+        run(s);
+        {
+            unique_lock<mutex> lock(s.m_mutex);
+            bool canceled = false;
+            while (!s.m_done_cv.wait_for(lock, chrono::milliseconds(g_small_sleep), [&]() { return s.m_pending == 0; })) {
+                if (!canceled && lean_io_check_canceled_core()) {
+                    for (object * t : helpers)
+                        lean_io_cancel_core(t);
+                    canceled = true;
+                }
+            }
+            /* Helpers that have not started yet return immediately. */
+            s.m_fn = nullptr;
+        }
+        for (object * t : helpers)
+            dec(t);
+        add_heartbeat(s.m_heartbeats_used);
+        add_num_heartbeats(s.m_num_heartbeats_used);
+        /* Report the error of the first failing declaration, as the sequential version does. */
+        for (std::exception_ptr const & ex : s.m_errors) {
+            if (ex)
+                std::rethrow_exception(ex);
+        }
+        check_heartbeat();
+        buffer<comp_decl> r;
+        unsigned i = 0;
+        for (comp_decl const & d : ds) {
+            r.push_back(comp_decl(d.fst(), s.m_out[i]));
+            i++;
+        }
+        return comp_decls(r);
+    }
+};
+
+/* Pool used by `apply` in the current `compile`, if the declarations are processed in parallel. */
+LEAN_THREAD_PTR(parallel_apply_pool, g_parallel_apply_pool);
+#endif
+
+static comp_decls apply_core(std::function<expr(expr const &)> const & f, environment const * env, comp_decls const & ds) {
+#if defined(LEAN_MULTI_THREAD)
+    if (g_parallel_apply_pool && length(ds) >= 2)
+        return g_parallel_apply_pool->apply(f, env, ds);
+#endif
+    return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(d.snd())); });
+}
+
 template<typename F>
 comp_decls apply(F && f, environment const & env, comp_decls const & ds) {
-    return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(env, d.snd())); });
+    return apply_core([&](expr const & e) { return f(env, e); }, &env, ds);
 }
 
 template<typename F>
 comp_decls apply(F && f, comp_decls const & ds) {
-    return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(d.snd())); });
+    return apply_core([&](expr const & e) { return f(e); }, nullptr, ds);
 }
 
 void trace_comp_decl(comp_decl const & d) {
@@ -75,6 +245,153 @@ void trace_comp_decls(comp_decls const & ds) {
     }
 }
 
+/** \brief Statistics of a compiler pass, see `pass_stats_fn`. Sizes are summed over all declarations. */
+struct pass_stats_entry {
+    uint64          m_runs        = 0;
+    second_duration m_time{0};
+    uint64          m_lets_before = 0;
+    uint64          m_lets_after  = 0;
+    uint64          m_size_before = 0;
+    uint64          m_size_after  = 0;
+
+    void add(pass_stats_entry const & s) {
+        m_runs        += s.m_runs;
+        m_time        += s.m_time;
+        m_lets_before += s.m_lets_before;
+        m_lets_after  += s.m_lets_after;
+        m_size_before += s.m_size_before;
+        m_size_after  += s.m_size_after;
+    }
+};
+
+// statistics of all `compile` invocations, in the order the passes were first run
+static mutex * g_pass_stats_mutex = nullptr;
+static std::vector<std::pair<std::string, pass_stats_entry>> * g_pass_stats = nullptr;
+// value of `compiler.pass_stats.csv`
+static std::string * g_pass_stats_csv_file = nullptr;
+
+static pass_stats_entry & get_pass_stats(std::vector<std::pair<std::string, pass_stats_entry>> & stats, std::string const & pass) {
+    for (auto & p : stats) {
+        if (p.first == pass)
+            return p.second;
+    }
+    stats.emplace_back(pass, pass_stats_entry());
+    return stats.back().second;
+}
+
+void display_compiler_pass_stats(std::ostream & out) {
+    lock_guard<mutex> _(*g_pass_stats_mutex);
+    if (g_pass_stats->empty())
+        return;
+    if (g_pass_stats_csv_file->empty()) {
+        sstream ss;
+        ss << "compiler passes (time, runs, let-declarations before -> after, term size before -> after):\n";
+        for (auto const & p : *g_pass_stats) {
+            pass_stats_entry const & s = p.second;
+            ss << "\t" << p.first << " " << display_profiling_time{s.m_time} << " " << s.m_runs << " "
+               << s.m_lets_before << " -> " << s.m_lets_after << " " << s.m_size_before << " -> " << s.m_size_after << "\n";
+        }
+        // output atomically, like IO.print
+        out << ss.str();
+    } else {
+        std::ofstream csv(*g_pass_stats_csv_file);
+        csv << "pass,runs,seconds,lets_before,lets_after,size_before,size_after\n";
+        for (auto const & p : *g_pass_stats) {
+            pass_stats_entry const & s = p.second;
+            csv << p.first << "," << s.m_runs << "," << s.m_time.count() << "," << s.m_lets_before << ","
+                << s.m_lets_after << "," << s.m_size_before << "," << s.m_size_after << "\n";
+        }
+    }
+}
+
+/** \brief Collect the wall time, number of let-declarations and term size of each pass of a `compile` invocation if
+    `profiler` is set or `compiler.pass_stats.csv` is not empty. A pass is everything executed between two calls to
+    `operator()`. The statistics are added to the global ones on destruction. */
+class pass_stats_fn {
+    bool                                            m_enabled;
+    std::string                                     m_csv_file;
+    std::vector<std::pair<std::string, pass_stats_entry>> m_stats;
+    uint64                                          m_lets = 0;
+    uint64                                          m_size = 0;
+    std::chrono::steady_clock::time_point           m_start;
+
+    /* Compute `m_lets` and `m_size`; shared subterms are only counted once per declaration. */
+    void collect_sizes(comp_decls const & ds) {
+        m_lets = 0;
+        m_size = 0;
+        for (comp_decl const & d : ds) {
+            std::unordered_set<lean_object *> visited;
+            buffer<expr> todo;
+            todo.push_back(d.snd());
+            while (!todo.empty()) {
+                expr e = todo.back();
+                todo.pop_back();
+                if (is_shared(e) && !visited.insert(e.raw()).second)
+                    continue;
+                m_size++;
+                switch (e.kind()) {
+                case expr_kind::Let:
+                    m_lets++;
+                    todo.push_back(let_type(e)); todo.push_back(let_value(e)); todo.push_back(let_body(e));
+                    break;
+                case expr_kind::Lambda: case expr_kind::Pi:
+                    todo.push_back(binding_domain(e)); todo.push_back(binding_body(e));
+                    break;
+                case expr_kind::App:
+                    todo.push_back(app_fn(e)); todo.push_back(app_arg(e));
+                    break;
+                case expr_kind::MData:
+                    todo.push_back(mdata_expr(e));
+                    break;
+                case expr_kind::Proj:
+                    todo.push_back(proj_expr(e));
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+
+public:
+    pass_stats_fn(options const & opts, comp_decls const & ds) {
+        char const * csv_file = opts.get_string(*g_pass_stats_csv, "");
+        m_enabled = get_profiler(opts) || *csv_file;
+        if (m_enabled) {
+            m_csv_file = csv_file;
+            collect_sizes(ds);
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~pass_stats_fn() {
+        if (!m_enabled)
+            return;
+        lock_guard<mutex> _(*g_pass_stats_mutex);
+        for (auto const & p : m_stats)
+            get_pass_stats(*g_pass_stats, p.first).add(p.second);
+        if (!m_csv_file.empty())
+            *g_pass_stats_csv_file = m_csv_file;
+    }
+
+    /* Record the pass `pass` that transformed the declarations into `ds`. */
+    void operator()(char const * pass, comp_decls const & ds) {
+        if (!m_enabled)
+            return;
+        second_duration time(std::chrono::steady_clock::now() - m_start);
+        pass_stats_entry & s = get_pass_stats(m_stats, pass);
+        s.m_runs++;
+        s.m_time        += time;
+        s.m_lets_before += m_lets;
+        s.m_size_before += m_size;
+        collect_sizes(ds);
+        s.m_lets_after  += m_lets;
+        s.m_size_after  += m_size;
+        // do not include the time spent computing the sizes
+        m_start = std::chrono::steady_clock::now();
+    }
+};
+
 static environment cache_stage1(environment env, comp_decls const & ds) {
     for (comp_decl const & d : ds) {
         name n = d.fst();
@@ -197,8 +514,21 @@ environment compile(environment const & env, options const & opts, names cs) {
 
     time_task t("compilation", opts, head(cs));
     scope_trace_env scope_trace(env, opts);
+#if defined(LEAN_MULTI_THREAD)
+    /* If `compiler.parallel` is set, the stages that only transform each declaration independently process the
+       declarations in parallel using `apply`; the ones that update the environment (e.g., `specialize`,
+       `lambda_lifting`) are sequential. The stages use fresh name generators for each declaration, and heartbeats
+       are accounted for as described in `parallel_apply_pool`. Traces are only available in the current thread, so
+       we compile sequentially when tracing. */
+    std::unique_ptr<parallel_apply_pool> pool;
+    unsigned num_threads = std::min(static_cast<unsigned>(length(cs)), hardware_concurrency());
+    if (is_parallel_enabled(opts) && !is_trace_enabled() && num_threads >= 2)
+        pool.reset(new parallel_apply_pool(num_threads - 1));
+    flet<parallel_apply_pool *> set_pool(g_parallel_apply_pool, pool.get());
+#endif
 
     comp_decls ds = to_comp_decls(env, cs);
+    pass_stats_fn pass_stats(opts, ds);
     csimp_cfg cfg(opts);
     // Use the following line to see compiler intermediate steps
     // scope_traces_as_string trace_scope;
@@ -206,24 +536,33 @@ environment compile(environment const & env, options const & opts, names cs) {
     auto esimp = [&](environment const & env, expr const & e) { return cesimp(env, e, cfg); };
     trace_compiler(name({"compiler", "input"}), ds);
     ds = apply(eta_expand, env, ds);
+    pass_stats("eta_expand", ds);
     trace_compiler(name({"compiler", "eta_expand"}), ds);
     ds = apply(to_lcnf, env, ds);
+    pass_stats("to_lcnf", ds);
     ds = apply(find_jp, env, ds);
+    pass_stats("find_jp", ds);
     // trace(ds);
     trace_compiler(name({"compiler", "lcnf"}), ds);
     // trace(ds);
     ds = apply(cce, env, ds);
+    pass_stats("cce", ds);
     trace_compiler(name({"compiler", "cce"}), ds);
     ds = apply(csimp_replace_constants, env, ds);
+    pass_stats("csimp_replace_constants", ds);
     ds = apply(simp, env, ds);
+    pass_stats("csimp", ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     // trace(ds);
     environment new_env = env;
     std::tie(new_env, ds) = eager_lambda_lifting(new_env, ds, cfg);
+    pass_stats("eager_lambda_lifting", ds);
     trace_compiler(name({"compiler", "eager_lambda_lifting"}), ds);
     ds = apply(max_sharing, ds);
+    pass_stats("max_sharing", ds);
     trace_compiler(name({"compiler", "stage1"}), ds);
     new_env = cache_stage1(new_env, ds);
+    pass_stats("cache_stage1", ds);
     if (is_matcher(new_env, ds)) {
         /* Auxiliary matcher applications are marked as inlined, and are always fully applied
            (if users don't use them manually). So, we skip code generation for them.
@@ -234,43 +573,62 @@ environment compile(environment const & env, options const & opts, names cs) {
         return new_env;
     }
     std::tie(new_env, ds) = specialize(new_env, ds, cfg);
+    pass_stats("specialize", ds);
     // The following check is incorrect. It was exposed by issue #1812.
     // We will not fix the check since we will delete the compiler.
     // lean_assert(lcnf_check_let_decls(new_env, ds));
     trace_compiler(name({"compiler", "specialize"}), ds);
     ds = apply(elim_dead_let, ds);
+    pass_stats("elim_dead_let", ds);
     trace_compiler(name({"compiler", "elim_dead_let"}), ds);
     ds = apply(erase_irrelevant, new_env, ds);
+    pass_stats("erase_irrelevant", ds);
     trace_compiler(name({"compiler", "erase_irrelevant"}), ds);
     ds = apply(struct_cases_on, new_env, ds);
+    pass_stats("struct_cases_on", ds);
     trace_compiler(name({"compiler", "struct_cases_on"}), ds);
     ds = apply(esimp, new_env, ds);
+    pass_stats("esimp", ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     ds = reduce_arity(new_env, ds);
+    pass_stats("reduce_arity", ds);
     trace_compiler(name({"compiler", "reduce_arity"}), ds);
     std::tie(new_env, ds) = lambda_lifting(new_env, ds);
+    pass_stats("lambda_lifting", ds);
     trace_compiler(name({"compiler", "lambda_lifting"}), ds);
     // trace(ds);
     ds = apply(esimp, new_env, ds);
+    pass_stats("esimp", ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     new_env = cache_stage2(new_env, ds);
+    pass_stats("cache_stage2", ds);
     trace_compiler(name({"compiler", "stage2"}), ds);
     if (is_extract_closed_enabled(opts)) {
         std::tie(new_env, ds) = extract_closed(new_env, ds);
+        pass_stats("extract_closed", ds);
         ds = apply(elim_dead_let, ds);
+        pass_stats("elim_dead_let", ds);
         ds = apply(esimp, new_env, ds);
+        pass_stats("esimp", ds);
         trace_compiler(name({"compiler", "extract_closed"}), ds);
     }
     new_env = cache_new_stage2(new_env, ds);
+    pass_stats("cache_stage2", ds);
     ds = apply(esimp, new_env, ds);
+    pass_stats("esimp", ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     ds = apply(simp_app_args, new_env, ds);
+    pass_stats("simp_app_args", ds);
     ds = apply(ecse, new_env, ds);
+    pass_stats("cse", ds);
     ds = apply(elim_dead_let, ds);
+    pass_stats("elim_dead_let", ds);
     trace_compiler(name({"compiler", "simp_app_args"}), ds);
     // std::cout << trace_scope.get_string() << "\n";
     /* compile IR. */
-    return compile_ir(new_env, opts, ds);
+    environment r = compile_ir(new_env, opts, ds);
+    pass_stats("compile_ir", ds);
+    return r;
 }
 
 extern "C" LEAN_EXPORT object * lean_compile_decls(object * env, object * opts, object * decls) {
@@ -283,6 +641,15 @@ void initialize_compiler() {
     g_extract_closed = new name{"compiler", "extract_closed"};
     mark_persistent(g_extract_closed->raw());
     register_bool_option(*g_extract_closed, true, "(compiler) enable/disable closed term caching");
+    g_parallel = new name{"compiler", "parallel"};
+    mark_persistent(g_parallel->raw());
+    register_bool_option(*g_parallel, false, "(compiler) compile the declarations of a mutual block in parallel (experimental)");
+    g_pass_stats_csv = new name{"compiler", "pass_stats", "csv"};
+    mark_persistent(g_pass_stats_csv->raw());
+    register_option(*g_pass_stats_csv, {}, data_value_kind::String, "", "(compiler) file to write the time, number of let-declarations and term size of each compiler pass to, in CSV format; the statistics are collected for all declarations and written at exit. If empty, the statistics are only collected if `profiler` is set, and displayed at exit");
+    g_pass_stats_mutex = new mutex();
+    g_pass_stats = new std::vector<std::pair<std::string, pass_stats_entry>>();
+    g_pass_stats_csv_file = new std::string();
     register_trace_class("compiler");
     register_trace_class({"compiler", "input"});
     register_trace_class({"compiler", "inline"});
@@ -325,5 +692,10 @@ void initialize_compiler() {
 
 void finalize_compiler() {
     delete g_extract_closed;
+    delete g_parallel;
+    delete g_pass_stats_csv;
+    delete g_pass_stats_csv_file;
+    delete g_pass_stats;
+    delete g_pass_stats_mutex;
 }
 }
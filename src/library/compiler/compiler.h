@@ -5,12 +5,16 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <iostream>
 #include "kernel/environment.h"
 namespace lean {
 environment compile(environment const & env, options const & opts, names cs);
 inline environment compile(environment const & env, options const & opts, name const & c) {
     return compile(env, opts, names(c));
 }
+/** \brief Display the statistics of the compiler passes collected if `profiler` is set, or write them to the file
+    set using `compiler.pass_stats.csv`. */
+void display_compiler_pass_stats(std::ostream & out);
 void initialize_compiler();
 void finalize_compiler();
 }
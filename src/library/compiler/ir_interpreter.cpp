@@ -10,24 +10,38 @@ Motivation
 ==========
 
 Even with a JIT compiler, we still have a need for a simpler interpreter on platforms LLVM JIT does not support (i.e.
-WebAssembly). Because this is mostly an edge case, we strive for simplicity instead of performance and thus reuse the
-existing compiler IR instead of inventing something like a new bytecode format.
+WebAssembly). The interpreter is also used for `#eval`, `evalConst`, macros, and tactics that have not been compiled yet,
+so we lower the IR of each function to a compact bytecode (see `bc_builder`) before running it. The bytecode is a direct
+translation of the IR, and the IR can still be interpreted directly by setting `interpreter.bytecode` to `false`. In
+builds with LLVM support, imported functions that are called often are compiled to native code just in time (see
+`tier_up`).
 
 Implementation
 ==============
 
 The interpreter mainly consists of a homogeneous stack of `value`s, which are either unboxed values or pointers to boxed
 objects. The IR type system tells us which union member is active at any time. IR variables are mapped to stack
-slots by adding the current base pointer to the variable index. Further stacks are used for storing join points and call
-stack metadata. The interpreted IR is taken directly from the environment. Whenever possible, we try to switch to native
-code by checking for the mangled symbol via dlsym/GetProcAddress, which is also how we can call external functions
-(which only works if the file declaring them has already been compiled). We always call the "boxed" versions of native
-functions, which have a (relatively) homogeneous ABI that we can use without runtime code generation; see also
-`call/lookup_symbol` below.
+slots by adding the current base pointer to the variable index. Further stacks are used for storing join points (only
+when interpreting IR directly) and call stack metadata. The interpreted IR is taken directly from the environment.
+Whenever possible, we try to switch to native code by checking for the mangled symbol via dlsym/GetProcAddress, which
+is also how we can call external functions (which only works if the file declaring them has already been compiled). We
+always call the "boxed" versions of native functions, which have a (relatively) homogeneous ABI that we can use without
+runtime code generation; see also `call/lookup_symbol` below.
 
 */
 #include <string>
 #include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <type_traits>
+#include <atomic>
+#include <map>
+#include <chrono>
+#include <fstream>
 #ifdef LEAN_WINDOWS
 #include <windows.h>
 #include <psapi.h>
@@ -40,10 +54,13 @@ functions, which have a (relatively) homogeneous ABI that we can use without run
 #include "runtime/io.h"
 #include "runtime/option_ref.h"
 #include "runtime/array_ref.h"
+#include "runtime/thread.h"
+#include "runtime/compact.h"
 #include "library/time_task.h"
 #include "library/trace.h"
 #include "library/compiler/ir.h"
 #include "library/compiler/init_attribute.h"
+#include "library/compiler/ir_jit.h"
 #include "util/nat.h"
 #include "util/option_declarations.h"
 
@@ -51,6 +68,14 @@ functions, which have a (relatively) homogeneous ABI that we can use without run
 #define LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE true
 #endif
 
+#ifndef LEAN_DEFAULT_INTERPRETER_BYTECODE
+#define LEAN_DEFAULT_INTERPRETER_BYTECODE true
+#endif
+
+#ifndef LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD
+#define LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD 10000
+#endif
+
 namespace lean {
 namespace ir {
 // C++ wrappers of Lean data types
@@ -191,6 +216,10 @@ static string_ref * g_mangle_prefix = nullptr;
 static string_ref * g_boxed_suffix = nullptr;
 static string_ref * g_boxed_mangled_suffix = nullptr;
 static name * g_interpreter_prefer_native = nullptr;
+static name * g_interpreter_bytecode = nullptr;
+static name * g_interpreter_profile = nullptr;
+static name * g_interpreter_jit_threshold = nullptr;
+static name * g_interpreter_profile_folded = nullptr;
 
 // constants (lacking native declarations) initialized by `lean_run_init`
 static name_map<object *> * g_init_globals;
@@ -319,6 +348,663 @@ void * lookup_symbol_in_cur_exe(char const * sym) {
 #endif
 }
 
+// Trampolines
+// ===========
+//
+// Native functions are usually called through their boxed versions (see `call_core`), which allocates for boxing
+// `UInt64`, `USize` and `Float` arguments and results. Functions with at most `LEAN_INTERPRETER_MAX_TRAMPOLINE_ARITY`
+// parameters are instead called through a trampoline that passes the values of the interpreter directly to the
+// unboxed version. Trampolines are instantiated at compile time for all combinations of result types and parameter
+// classes: on the supported (64-bit) ABIs, pointers and all unsigned integral types up to 64 bits (zero-extended, as
+// stored in `value::m_num`) are passed in the same general-purpose registers, so parameters only need to distinguish
+// between these and `double`.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__) || defined(_M_ARM64)
+#define LEAN_INTERPRETER_TRAMPOLINES
+#endif
+
+#define LEAN_INTERPRETER_MAX_TRAMPOLINE_ARITY 5
+
+typedef value (*trampoline)(void * fn, value const * args);
+
+#ifdef LEAN_INTERPRETER_TRAMPOLINES
+template<class T> T trampoline_arg(value const & v);
+template<> uint64 trampoline_arg<uint64>(value const & v) { return v.m_num; }
+template<> double trampoline_arg<double>(value const & v) { return v.m_float; }
+
+template<class R> value trampoline_result(R r) { return static_cast<uint64>(r); }
+template<> value trampoline_result<object *>(object * r) { return r; }
+template<> value trampoline_result<double>(double r) { return value::from_float(r); }
+
+template<class R, class... Ps> struct trampoline_impl {
+    template<size_t... Is> static value call_core(void * fn, value const * args, std::index_sequence<Is...>) {
+        return trampoline_result<R>(reinterpret_cast<R (*)(Ps...)>(fn)(trampoline_arg<Ps>(args[Is])...));
+    }
+    static value call(void * fn, value const * args) { return call_core(fn, args, std::index_sequence_for<Ps...>()); }
+};
+
+// the trampoline with result type `R` for `N` parameters, where bit `i` of `Mask` is set iff parameter `i` is a `Float`
+template<class R, unsigned N, size_t Mask, class... Ps> struct mk_trampoline :
+    mk_trampoline<R, N - 1, (Mask >> 1), Ps..., typename std::conditional<Mask & 1, double, uint64>::type> {};
+template<class R, size_t Mask, class... Ps> struct mk_trampoline<R, 0, Mask, Ps...> {
+    typedef trampoline_impl<R, Ps...> type;
+};
+
+template<class R, unsigned N, size_t... Masks> trampoline get_trampoline_core(size_t mask, std::index_sequence<Masks...>) {
+    static trampoline const table[] = { &mk_trampoline<R, N, Masks>::type::call... };
+    return table[mask];
+}
+
+template<class R> trampoline get_trampoline_core(unsigned arity, size_t mask) {
+    static_assert(LEAN_INTERPRETER_MAX_TRAMPOLINE_ARITY == 5, "update `get_trampoline_core`");
+    switch (arity) {
+        case 1: return get_trampoline_core<R, 1>(mask, std::make_index_sequence<2>());
+        case 2: return get_trampoline_core<R, 2>(mask, std::make_index_sequence<4>());
+        case 3: return get_trampoline_core<R, 3>(mask, std::make_index_sequence<8>());
+        case 4: return get_trampoline_core<R, 4>(mask, std::make_index_sequence<16>());
+        case 5: return get_trampoline_core<R, 5>(mask, std::make_index_sequence<32>());
+        default: lean_unreachable();
+    }
+}
+#endif
+
+/** \brief Return the trampoline for calling the unboxed version of `d`, or `nullptr` if there is none. */
+trampoline get_trampoline(decl const & d) {
+#ifdef LEAN_INTERPRETER_TRAMPOLINES
+    array_ref<param> const & ps = decl_params(d);
+    if (ps.size() == 0 || ps.size() > LEAN_INTERPRETER_MAX_TRAMPOLINE_ARITY)
+        return nullptr;
+    size_t mask = 0;
+    for (size_t i = 0; i < ps.size(); i++) {
+        if (param_type(ps[i]) == type::Float)
+            mask |= static_cast<size_t>(1) << i;
+    }
+    switch (decl_type(d)) {
+        case type::Float: return get_trampoline_core<double>(ps.size(), mask);
+        case type::UInt8: return get_trampoline_core<uint8>(ps.size(), mask);
+        case type::UInt16: return get_trampoline_core<uint16>(ps.size(), mask);
+        case type::UInt32: return get_trampoline_core<uint32>(ps.size(), mask);
+        case type::UInt64: return get_trampoline_core<uint64>(ps.size(), mask);
+        case type::USize: return get_trampoline_core<size_t>(ps.size(), mask);
+        case type::Object:
+        case type::TObject:
+        case type::Irrelevant:
+            return get_trampoline_core<object *>(ps.size(), mask);
+    }
+    lean_unreachable();
+#else
+    return nullptr;
+#endif
+}
+
+/** \brief Result of looking up an IR function in the current binary. */
+struct symbol_cache_entry {
+    decl m_decl;
+    // symbol address; `nullptr` if function does not have native code
+    void * m_addr = nullptr;
+    // true iff we chose the boxed version of a function where the IR uses the unboxed version
+    bool m_boxed = false;
+    // if `m_boxed` is true, the unboxed version and a trampoline for calling it, if any
+    void *     m_unboxed_addr = nullptr;
+    trampoline m_trampoline = nullptr;
+};
+
+// Bytecode
+// ========
+//
+// Before its first execution, the body of an IR function is lowered into a flat array of `bc_instr`s: variables are
+// resolved to frame slots, constructor layouts and numeric literals are decoded, join points and `case` alternatives
+// become jump targets (`case` uses a jump table indexed by constructor tag), and callees are referenced by index into
+// a per-function table that caches the result of `lookup_symbol` and the bytecode of interpreted callees.
+
+#if defined(__GNUC__)
+// use "labels as values" for dispatching bytecode instructions
+#define LEAN_BC_THREADED_DISPATCH
+#endif
+
+enum class bc_opcode : uint8 {
+    Ctor, Reset, Reuse, Proj, UProj, SProj, FAp, Load, PAp, Ap, Box, Unbox, Const, LitObj, IsShared, IsTaggedPtr,
+    Set, SetTag, USet, SSet, Inc, Dec, Del, Case, Ret, Jmp, TailCall, Unreachable, Invalid
+};
+
+// slot of irrelevant arguments
+static constexpr uint32 g_bc_irrelevant = std::numeric_limits<uint32>::max();
+// jump target of `case` instructions without a matching alternative
+static constexpr uint32 g_bc_no_target = std::numeric_limits<uint32>::max();
+
+/** \brief Bytecode instruction. The meaning of the operands depends on the opcode, see `bc_builder`. */
+struct bc_instr {
+    bc_opcode m_op;
+    bool      m_flag;
+    type      m_type;
+    uint32    m_dst;
+    uint32    m_a;
+    uint32    m_b;
+    uint32    m_c;
+    uint32    m_d;
+};
+
+struct bc_ctor_layout {
+    unsigned m_tag;
+    unsigned m_size;
+    // byte size of all unboxed fields
+    unsigned m_scalar_size;
+};
+
+struct bc_code;
+
+// see `interpreter::tier_up`
+enum class jit_state : uint8 { None, Compiling, Compiled, Failed };
+
+struct bc_callee {
+    name               m_fn;
+    // `m_sym` and `m_code` are set lazily, possibly by another thread (see `interpreter_shared_cache`)
+    std::atomic<bool>  m_resolved{false};
+    symbol_cache_entry m_sym;
+    // bytecode of the callee if it is interpreted
+    bc_code *          m_code = nullptr;
+    explicit bc_callee(name const & fn):m_fn(fn) {}
+    // only used while the code is being built
+    bc_callee(bc_callee && c):m_fn(std::move(c.m_fn)), m_resolved(c.m_resolved.load()), m_sym(std::move(c.m_sym)), m_code(c.m_code) {}
+};
+
+struct bc_code {
+    // keeps the IR alive; the interpreter frame refers to it
+    decl                        m_decl;
+    // number of variable slots
+    unsigned                    m_frame_size = 0;
+    std::vector<bc_instr>       m_instrs;
+    // argument slots of calls, constructors and jumps, and parameter slots of join points
+    std::vector<uint32>         m_slots;
+    std::vector<bc_ctor_layout> m_ctors;
+    std::vector<value>          m_consts;
+    std::vector<object_ref>     m_objs;
+    // jump tables of `case` instructions
+    std::vector<uint32>         m_targets;
+    std::vector<bc_callee>      m_callees;
+    // protects the resolution of `m_callees`
+    mutex                       m_mutex;
+    // interpreted calls so far, only used for deciding when to compile the function (see `interpreter::tier_up`)
+    std::atomic<unsigned>       m_calls{0};
+    std::atomic<jit_state>      m_jit_state{jit_state::None};
+    // native code of the function, set before `m_jit_state` becomes `Compiled`
+    symbol_cache_entry          m_jit_sym;
+    explicit bc_code(decl const & d):m_decl(d) {}
+};
+
+/** \brief Lower the body of an IR function to bytecode. */
+class bc_builder {
+    struct jp_binding {
+        size_t         m_idx;
+        uint32         m_label;
+        fn_body const * m_jdecl;
+    };
+    typedef std::vector<jp_binding> jp_scope;
+    struct pending_block {
+        fn_body const * m_body;
+        uint32          m_label;
+        jp_scope        m_jps;
+    };
+
+    bc_code &                                      m_code;
+    name const &                                   m_fn;
+    std::unordered_map<name, uint32, name_hash_fn> m_callee_idx;
+    // label -> pc
+    std::vector<uint32>                            m_labels;
+    std::vector<pending_block>                     m_todo;
+
+    uint32 slot(var_id const & x) {
+        // variables are 1-indexed
+        uint32 s = x.get_small_value() - 1;
+        if (s >= m_code.m_frame_size)
+            m_code.m_frame_size = s + 1;
+        return s;
+    }
+
+    uint32 arg_slot(arg const & a) {
+        return arg_is_irrelevant(a) ? g_bc_irrelevant : slot(arg_var_id(a));
+    }
+
+    uint32 args(array_ref<arg> const & as) {
+        uint32 start = m_code.m_slots.size();
+        for (arg const & a : as)
+            m_code.m_slots.push_back(arg_slot(a));
+        return start;
+    }
+
+    uint32 callee(name const & fn) {
+        auto it = m_callee_idx.find(fn);
+        if (it != m_callee_idx.end())
+            return it->second;
+        uint32 idx = m_code.m_callees.size();
+        m_code.m_callees.emplace_back(fn);
+        m_callee_idx.insert(mk_pair(fn, idx));
+        return idx;
+    }
+
+    uint32 ctor(ctor_info const & i) {
+        uint32 idx = m_code.m_ctors.size();
+        m_code.m_ctors.push_back(bc_ctor_layout {
+                static_cast<unsigned>(ctor_info_tag(i).get_small_value()),
+                static_cast<unsigned>(ctor_info_size(i).get_small_value()),
+                static_cast<unsigned>(ctor_info_usize(i).get_small_value() * sizeof(void *) + ctor_info_ssize(i).get_small_value())});
+        return idx;
+    }
+
+    uint32 const_value(value v) {
+        m_code.m_consts.push_back(v);
+        return m_code.m_consts.size() - 1;
+    }
+
+    uint32 new_label() {
+        m_labels.push_back(g_bc_no_target);
+        return m_labels.size() - 1;
+    }
+
+    void emit(bc_opcode op, uint32 dst = 0, uint32 a = 0, uint32 b = 0, uint32 c = 0, uint32 d = 0,
+              type t = type::Irrelevant, bool flag = false) {
+        m_code.m_instrs.push_back(bc_instr { op, flag, t, dst, a, b, c, d });
+    }
+
+    void compile_expr(expr const & e, type t, uint32 dst) {
+        switch (expr_tag(e)) {
+        case expr_kind::Ctor: {
+            ctor_info const & i = expr_ctor_info(e);
+            if (ctor_info_size(i).get_small_value() == 0 && ctor_info_usize(i).get_small_value() == 0 &&
+                ctor_info_ssize(i).get_small_value() == 0) {
+                // a constructor without data is optimized to a tagged pointer
+                emit(bc_opcode::Const, dst, const_value(box(ctor_info_tag(i).get_small_value())));
+            } else {
+                emit(bc_opcode::Ctor, dst, args(expr_ctor_args(e)), expr_ctor_args(e).size(), ctor(i));
+            }
+            return;
+        }
+        case expr_kind::Reset:
+            emit(bc_opcode::Reset, dst, slot(expr_reset_obj(e)), expr_reset_num_objs(e).get_small_value());
+            return;
+        case expr_kind::Reuse:
+            emit(bc_opcode::Reuse, dst, slot(expr_reuse_obj(e)), args(expr_reuse_args(e)), expr_reuse_args(e).size(),
+                 ctor(expr_reuse_ctor(e)), type::Irrelevant, expr_reuse_update_header(e));
+            return;
+        case expr_kind::Proj:
+            emit(bc_opcode::Proj, dst, slot(expr_proj_obj(e)), expr_proj_idx(e).get_small_value());
+            return;
+        case expr_kind::UProj:
+            emit(bc_opcode::UProj, dst, slot(expr_uproj_obj(e)), expr_uproj_idx(e).get_small_value());
+            return;
+        case expr_kind::SProj:
+            if (type_is_scalar(t) && t != type::USize) {
+                size_t offset = expr_sproj_idx(e).get_small_value() * sizeof(void *) + expr_sproj_offset(e).get_small_value();
+                emit(bc_opcode::SProj, dst, slot(expr_sproj_obj(e)), offset, 0, 0, t);
+            } else {
+                emit(bc_opcode::Invalid);
+            }
+            return;
+        case expr_kind::FAp:
+            if (expr_fap_args(e).size()) {
+                emit(bc_opcode::FAp, dst, callee(expr_fap_fun(e)), args(expr_fap_args(e)), expr_fap_args(e).size());
+            } else {
+                // nullary function ("constant")
+                emit(bc_opcode::Load, dst, callee(expr_fap_fun(e)), 0, 0, 0, t);
+            }
+            return;
+        case expr_kind::PAp:
+            emit(bc_opcode::PAp, dst, callee(expr_pap_fun(e)), args(expr_pap_args(e)), expr_pap_args(e).size());
+            return;
+        case expr_kind::Ap:
+            emit(bc_opcode::Ap, dst, slot(expr_ap_fun(e)), args(expr_ap_args(e)), expr_ap_args(e).size());
+            return;
+        case expr_kind::Box:
+            emit(bc_opcode::Box, dst, slot(expr_box_obj(e)), 0, 0, 0, expr_box_type(e));
+            return;
+        case expr_kind::Unbox:
+            emit(bc_opcode::Unbox, dst, slot(expr_unbox_obj(e)), 0, 0, 0, t);
+            return;
+        case expr_kind::Lit:
+            switch (lit_val_tag(expr_lit_val(e))) {
+            case lit_val_kind::Num: {
+                nat const & n = lit_val_num(expr_lit_val(e));
+                switch (t) {
+                case type::Float:
+                    lean_inc(n.raw());
+                    emit(bc_opcode::Const, dst, const_value(value::from_float(lean_float_of_nat(n.raw()))));
+                    return;
+                case type::UInt8: case type::UInt16: case type::UInt32: case type::USize:
+                    emit(bc_opcode::Const, dst, const_value(lean_usize_of_nat(n.raw())));
+                    return;
+                case type::UInt64:
+                    emit(bc_opcode::Const, dst, const_value(lean_uint64_of_nat(n.raw())));
+                    return;
+                case type::Object: case type::TObject:
+                    m_code.m_objs.push_back(n);
+                    emit(bc_opcode::LitObj, dst, m_code.m_objs.size() - 1);
+                    return;
+                case type::Irrelevant:
+                    emit(bc_opcode::Invalid);
+                    return;
+                }
+                break;
+            }
+            case lit_val_kind::Str:
+                m_code.m_objs.push_back(lit_val_str(expr_lit_val(e)));
+                emit(bc_opcode::LitObj, dst, m_code.m_objs.size() - 1);
+                return;
+            }
+            break;
+        case expr_kind::IsShared:
+            emit(bc_opcode::IsShared, dst, slot(expr_is_shared_obj(e)));
+            return;
+        case expr_kind::IsTaggedPtr:
+            emit(bc_opcode::IsTaggedPtr, dst, slot(expr_is_tagged_ptr_obj(e)));
+            return;
+        }
+        throw exception(sstream() << "unexpected instruction kind " << static_cast<unsigned>(expr_tag(e)));
+    }
+
+    /** \brief Return true if `b` is `let x := f args; ret x` where `f` is the function being compiled. */
+    bool is_tail_call(fn_body const & b) {
+        expr const & e = fn_body_vdecl_expr(b);
+        fn_body const & cont = fn_body_vdecl_cont(b);
+        return expr_tag(e) == expr_kind::FAp && expr_fap_fun(e) == m_fn &&
+            fn_body_tag(cont) == fn_body_kind::Ret && !arg_is_irrelevant(fn_body_ret_arg(cont)) &&
+            arg_var_id(fn_body_ret_arg(cont)) == fn_body_vdecl_var(b);
+    }
+
+    void compile_case(fn_body const & b, jp_scope const & jps) {
+        array_ref<alt_core> const & alts = fn_body_case_alts(b);
+        // alternatives are tried in order, so a tag is mapped to the first matching alternative
+        std::vector<uint32> table;
+        uint32 dflt = g_bc_no_target;
+        for (alt_core const & a : alts) {
+            uint32 label = new_label();
+            if (alt_core_tag(a) == alt_core_kind::Default) {
+                dflt = label;
+                m_todo.push_back(pending_block { &alt_core_default_cont(a), label, jps });
+                break;
+            }
+            size_t tag = ctor_info_tag(alt_core_ctor_info(a)).get_small_value();
+            if (tag >= table.size())
+                table.resize(tag + 1, g_bc_no_target);
+            if (table[tag] == g_bc_no_target)
+                table[tag] = label;
+            m_todo.push_back(pending_block { &alt_core_ctor_cont(a), label, jps });
+        }
+        uint32 start = m_code.m_targets.size();
+        for (uint32 label : table)
+            m_code.m_targets.push_back(label == g_bc_no_target ? dflt : label);
+        emit(bc_opcode::Case, 0, slot(fn_body_case_var(b)), start, table.size(), dflt, fn_body_case_var_type(b));
+    }
+
+    void compile_block(fn_body const * b, jp_scope jps) {
+        while (true) {
+            switch (fn_body_tag(*b)) {
+            case fn_body_kind::VDecl:
+                if (is_tail_call(*b)) {
+                    array_ref<arg> const & as = expr_fap_args(fn_body_vdecl_expr(*b));
+                    emit(bc_opcode::TailCall, 0, args(as), as.size());
+                    return;
+                }
+                compile_expr(fn_body_vdecl_expr(*b), fn_body_vdecl_type(*b), slot(fn_body_vdecl_var(*b)));
+                b = &fn_body_vdecl_cont(*b);
+                break;
+            case fn_body_kind::JDecl: {
+                uint32 label = new_label();
+                for (param const & p : fn_body_jdecl_params(*b))
+                    slot(param_var(p));
+                // the body of a join point cannot jump to the join point itself
+                m_todo.push_back(pending_block { &fn_body_jdecl_body(*b), label, jps });
+                jps.push_back(jp_binding { fn_body_jdecl_id(*b).get_small_value(), label, b });
+                b = &fn_body_jdecl_cont(*b);
+                break;
+            }
+            case fn_body_kind::Set:
+                emit(bc_opcode::Set, 0, slot(fn_body_set_var(*b)), fn_body_set_idx(*b).get_small_value(), arg_slot(fn_body_set_arg(*b)));
+                b = &fn_body_set_cont(*b);
+                break;
+            case fn_body_kind::SetTag:
+                emit(bc_opcode::SetTag, 0, slot(fn_body_set_tag_var(*b)), fn_body_set_tag_cidx(*b).get_small_value());
+                b = &fn_body_set_tag_cont(*b);
+                break;
+            case fn_body_kind::USet:
+                emit(bc_opcode::USet, 0, slot(fn_body_uset_target(*b)), fn_body_uset_idx(*b).get_small_value(), slot(fn_body_uset_source(*b)));
+                b = &fn_body_uset_cont(*b);
+                break;
+            case fn_body_kind::SSet: {
+                type t = fn_body_sset_type(*b);
+                if (type_is_scalar(t) && t != type::USize) {
+                    size_t offset = fn_body_sset_idx(*b).get_small_value() * sizeof(void *) + fn_body_sset_offset(*b).get_small_value();
+                    emit(bc_opcode::SSet, 0, slot(fn_body_sset_target(*b)), offset, slot(fn_body_sset_source(*b)), 0, t);
+                } else {
+                    emit(bc_opcode::Invalid);
+                }
+                b = &fn_body_sset_cont(*b);
+                break;
+            }
+            case fn_body_kind::Inc:
+                emit(bc_opcode::Inc, 0, slot(fn_body_inc_var(*b)), fn_body_inc_val(*b).get_small_value());
+                b = &fn_body_inc_cont(*b);
+                break;
+            case fn_body_kind::Dec:
+                emit(bc_opcode::Dec, 0, slot(fn_body_dec_var(*b)), fn_body_dec_val(*b).get_small_value());
+                b = &fn_body_dec_cont(*b);
+                break;
+            case fn_body_kind::Del:
+                emit(bc_opcode::Del, 0, slot(fn_body_del_var(*b)));
+                b = &fn_body_del_cont(*b);
+                break;
+            case fn_body_kind::MData: // metadata; no-op
+                b = &fn_body_mdata_cont(*b);
+                break;
+            case fn_body_kind::Case:
+                compile_case(*b, jps);
+                return;
+            case fn_body_kind::Ret:
+                emit(bc_opcode::Ret, 0, arg_slot(fn_body_ret_arg(*b)));
+                return;
+            case fn_body_kind::Jmp: {
+                size_t idx = fn_body_jmp_jp(*b).get_small_value();
+                auto it = std::find_if(jps.rbegin(), jps.rend(), [&](jp_binding const & jp) { return jp.m_idx == idx; });
+                if (it == jps.rend())
+                    throw exception(sstream() << "unknown join point " << idx);
+                array_ref<param> const & params = fn_body_jdecl_params(*it->m_jdecl);
+                array_ref<arg> const & as = fn_body_jmp_args(*b);
+                lean_assert(params.size() == as.size());
+                uint32 arg_start = args(as);
+                uint32 param_start = m_code.m_slots.size();
+                for (param const & p : params)
+                    m_code.m_slots.push_back(slot(param_var(p)));
+                emit(bc_opcode::Jmp, 0, arg_start, as.size(), param_start, it->m_label);
+                return;
+            }
+            case fn_body_kind::Unreachable:
+                emit(bc_opcode::Unreachable);
+                return;
+            }
+        }
+    }
+
+public:
+    bc_builder(bc_code & c):m_code(c), m_fn(decl_fun_id(c.m_decl)) {}
+
+    void operator()() {
+        for (param const & p : decl_params(m_code.m_decl))
+            slot(param_var(p));
+        compile_block(&decl_fun_body(m_code.m_decl), jp_scope());
+        while (!m_todo.empty()) {
+            pending_block blk = std::move(m_todo.back());
+            m_todo.pop_back();
+            m_labels[blk.m_label] = m_code.m_instrs.size();
+            compile_block(blk.m_body, std::move(blk.m_jps));
+        }
+        // replace labels with program counters
+        for (uint32 & t : m_code.m_targets)
+            if (t != g_bc_no_target)
+                t = m_labels[t];
+        for (bc_instr & i : m_code.m_instrs) {
+            if ((i.m_op == bc_opcode::Case || i.m_op == bc_opcode::Jmp) && i.m_d != g_bc_no_target)
+                i.m_d = m_labels[i.m_d];
+        }
+    }
+};
+
+/** \brief Symbol lookups and bytecode of imported IR functions, shared by all interpreters (in all threads) whose
+    environments have the same imports and that agree on `interpreter.prefer_native`.
+
+    The IR and the `[init]` attributes of imported functions cannot change, and neither can the native symbols of the
+    current binary, so the results of `lookup_symbol` and the bytecode of these functions can be reused by any interpreter
+    for such an environment. Bytecode of imported functions only calls imported functions, so it only refers to bytecode
+    in the same shared cache, and the functions it compiles just in time are added to the cache's `jit_library`. Objects
+    stored in the cache are marked as multi-threaded. The cache refers to the IR stored in the compacted regions of the
+    imported modules, so all shared caches are released when a region is freed, see `clear_interpreter_shared_caches`. */
+class interpreter_shared_cache {
+    mutex                                                                    m_mutex;
+    std::unordered_map<name, symbol_cache_entry, name_hash_fn>               m_symbols;
+    std::unordered_map<name, std::unique_ptr<bc_code>, name_hash_fn>         m_codes;
+    jit_library                                                              m_jit;
+public:
+    optional<symbol_cache_entry> find_symbol(name const & fn) {
+        lock_guard<mutex> _(m_mutex);
+        auto it = m_symbols.find(fn);
+        if (it == m_symbols.end())
+            return optional<symbol_cache_entry>();
+        return optional<symbol_cache_entry>(it->second);
+    }
+
+    void insert_symbol(name const & fn, symbol_cache_entry const & e) {
+        mark_mt(fn.raw());
+        mark_mt(e.m_decl.raw());
+        lock_guard<mutex> _(m_mutex);
+        m_symbols.emplace(fn, e);
+    }
+
+    /** \brief Return the bytecode of `d`, using `build` to create it if it is not in the cache yet. */
+    template<class F> bc_code & get_code(decl const & d, F const & build) {
+        lock_guard<mutex> _(m_mutex);
+        auto it = m_codes.find(decl_fun_id(d));
+        if (it != m_codes.end())
+            return *it->second;
+        mark_mt(d.raw());
+        std::unique_ptr<bc_code> c = build(d);
+        bc_code & r = *c;
+        m_codes.emplace(decl_fun_id(d), std::move(c));
+        return r;
+    }
+
+    jit_library & jit() { return m_jit; }
+
+    /** \brief Return the shared cache for `env` and `prefer_native`. */
+    static std::shared_ptr<interpreter_shared_cache> get(environment const & env, bool prefer_native);
+};
+
+#ifndef LEAN_INTERPRETER_MAX_SHARED_CACHES
+#define LEAN_INTERPRETER_MAX_SHARED_CACHES 8
+#endif
+
+struct interpreter_shared_cache_entry {
+    // `get_imports_key()` of the environments using `m_cache`
+    object_ref                                m_imports_key;
+    bool                                      m_prefer_native;
+    std::shared_ptr<interpreter_shared_cache> m_cache;
+};
+static mutex * g_interpreter_shared_caches_mutex = nullptr;
+// most recently created last
+static std::vector<interpreter_shared_cache_entry> * g_interpreter_shared_caches = nullptr;
+
+std::shared_ptr<interpreter_shared_cache> interpreter_shared_cache::get(environment const & env, bool prefer_native) {
+    object_ref imports_key = env.get_imports_key();
+    lock_guard<mutex> _(*g_interpreter_shared_caches_mutex);
+    for (interpreter_shared_cache_entry const & e : *g_interpreter_shared_caches) {
+        if (e.m_imports_key.raw() == imports_key.raw() && e.m_prefer_native == prefer_native)
+            return e.m_cache;
+    }
+    if (g_interpreter_shared_caches->size() >= LEAN_INTERPRETER_MAX_SHARED_CACHES) {
+        // interpreters still using the evicted cache keep it alive
+        g_interpreter_shared_caches->erase(g_interpreter_shared_caches->begin());
+    }
+    // only marks the array of regions, not the imported declarations
+    mark_mt(imports_key.raw());
+    std::shared_ptr<interpreter_shared_cache> c = std::make_shared<interpreter_shared_cache>();
+    g_interpreter_shared_caches->push_back(interpreter_shared_cache_entry { imports_key, prefer_native, c });
+    return c;
+}
+
+/** \brief Called by `lean_compacted_region_free` while the region is still mapped. We do not know which environments
+    use the region, so all shared caches are released. Interpreters running in other threads keep their cache alive,
+    but they cannot be using the freed region. So, caches evicted by `interpreter_shared_cache::get` and the ones left at
+    finalization only refer to regions that are still mapped. */
+static void clear_interpreter_shared_caches() {
+    std::vector<interpreter_shared_cache_entry> entries;
+    {
+        lock_guard<mutex> _(*g_interpreter_shared_caches_mutex);
+        entries.swap(*g_interpreter_shared_caches);
+    }
+}
+
+// Profiling
+// =========
+
+/** \brief Counters of a function called by interpreted code, see `interpreter.profile`. */
+struct profile_entry {
+    uint64          m_calls        = 0;
+    // calls that ran native code
+    uint64          m_native_calls = 0;
+    // objects (constructor objects, closures and boxed scalars) allocated by interpreted code of the function;
+    // allocations done by native code are not included
+    uint64          m_allocs       = 0;
+    // recursive calls are only counted once
+    second_duration m_inclusive{0};
+    second_duration m_exclusive{0};
+    // number of active calls, used by the interpreter for computing `m_inclusive`
+    unsigned        m_active       = 0;
+
+    void add(profile_entry const & e) {
+        m_calls        += e.m_calls;
+        m_native_calls += e.m_native_calls;
+        m_allocs       += e.m_allocs;
+        m_inclusive    += e.m_inclusive;
+        m_exclusive    += e.m_exclusive;
+    }
+};
+
+#ifndef LEAN_INTERPRETER_PROFILE_MAX_ENTRIES
+#define LEAN_INTERPRETER_PROFILE_MAX_ENTRIES 50
+#endif
+
+// profiles of all interpreters that have been destroyed, by function name. The names are stored as strings because the
+// report is displayed at exit, when the regions holding imported names may have been freed already.
+static mutex * g_profile_mutex = nullptr;
+static std::unordered_map<std::string, profile_entry> * g_profile = nullptr;
+// exclusive time of each call stack (`f;g;h`)
+static std::map<std::string, second_duration> * g_profile_folded = nullptr;
+// value of `interpreter.profile.folded`
+static std::string * g_profile_folded_file = nullptr;
+
+void display_interpreter_profile(std::ostream & out) {
+    lock_guard<mutex> _(*g_profile_mutex);
+    if (g_profile->empty())
+        return;
+    std::vector<std::pair<std::string, profile_entry>> entries(g_profile->begin(), g_profile->end());
+    std::sort(entries.begin(), entries.end(), [](std::pair<std::string, profile_entry> const & e1, std::pair<std::string, profile_entry> const & e2) {
+            return e1.second.m_exclusive > e2.second.m_exclusive;
+        });
+    sstream ss;
+    ss << "interpreter profile (exclusive time, inclusive time, calls, native calls, allocations):\n";
+    for (size_t i = 0; i < entries.size() && i < LEAN_INTERPRETER_PROFILE_MAX_ENTRIES; i++) {
+        profile_entry const & e = entries[i].second;
+        ss << "\t" << entries[i].first << " " << display_profiling_time{e.m_exclusive} << " "
+           << display_profiling_time{e.m_inclusive} << " " << e.m_calls << " " << e.m_native_calls << " "
+           << e.m_allocs << "\n";
+    }
+    // output atomically, like IO.print
+    out << ss.str();
+    if (!g_profile_folded_file->empty()) {
+        std::ofstream folded(*g_profile_folded_file);
+        // the format expected by e.g. `flamegraph.pl`, using microseconds
+        for (auto const & p : *g_profile_folded)
+            folded << p.first << " " << static_cast<uint64>(p.second.count() * 1000000) << "\n";
+    }
+}
+
 class interpreter;
 LEAN_THREAD_PTR(interpreter, g_interpreter);
 
@@ -346,15 +1032,39 @@ class interpreter {
     };
     // caches values of nullary functions ("constants")
     name_map<constant_cache_entry> m_constant_cache;
-    struct symbol_cache_entry {
-        decl m_decl;
-        // symbol address; `nullptr` if function does not have native code
-        void * m_addr;
-        // true iff we chose the boxed version of a function where the IR uses the unboxed version
-        bool m_boxed;
-    };
     // caches symbol lookup successes _and_ failures
     name_map<symbol_cache_entry> m_symbol_cache;
+    // if `true`, interpreted functions are lowered to bytecode, see `bc_builder`
+    bool m_use_bytecode;
+    // bytecode of functions of the current module
+    std::unordered_map<name, std::unique_ptr<bc_code>, name_hash_fn> m_code_cache;
+    // symbol lookups and bytecode of imported functions
+    std::shared_ptr<interpreter_shared_cache> m_shared_cache;
+
+    // number of interpreted calls of an imported function after which it is compiled to native code; 0 if disabled
+    unsigned m_jit_threshold;
+
+    // if `true`, collect a `profile_entry` for each called function
+    bool m_profile;
+    struct profile_frame {
+        std::chrono::steady_clock::time_point m_start;
+        // inclusive time of the callees
+        second_duration                       m_children;
+        profile_entry *                       m_entry;
+        // node of the call stack in `m_profile_tree`
+        unsigned                              m_node;
+    };
+    // parallel to `m_call_stack`
+    std::vector<profile_frame> m_profile_stack;
+    std::unordered_map<name, profile_entry, name_hash_fn> m_profile_entries;
+    // tree of call stacks; the root (index 0) represents the empty stack
+    struct profile_node {
+        unsigned                                       m_parent;
+        name                                           m_fn;
+        second_duration                                m_exclusive{0};
+        std::unordered_map<name, unsigned, name_hash_fn> m_children;
+    };
+    std::vector<profile_node> m_profile_tree;
 
     /** \brief Get current stack frame */
     inline frame & get_frame() {
@@ -381,7 +1091,8 @@ public:
             // We changed threads or the closure was stored and called in a different context.
             time_task t("interpretation", opts, fn);
             scope_trace_env scope_trace(env, opts);
-            // the caches contain data from the Environment, so we cannot reuse them when changing it
+            // the caches contain data from the Environment, so we cannot reuse them when changing it; data about
+            // imported functions is kept in `interpreter_shared_cache`, so the new interpreter starts warm
             interpreter interp(env, opts);
             flet<interpreter *> fl(g_interpreter, &interp);
             return f(interp);
@@ -407,6 +1118,7 @@ private:
             // a constructor without data is optimized to a tagged pointer
             return box(tag);
         } else {
+            profile_alloc();
             object *o = alloc_cnstr(tag, size, usize * sizeof(void *) + ssize);
             for (size_t i = 0; i < args.size(); i++) {
                 cnstr_set(o, i, eval_arg(args[i]).m_obj);
@@ -428,6 +1140,27 @@ private:
         return cls;
     }
 
+    /** \brief Return a partial application of `sym` to `n` arguments, where `arg_i(i)` is the value of the `i`-th argument. */
+    template<class F>
+    object * mk_pap(symbol_cache_entry const & sym, unsigned n, F const & arg_i) {
+        profile_alloc();
+        if (sym.m_addr) {
+            // point closure directly at native symbol
+            object * cls = alloc_closure(sym.m_addr, decl_params(sym.m_decl).size(), n);
+            for (unsigned i = 0; i < n; i++) {
+                closure_set(cls, i, arg_i(i).m_obj);
+            }
+            return cls;
+        } else {
+            // point closure at interpreter stub
+            object ** args = static_cast<object **>(LEAN_ALLOCA(n * sizeof(object *))); // NOLINT
+            for (unsigned i = 0; i < n; i++) {
+                args[i] = arg_i(i).m_obj;
+            }
+            return mk_stub_closure(sym.m_decl, n, args);
+        }
+    }
+
     value eval_expr(expr const & e, type t) {
         switch (expr_tag(e)) {
             case expr_kind::Ctor:
@@ -492,22 +1225,8 @@ private:
                 }
             }
             case expr_kind::PAp: { // unsatured (partial) application of top-level function
-                symbol_cache_entry sym = lookup_symbol(expr_pap_fun(e));
-                if (sym.m_addr) {
-                    // point closure directly at native symbol
-                    object * cls = alloc_closure(sym.m_addr, decl_params(sym.m_decl).size(), expr_pap_args(e).size());
-                    for (unsigned i = 0; i < expr_pap_args(e).size(); i++) {
-                        closure_set(cls, i, eval_arg(expr_pap_args(e)[i]).m_obj);
-                    }
-                    return cls;
-                } else {
-                    // point closure at interpreter stub
-                    object ** args = static_cast<object **>(LEAN_ALLOCA(expr_pap_args(e).size() * sizeof(object *))); // NOLINT
-                    for (size_t i = 0; i < expr_pap_args(e).size(); i++) {
-                        args[i] = eval_arg(expr_pap_args(e)[i]).m_obj;
-                    }
-                    return mk_stub_closure(sym.m_decl, expr_pap_args(e).size(), args);
-                }
+                array_ref<arg> const & args = expr_pap_args(e);
+                return mk_pap(lookup_symbol(expr_pap_fun(e)), args.size(), [&](size_t i) { return eval_arg(args[i]); });
             }
             case expr_kind::Ap: { // (saturated or unsatured) application of closure; mostly handled by runtime
                 object ** args = static_cast<object **>(LEAN_ALLOCA(expr_ap_args(e).size() * sizeof(object *))); // NOLINT
@@ -518,6 +1237,8 @@ private:
                 return r;
             }
             case expr_kind::Box: // box unboxed value
+                if (box_allocates(expr_box_type(e)))
+                    profile_alloc();
                 return box_t(var(expr_box_obj(e)).m_num, expr_box_type(e));
             case expr_kind::Unbox: // unbox boxed value
                 return unbox_t(var(expr_unbox_obj(e)).m_obj, t);
@@ -727,8 +1448,377 @@ private:
         }
     }
 
+    static std::unique_ptr<bc_code> build_code(decl const & d) {
+        std::unique_ptr<bc_code> c(new bc_code(d));
+        bc_builder b(*c);
+        b();
+        return c;
+    }
+
+    /** \brief Return the bytecode of `d`, lowering it on first use. */
+    bc_code & get_code(decl const & d) {
+        name const & fn = decl_fun_id(d);
+        auto it = m_code_cache.find(fn);
+        if (it != m_code_cache.end())
+            return *it->second;
+        if (m_env.is_imported(fn))
+            return m_shared_cache->get_code(d, build_code);
+        std::unique_ptr<bc_code> c = build_code(d);
+        // only imported functions are compiled, see `jit`
+        c->m_jit_state = jit_state::Failed;
+        bc_code & r = *c;
+        m_code_cache.emplace(fn, std::move(c));
+        return r;
+    }
+
+    void resolve(bc_code & c, bc_callee & f) {
+        lock_guard<mutex> _(c.m_mutex);
+        if (f.m_resolved.load(std::memory_order_relaxed))
+            return;
+        f.m_sym = lookup_symbol(f.m_fn);
+        if (!f.m_sym.m_addr && decl_tag(f.m_sym.m_decl) == decl_kind::Fun)
+            f.m_code = &get_code(f.m_sym.m_decl);
+        f.m_resolved.store(true, std::memory_order_release);
+    }
+
+    /** \brief Evaluate the body of `d` in the current frame. */
+    value eval_decl(decl const & d) {
+        if (m_use_bytecode)
+            return eval_code(get_code(d));
+        else
+            return eval_body(decl_fun_body(d));
+    }
+
+    value eval_code(bc_code & c) {
+        check_system();
+
+        size_t bp = get_frame().m_arg_bp;
+        // the frame size is known, so we allocate all slots upfront
+        if (m_arg_stack.size() < bp + c.m_frame_size)
+            m_arg_stack.resize(bp + c.m_frame_size);
+        // NOTE: `fp` must be reloaded after anything that may push onto `m_arg_stack`, e.g. calls
+        value * fp = m_arg_stack.data() + bp;
+        uint32 const * slots = c.m_slots.data();
+        bc_instr const * code = c.m_instrs.data();
+        bc_instr const * pc = code;
+        // an "irrelevant" argument is type- or proof-erased; we can use an arbitrary value for it
+        auto arg = [&](uint32 s) { return s == g_bc_irrelevant ? value(box(0)) : fp[s]; };
+        // argument accessor that is robust to `m_arg_stack` being resized while arguments are pushed
+        auto stack_arg = [&](uint32 s) { return s == g_bc_irrelevant ? value(box(0)) : m_arg_stack[bp + s]; };
+        auto alloc_ctor = [&](bc_ctor_layout const & l, uint32 args, uint32 n) {
+            profile_alloc();
+            object * o = alloc_cnstr(l.m_tag, l.m_size, l.m_scalar_size);
+            for (uint32 i = 0; i < n; i++)
+                cnstr_set(o, i, arg(slots[args + i]).m_obj);
+            return o;
+        };
+
+#ifdef LEAN_BC_THREADED_DISPATCH
+        // must be in the same order as `bc_opcode`
+        static void * const s_dispatch[] = {
+            &&op_Ctor, &&op_Reset, &&op_Reuse, &&op_Proj, &&op_UProj, &&op_SProj, &&op_FAp, &&op_Load, &&op_PAp,
+            &&op_Ap, &&op_Box, &&op_Unbox, &&op_Const, &&op_LitObj, &&op_IsShared, &&op_IsTaggedPtr, &&op_Set,
+            &&op_SetTag, &&op_USet, &&op_SSet, &&op_Inc, &&op_Dec, &&op_Del, &&op_Case, &&op_Ret, &&op_Jmp,
+            &&op_TailCall, &&op_Unreachable, &&op_Invalid
+        };
+#define BC_CASE(op) op_##op:
+#define BC_NEXT() goto *s_dispatch[static_cast<unsigned>(pc->m_op)]
+        BC_NEXT();
+        {
+#else
+#define BC_CASE(op) case bc_opcode::op:
+#define BC_NEXT() continue
+        while (true) {
+            switch (pc->m_op) {
+#endif
+            BC_CASE(Ctor) {
+                fp[pc->m_dst] = alloc_ctor(c.m_ctors[pc->m_c], pc->m_a, pc->m_b);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Reset) { // release fields if unique reference in preparation for `Reuse` below
+                object * o = fp[pc->m_a].m_obj;
+                if (is_exclusive(o)) {
+                    for (uint32 i = 0; i < pc->m_b; i++)
+                        cnstr_release(o, i);
+                    fp[pc->m_dst] = o;
+                } else {
+                    dec_ref(o);
+                    fp[pc->m_dst] = box(0);
+                }
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Reuse) { // reuse dead allocation if possible
+                object * o = fp[pc->m_a].m_obj;
+                bc_ctor_layout const & l = c.m_ctors[pc->m_d];
+                if (is_scalar(o)) {
+                    // `Reset` above did not have a unique reference, fall back to regular allocation
+                    o = alloc_ctor(l, pc->m_b, pc->m_c);
+                } else {
+                    if (pc->m_flag)
+                        cnstr_set_tag(o, l.m_tag);
+                    for (uint32 i = 0; i < pc->m_c; i++)
+                        cnstr_set(o, i, arg(slots[pc->m_b + i]).m_obj);
+                }
+                fp[pc->m_dst] = o;
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Proj) {
+                fp[pc->m_dst] = cnstr_get(fp[pc->m_a].m_obj, pc->m_b);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(UProj) {
+                fp[pc->m_dst] = cnstr_get_usize(fp[pc->m_a].m_obj, pc->m_b);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(SProj) {
+                object * o = fp[pc->m_a].m_obj;
+                value v;
+                switch (pc->m_type) {
+                    case type::Float: v = value::from_float(cnstr_get_float(o, pc->m_b)); break;
+                    case type::UInt8: v = cnstr_get_uint8(o, pc->m_b); break;
+                    case type::UInt16: v = cnstr_get_uint16(o, pc->m_b); break;
+                    case type::UInt32: v = cnstr_get_uint32(o, pc->m_b); break;
+                    default: v = cnstr_get_uint64(o, pc->m_b); break;
+                }
+                fp[pc->m_dst] = v;
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(FAp) { // satured ("full") application of top-level function
+                bc_callee & f = c.m_callees[pc->m_a];
+                if (!f.m_resolved.load(std::memory_order_acquire))
+                    resolve(c, f);
+                uint32 args = pc->m_b;
+                value r = call_core(f.m_fn, f.m_sym, f.m_code, pc->m_c, [&](size_t i) { return stack_arg(slots[args + i]); });
+                fp = m_arg_stack.data() + bp;
+                fp[pc->m_dst] = r;
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Load) { // nullary function ("constant")
+                value r = load(c.m_callees[pc->m_a].m_fn, pc->m_type);
+                fp = m_arg_stack.data() + bp;
+                fp[pc->m_dst] = r;
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(PAp) { // unsatured (partial) application of top-level function
+                bc_callee & f = c.m_callees[pc->m_a];
+                if (!f.m_resolved.load(std::memory_order_acquire))
+                    resolve(c, f);
+                uint32 args = pc->m_b;
+                fp[pc->m_dst] = mk_pap(f.m_sym, pc->m_c, [&](size_t i) { return arg(slots[args + i]); });
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Ap) { // (saturated or unsatured) application of closure; mostly handled by runtime
+                uint32 n = pc->m_c;
+                object ** args = static_cast<object **>(LEAN_ALLOCA(n * sizeof(object *))); // NOLINT
+                for (uint32 i = 0; i < n; i++)
+                    args[i] = arg(slots[pc->m_b + i]).m_obj;
+                object * r = apply_n(fp[pc->m_a].m_obj, n, args);
+                fp = m_arg_stack.data() + bp;
+                fp[pc->m_dst] = r;
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Box) {
+                if (box_allocates(pc->m_type))
+                    profile_alloc();
+                fp[pc->m_dst] = box_t(fp[pc->m_a], pc->m_type);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Unbox) {
+                fp[pc->m_dst] = unbox_t(fp[pc->m_a].m_obj, pc->m_type);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Const) {
+                fp[pc->m_dst] = c.m_consts[pc->m_a];
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(LitObj) {
+                object * o = c.m_objs[pc->m_a].raw();
+                lean_inc(o);
+                fp[pc->m_dst] = o;
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(IsShared) {
+                fp[pc->m_dst] = static_cast<uint64>(!is_exclusive(fp[pc->m_a].m_obj));
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(IsTaggedPtr) {
+                fp[pc->m_dst] = static_cast<uint64>(!is_scalar(fp[pc->m_a].m_obj));
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Set) { // set boxed field of unique reference
+                object * o = fp[pc->m_a].m_obj;
+                lean_assert(is_exclusive(o));
+                cnstr_set(o, pc->m_b, arg(pc->m_c).m_obj);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(SetTag) { // set constructor tag of unique reference
+                object * o = fp[pc->m_a].m_obj;
+                lean_assert(is_exclusive(o));
+                cnstr_set_tag(o, pc->m_b);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(USet) { // set USize field of unique reference
+                object * o = fp[pc->m_a].m_obj;
+                lean_assert(is_exclusive(o));
+                cnstr_set_usize(o, pc->m_b, fp[pc->m_c].m_num);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(SSet) { // set other unboxed field of unique reference
+                object * o = fp[pc->m_a].m_obj;
+                value v = fp[pc->m_c];
+                lean_assert(is_exclusive(o));
+                switch (pc->m_type) {
+                    case type::Float: cnstr_set_float(o, pc->m_b, v.m_float); break;
+                    case type::UInt8: cnstr_set_uint8(o, pc->m_b, v.m_num); break;
+                    case type::UInt16: cnstr_set_uint16(o, pc->m_b, v.m_num); break;
+                    case type::UInt32: cnstr_set_uint32(o, pc->m_b, v.m_num); break;
+                    default: cnstr_set_uint64(o, pc->m_b, v.m_num); break;
+                }
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Inc) {
+                inc(fp[pc->m_a].m_obj, pc->m_b);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Dec) {
+                for (uint32 i = 0; i < pc->m_b; i++)
+                    dec(fp[pc->m_a].m_obj);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Del) {
+                lean_free_object(fp[pc->m_a].m_obj);
+                pc++;
+                BC_NEXT();
+            }
+            BC_CASE(Case) { // branch according to constructor tag
+                value v = fp[pc->m_a];
+                unsigned tag = type_is_scalar(pc->m_type) ? v.m_num : lean_obj_tag(v.m_obj);
+                uint32 target = tag < pc->m_c ? c.m_targets[pc->m_b + tag] : pc->m_d;
+                if (target == g_bc_no_target)
+                    throw exception("incomplete case");
+                pc = code + target;
+                BC_NEXT();
+            }
+            BC_CASE(Ret) {
+                return arg(pc->m_a);
+            }
+            BC_CASE(Jmp) { // jump to join-point after assigning its parameters
+                for (uint32 i = 0; i < pc->m_b; i++)
+                    fp[slots[pc->m_c + i]] = arg(slots[pc->m_a + i]);
+                pc = code + pc->m_d;
+                BC_NEXT();
+            }
+            BC_CASE(TailCall) {
+                // argument and parameter slots may overlap, so first copy arguments to end of stack
+                size_t old_size = m_arg_stack.size();
+                for (uint32 i = 0; i < pc->m_b; i++)
+                    m_arg_stack.push_back(stack_arg(slots[pc->m_a + i]));
+                // now copy to parameter slots
+                for (uint32 i = 0; i < pc->m_b; i++)
+                    m_arg_stack[bp + i] = m_arg_stack[old_size + i];
+                m_arg_stack.resize(old_size);
+                fp = m_arg_stack.data() + bp;
+                pc = code;
+                check_system();
+                BC_NEXT();
+            }
+            BC_CASE(Unreachable) {
+                throw exception("unreachable code");
+            }
+            BC_CASE(Invalid) {
+                throw exception("invalid instruction");
+            }
+#ifndef LEAN_BC_THREADED_DISPATCH
+            }
+#endif
+        }
+#undef BC_CASE
+#undef BC_NEXT
+        lean_unreachable();
+    }
+
+    void profile_enter(name const & fn, bool native) {
+        profile_entry & e = m_profile_entries[fn];
+        e.m_calls++;
+        if (native)
+            e.m_native_calls++;
+        e.m_active++;
+        unsigned parent = m_profile_stack.empty() ? 0 : m_profile_stack.back().m_node;
+        unsigned node;
+        auto it = m_profile_tree[parent].m_children.find(fn);
+        if (it != m_profile_tree[parent].m_children.end()) {
+            node = it->second;
+        } else {
+            node = m_profile_tree.size();
+            m_profile_tree[parent].m_children.emplace(fn, node);
+            m_profile_tree.push_back(profile_node { parent, fn, second_duration(0), {} });
+        }
+        m_profile_stack.push_back(profile_frame { std::chrono::steady_clock::now(), second_duration(0), &e, node });
+    }
+
+    void profile_exit() {
+        profile_frame f = m_profile_stack.back();
+        m_profile_stack.pop_back();
+        second_duration inclusive = std::chrono::steady_clock::now() - f.m_start;
+        second_duration exclusive = inclusive - f.m_children;
+        f.m_entry->m_exclusive += exclusive;
+        if (--f.m_entry->m_active == 0)
+            f.m_entry->m_inclusive += inclusive;
+        m_profile_tree[f.m_node].m_exclusive += exclusive;
+        if (!m_profile_stack.empty())
+            m_profile_stack.back().m_children += inclusive;
+    }
+
+    /** \brief Record an allocation by the current function. */
+    void profile_alloc() {
+        if (m_profile && !m_profile_stack.empty())
+            m_profile_stack.back().m_entry->m_allocs++;
+    }
+
+    static bool box_allocates(type t) {
+        return t == type::Float || t == type::UInt64 || t == type::USize || (sizeof(void *) == 4 && t == type::UInt32);
+    }
+
+    /** \brief Add the profile of this interpreter to the global profile. */
+    void report_profile() {
+        lock_guard<mutex> _(*g_profile_mutex);
+        for (auto const & p : m_profile_entries)
+            (*g_profile)[p.first.to_string()].add(p.second);
+        for (unsigned i = 1; i < m_profile_tree.size(); i++) {
+            std::string stack;
+            for (unsigned n = i; n != 0; n = m_profile_tree[n].m_parent)
+                stack = m_profile_tree[n].m_fn.to_string() + (stack.empty() ? "" : ";") + stack;
+            (*g_profile_folded)[stack] += m_profile_tree[i].m_exclusive;
+        }
+        if (char const * file = m_opts.get_string(*g_interpreter_profile_folded))
+            *g_profile_folded_file = file;
+    }
+
     // specify argument base pointer explicitly because we've usually already pushed some function arguments
-    void push_frame(decl const & d, size_t arg_bp) {
+    // `native` is true iff the function is going to be executed natively
+    void push_frame(decl const & d, size_t arg_bp, bool native = false) {
         DEBUG_CODE({
             lean_trace(name({"interpreter", "call"}),
                        tout() << std::string(m_call_stack.size(), ' ')
@@ -739,12 +1829,16 @@ private:
                        tout() << "\n";);
         });
         m_call_stack.emplace_back(decl_fun_id(d), arg_bp, m_jp_stack.size());
+        if (m_profile)
+            profile_enter(decl_fun_id(d), native);
     }
 
     void pop_frame(value DEBUG_CODE(r), type DEBUG_CODE(t)) {
         m_arg_stack.resize(get_frame().m_arg_bp);
         m_jp_stack.resize(get_frame().m_jp_bp);
         m_call_stack.pop_back();
+        if (m_profile)
+            profile_exit();
         DEBUG_CODE({
             lean_trace(name({"interpreter", "call"}),
                        tout() << std::string(m_call_stack.size(), ' ')
@@ -759,6 +1853,13 @@ private:
         if (symbol_cache_entry const * e = m_symbol_cache.find(fn)) {
             return *e;
         } else {
+            bool imported = m_env.is_imported(fn);
+            if (imported) {
+                if (optional<symbol_cache_entry> e = m_shared_cache->find_symbol(fn)) {
+                    m_symbol_cache.insert(fn, *e);
+                    return *e;
+                }
+            }
             symbol_cache_entry e_new { get_decl(fn), nullptr, false };
             if (m_prefer_native || decl_tag(e_new.m_decl) == decl_kind::Extern || has_init_attribute(m_env, fn)) {
                 string_ref mangled = name_mangle(fn, *g_mangle_prefix);
@@ -767,12 +1868,23 @@ private:
                 if (void *p_boxed = lookup_symbol_in_cur_exe(boxed_mangled.data())) {
                     e_new.m_addr = p_boxed;
                     e_new.m_boxed = true;
+                    // `extern` declarations may omit irrelevant parameters, so only call other unboxed versions directly
+                    if (decl_tag(e_new.m_decl) == decl_kind::Fun) {
+                        if (trampoline t = get_trampoline(e_new.m_decl)) {
+                            if (void * p = lookup_symbol_in_cur_exe(mangled.data())) {
+                                e_new.m_unboxed_addr = p;
+                                e_new.m_trampoline = t;
+                            }
+                        }
+                    }
                 } else if (void *p = lookup_symbol_in_cur_exe(mangled.data())) {
                     // if there is no boxed version, there are no unboxed parameters, so use default version
                     e_new.m_addr = p;
                 }
             }
             m_symbol_cache.insert(fn, e_new);
+            if (imported)
+                m_shared_cache->insert_symbol(fn, e_new);
             return e_new;
         }
     }
@@ -824,7 +1936,7 @@ private:
             throw exception(sstream() << "cannot evaluate `[init]` declaration '" << fn << "' in the same module");
         }
         push_frame(e.m_decl, m_arg_stack.size());
-        value r = eval_body(decl_fun_body(e.m_decl));
+        value r = eval_decl(e.m_decl);
         pop_frame(r, decl_type(e.m_decl));
         if (!type_is_scalar(t)) {
             inc(r.m_obj);
@@ -833,15 +1945,217 @@ private:
         return r;
     }
 
-    value call(name const & fn, array_ref<arg> const & args) {
+    /** \brief Count an interpreted call of `c`, compiling it to native code once the number of calls reaches
+        `interpreter.jit.threshold`. Return the entry of the native code of `c` if it has been compiled. */
+    symbol_cache_entry const * tier_up(bc_code & c) {
+        jit_state s = c.m_jit_state.load(std::memory_order_acquire);
+        if (LEAN_LIKELY(s != jit_state::None))
+            return s == jit_state::Compiled ? &c.m_jit_sym : nullptr;
+        // lost updates are fine, the count is only a heuristic
+        unsigned calls = c.m_calls.load(std::memory_order_relaxed) + 1;
+        c.m_calls.store(calls, std::memory_order_relaxed);
+        if (calls < m_jit_threshold)
+            return nullptr;
+        jit(c);
+        return c.m_jit_state.load(std::memory_order_acquire) == jit_state::Compiled ? &c.m_jit_sym : nullptr;
+    }
+
+    /** \brief Return true iff `o` can be copied by `mk_jit_global`. Closures and external objects cannot be compacted,
+        and a copy of a reference would not be shared with the interpreter. */
+    static bool is_jit_copyable(object * o) {
+        std::unordered_set<object *> visited;
+        buffer<object *> todo;
+        todo.push_back(o);
+        while (!todo.empty()) {
+            object * curr = todo.back();
+            todo.pop_back();
+            if (is_scalar(curr) || !visited.insert(curr).second)
+                continue;
+            switch (lean_ptr_tag(curr)) {
+                case LeanClosure: case LeanExternal: case LeanRef:
+                    return false;
+                case LeanArray:
+                    for (size_t i = 0; i < lean_array_size(curr); i++)
+                        todo.push_back(lean_array_get_core(curr, i));
+                    break;
+                case LeanThunk:
+                    todo.push_back(lean_thunk_get(curr));
+                    break;
+                case LeanTask:
+                    todo.push_back(lean_task_get(curr));
+                    break;
+                case LeanScalarArray: case LeanString: case LeanMPZ:
+                    break;
+                default:
+                    for (unsigned i = 0; i < lean_ctor_num_objs(curr); i++)
+                        todo.push_back(lean_ctor_get(curr, i));
+                    break;
+            }
+        }
+        return true;
+    }
+
+    /** \brief Return a global variable of `lib` holding the value `v` of a constant of type `t`, as expected by native
+        code. Objects are copied first, see `is_jit_copyable`. */
+    static void * mk_jit_global(jit_library & lib, value v, type t) {
+        uint64 * g = lib.mk_global();
+        switch (t) {
+            case type::Float: *reinterpret_cast<double *>(g) = v.m_float; break;
+            case type::UInt8: *reinterpret_cast<uint8 *>(g) = v.m_num; break;
+            case type::UInt16: *reinterpret_cast<uint16 *>(g) = v.m_num; break;
+            case type::UInt32: *reinterpret_cast<uint32 *>(g) = v.m_num; break;
+            case type::UInt64: *g = v.m_num; break;
+            case type::USize: *reinterpret_cast<size_t *>(g) = v.m_num; break;
+            case type::Object:
+            case type::TObject:
+            case type::Irrelevant:
+                // Native code assumes that the values of constants are persistent, as they are after module
+                // initialization. `v` may be shared with other threads by the constant cache, so we cannot mark it
+                // persistent in place; the objects of a compacted region are persistent instead.
+                if (is_scalar(v.m_obj))
+                    *reinterpret_cast<object **>(g) = v.m_obj;
+                else
+                    *reinterpret_cast<object **>(g) = lib.mk_persistent(v.m_obj);
+                break;
+        }
+        return g;
+    }
+
+    /** \brief Add to `codes` the bytecode of the interpreted functions transitively used by `codes[0]`, and to
+        `consts` the values of the interpreted constants they use. Return false if they cannot be compiled; `retry`
+        is set if that is only because another thread is compiling one of them. */
+    bool jit_collect(buffer<bc_code *> & codes, buffer<jit_constant> & consts, bool & retry, std::string & error) {
+        std::unordered_set<bc_code *> mine(codes.begin(), codes.end());
+        std::unordered_set<name, name_hash_fn> seen_consts;
+        for (unsigned i = 0; i < codes.size(); i++) {
+            for (bc_callee const & f : codes[i]->m_callees) {
+                symbol_cache_entry e = lookup_symbol(f.m_fn);
+                if (e.m_addr)
+                    continue;
+                if (decl_tag(e.m_decl) == decl_kind::Extern || !m_env.is_imported(f.m_fn) || has_init_attribute(m_env, f.m_fn)) {
+                    error = (sstream() << "'" << f.m_fn << "' cannot be compiled").str();
+                    return false;
+                }
+                if (decl_params(e.m_decl).size() == 0) {
+                    if (seen_consts.insert(f.m_fn).second) {
+                        type t = decl_type(e.m_decl);
+                        value v = load(f.m_fn, t);
+                        if (!type_is_scalar(t) && !is_jit_copyable(v.m_obj)) {
+                            error = (sstream() << "value of '" << f.m_fn << "' cannot be copied").str();
+                            return false;
+                        }
+                        string_ref mangled = name_mangle(f.m_fn, *g_mangle_prefix);
+                        void * g = mk_jit_global(m_shared_cache->jit(), v, t);
+                        consts.push_back(jit_constant { mangled.to_std_string(), g });
+                    }
+                    continue;
+                }
+                bc_code & callee = get_code(e.m_decl);
+                if (mine.count(&callee))
+                    continue;
+                jit_state expected = jit_state::None;
+                if (callee.m_jit_state.compare_exchange_strong(expected, jit_state::Compiling)) {
+                    codes.push_back(&callee);
+                    mine.insert(&callee);
+                } else if (expected == jit_state::Compiling) {
+                    retry = true;
+                    return false;
+                } else if (expected == jit_state::Failed) {
+                    error = (sstream() << "'" << f.m_fn << "' cannot be compiled").str();
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /** \brief Compile `root` and the interpreted functions it uses to native code, see `jit_compile`.
+
+        The interpreted constants they use are evaluated first; native code uses persistent copies of their values. */
+    void jit(bc_code & root) {
+        jit_state expected = jit_state::None;
+        if (!root.m_jit_state.compare_exchange_strong(expected, jit_state::Compiling))
+            return;
+        buffer<bc_code *> codes;
+        codes.push_back(&root);
+        buffer<jit_function> fns;
+        // index in `fns` of the symbol to use for each entry of `codes`, and whether it is the boxed version
+        buffer<std::pair<unsigned, bool>> syms;
+        buffer<jit_constant> consts;
+        buffer<void *> addrs;
+        bool retry = false;
+        std::string error;
+        bool ok;
+        try {
+            ok = jit_collect(codes, consts, retry, error);
+        } catch (...) {
+            for (bc_code * c : codes)
+                c->m_jit_state.store(jit_state::None, std::memory_order_release);
+            throw;
+        }
+        if (ok) {
+            for (bc_code * c : codes) {
+                name const & fn = decl_fun_id(c->m_decl);
+                std::string mangled = name_mangle(fn, *g_mangle_prefix).to_std_string();
+                fns.push_back(jit_function { fn, mangled });
+                // as in `lookup_symbol`, prefer the boxed version
+                name boxed = fn + *g_boxed_suffix;
+                if (find_ir_decl(m_env, boxed)) {
+                    fns.push_back(jit_function { boxed, mangled + g_boxed_mangled_suffix->to_std_string() });
+                    syms.push_back(mk_pair(fns.size() - 1, true));
+                } else {
+                    syms.push_back(mk_pair(fns.size() - 1, false));
+                }
+            }
+            ok = jit_compile(m_shared_cache->jit(), m_env, fns, consts, addrs, error);
+        }
+        if (ok) {
+            lean_trace(name({"interpreter", "jit"}),
+                       tout() << "compiled " << decl_fun_id(root.m_decl) << " (" << fns.size() << " functions)\n";);
+            for (unsigned i = 0; i < codes.size(); i++) {
+                symbol_cache_entry e { codes[i]->m_decl, addrs[syms[i].first], syms[i].second };
+                if (e.m_boxed) {
+                    // the unboxed version precedes the boxed version in `fns`
+                    e.m_unboxed_addr = addrs[syms[i].first - 1];
+                    e.m_trampoline = get_trampoline(e.m_decl);
+                }
+                codes[i]->m_jit_sym = e;
+                codes[i]->m_jit_state.store(jit_state::Compiled, std::memory_order_release);
+            }
+        } else {
+            if (!retry)
+                lean_trace(name({"interpreter", "jit"}),
+                           tout() << "failed to compile " << decl_fun_id(root.m_decl) << ": " << error << "\n";);
+            // the other functions might still be compiled on their own
+            for (unsigned i = 1; i < codes.size(); i++)
+                codes[i]->m_jit_state.store(jit_state::None, std::memory_order_release);
+            root.m_jit_state.store(retry ? jit_state::None : jit_state::Failed, std::memory_order_release);
+        }
+    }
+
+    /** \brief Call `fn` with `n` arguments, where `arg_i(i)` is the value of the `i`-th argument in the current frame.
+        If `fn` is interpreted, `code` is its bytecode, or `nullptr` if its IR should be interpreted directly. */
+    template<class F>
+    value call_core(name const & fn, symbol_cache_entry const & e, bc_code * code, size_t n, F const & arg_i) {
+        if (code && m_jit_threshold) {
+            if (symbol_cache_entry const * j = tier_up(*code))
+                return call_core(fn, *j, nullptr, n, arg_i);
+        }
         size_t old_size = m_arg_stack.size();
         value r;
-        symbol_cache_entry e = lookup_symbol(fn);
-        if (e.m_addr) {
-            object ** args2 = static_cast<object **>(LEAN_ALLOCA(args.size() * sizeof(object *))); // NOLINT
-            for (size_t i = 0; i < args.size(); i++) {
+        if (e.m_trampoline) {
+            // pass unboxed values, and borrowed parameters, as in the IR
+            value * args2 = static_cast<value *>(LEAN_ALLOCA(n * sizeof(value))); // NOLINT
+            for (size_t i = 0; i < n; i++) {
+                args2[i] = arg_i(i);
+            }
+            push_frame(e.m_decl, old_size, true);
+            r = e.m_trampoline(e.m_unboxed_addr, args2);
+        } else if (e.m_addr) {
+            object ** args2 = static_cast<object **>(LEAN_ALLOCA(n * sizeof(object *))); // NOLINT
+            for (size_t i = 0; i < n; i++) {
                 type t = param_type(decl_params(e.m_decl)[i]);
-                args2[i] = box_t(eval_arg(args[i]), t);
+                args2[i] = box_t(arg_i(i), t);
                 if (e.m_boxed && param_borrow(decl_params(e.m_decl)[i])) {
                     // NOTE: If we chose the boxed version where the IR chose the unboxed one, we need to manually increment
                     // originally borrowed parameters because the wrapper will decrement these after the call.
@@ -850,8 +2164,8 @@ private:
                     inc(args2[i]);
                 }
             }
-            push_frame(e.m_decl, old_size);
-            object * o = curry(e.m_addr, args.size(), args2);
+            push_frame(e.m_decl, old_size, true);
+            object * o = curry(e.m_addr, n, args2);
             type t = decl_type(e.m_decl);
             if (type_is_scalar(t)) {
                 lean_assert(e.m_boxed);
@@ -869,16 +2183,20 @@ private:
                                           << "' (symbols '" << boxed_mangled.data() << "' or '" << mangled.data() << "')");
             }
             // evaluate args in old stack frame
-            for (const auto & arg : args) {
-                m_arg_stack.push_back(eval_arg(arg));
+            for (size_t i = 0; i < n; i++) {
+                m_arg_stack.push_back(arg_i(i));
             }
             push_frame(e.m_decl, old_size);
-            r = eval_body(decl_fun_body(e.m_decl));
+            r = code ? eval_code(*code) : eval_body(decl_fun_body(e.m_decl));
         }
         pop_frame(r, decl_type(e.m_decl));
         return r;
     }
 
+    value call(name const & fn, array_ref<arg> const & args) {
+        return call_core(fn, lookup_symbol(fn), nullptr, args.size(), [&](size_t i) { return eval_arg(args[i]); });
+    }
+
     // closure stub
     object * stub_m(object ** args) {
         decl d(args[2]);
@@ -887,7 +2205,7 @@ private:
             m_arg_stack.push_back(args[3 + i]);
         }
         push_frame(d, old_size);
-        object * r = eval_body(decl_fun_body(d)).m_obj;
+        object * r = eval_decl(d).m_obj;
         pop_frame(r, type::TObject);
         return r;
     }
@@ -944,9 +2262,19 @@ private:
 public:
     explicit interpreter(environment const & env, options const & opts) : m_env(env), m_opts(opts) {
         m_prefer_native = opts.get_bool(*g_interpreter_prefer_native, LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE);
+        m_use_bytecode = opts.get_bool(*g_interpreter_bytecode, LEAN_DEFAULT_INTERPRETER_BYTECODE);
+        m_shared_cache = interpreter_shared_cache::get(env, m_prefer_native);
+        // the JIT only compiles bytecode, and relies on native code being used where available
+        m_jit_threshold = jit_supported() && m_use_bytecode && m_prefer_native ?
+            opts.get_unsigned(*g_interpreter_jit_threshold, LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD) : 0;
+        m_profile = opts.get_bool(*g_interpreter_profile, false);
+        if (m_profile)
+            m_profile_tree.push_back(profile_node { 0, name(), second_duration(0), {} });
     }
 
     ~interpreter() {
+        if (m_profile)
+            report_profile();
         for_each(m_constant_cache, [](name const &, constant_cache_entry const & e) {
             if (!e.m_is_scalar) {
                 dec(e.m_val.m_obj);
@@ -1110,7 +2438,23 @@ void initialize_ir_interpreter() {
     mark_persistent(ir::g_boxed_mangled_suffix->raw());
     ir::g_interpreter_prefer_native = new name({"interpreter", "prefer_native"});
     ir::g_init_globals = new name_map<object *>();
+    ir::g_interpreter_shared_caches_mutex = new mutex();
+    ir::g_profile_mutex = new mutex();
+    ir::g_profile = new std::unordered_map<std::string, ir::profile_entry>();
+    ir::g_profile_folded = new std::map<std::string, second_duration>();
+    ir::g_profile_folded_file = new std::string();
+    ir::g_interpreter_profile = new name({"interpreter", "profile"});
+    register_bool_option(*ir::g_interpreter_profile, false, "(interpreter) count calls, allocations and time spent in each function called by interpreted code; the report is displayed at exit");
+    ir::g_interpreter_profile_folded = new name({"interpreter", "profile", "folded"});
+    register_option(*ir::g_interpreter_profile_folded, {}, data_value_kind::String, "", "(interpreter) if `interpreter.profile` is set, file to write the time spent in each call stack to, in the folded format of flame graph tools");
+    ir::g_interpreter_shared_caches = new std::vector<ir::interpreter_shared_cache_entry>();
+    register_compacted_region_free_fn(ir::clear_interpreter_shared_caches);
     register_bool_option(*ir::g_interpreter_prefer_native, LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE, "(interpreter) whether to use precompiled code where available");
+    ir::g_interpreter_bytecode = new name({"interpreter", "bytecode"});
+    register_bool_option(*ir::g_interpreter_bytecode, LEAN_DEFAULT_INTERPRETER_BYTECODE, "(interpreter) whether to lower IR to bytecode before interpreting it (`false`: interpret IR directly, e.g. for `trace.interpreter.step`)");
+    ir::g_interpreter_jit_threshold = new name({"interpreter", "jit", "threshold"});
+    register_unsigned_option(*ir::g_interpreter_jit_threshold, LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD, "(interpreter) number of interpreted calls of an imported function after which it is compiled to native code using LLVM (0: never); only supported if Lean was built with `LLVM=ON`");
+    register_trace_class({"interpreter", "jit"});
     DEBUG_CODE({
         register_trace_class({"interpreter"});
         register_trace_class({"interpreter", "call"});
@@ -1119,7 +2463,17 @@ void initialize_ir_interpreter() {
 }
 
 void finalize_ir_interpreter() {
+    delete ir::g_interpreter_profile_folded;
+    delete ir::g_interpreter_profile;
+    delete ir::g_profile_folded_file;
+    delete ir::g_profile_folded;
+    delete ir::g_profile;
+    delete ir::g_profile_mutex;
+    delete ir::g_interpreter_shared_caches;
+    delete ir::g_interpreter_shared_caches_mutex;
     delete ir::g_init_globals;
+    delete ir::g_interpreter_jit_threshold;
+    delete ir::g_interpreter_bytecode;
     delete ir::g_interpreter_prefer_native;
     delete ir::g_boxed_mangled_suffix;
     delete ir::g_boxed_suffix;
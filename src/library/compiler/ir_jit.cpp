@@ -0,0 +1,220 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#include <string>
+#include <unordered_set>
+#include <atomic>
+#include "runtime/thread.h"
+#include "runtime/array_ref.h"
+#include "util/io.h"
+#include "library/compiler/ir_jit.h"
+
+#ifdef LEAN_LLVM
+#include "llvm-c/BitReader.h"
+#include "llvm-c/BitWriter.h"
+#include "llvm-c/Core.h"
+#include "llvm-c/Error.h"
+#include "llvm-c/LLJIT.h"
+#include "llvm-c/Orc.h"
+#include "llvm-c/Target.h"
+#endif
+
+namespace lean {
+namespace ir {
+static std::atomic<unsigned> g_next_jit_library{0};
+
+jit_library::jit_library():
+    m_prefix("_lean_jit" + std::to_string(g_next_jit_library++) + "_") {}
+
+uint64 * jit_library::mk_global() {
+    lock_guard<mutex> _(m_globals_mutex);
+    m_globals.emplace_back(new uint64(0));
+    return m_globals.back().get();
+}
+
+object * jit_library::mk_persistent(object * o) {
+    object_compactor c;
+    c(o);
+    compacted_region * r = new compacted_region(c);
+    {
+        lock_guard<mutex> _(m_globals_mutex);
+        m_regions.emplace_back(r);
+    }
+    return r->read();
+}
+
+#ifdef LEAN_LLVM
+extern "C" object * lean_ir_emit_llvm_jit(object * env, object * fns, object * w);
+
+static mutex * g_jit_mutex = nullptr;
+// created on first use; the code of all libraries is added to its main `JITDylib`
+static LLVMOrcLLJITRef g_jit = nullptr;
+
+static bool check(LLVMErrorRef err, std::string & error) {
+    if (!err)
+        return true;
+    char * msg = LLVMGetErrorMessage(err);
+    error = msg;
+    LLVMDisposeErrorMessage(msg);
+    return false;
+}
+
+static bool init_jit(std::string & error) {
+    if (g_jit)
+        return true;
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+    LLVMOrcLLJITRef jit;
+    if (!check(LLVMOrcCreateLLJIT(&jit, nullptr), error))
+        return false;
+    // the runtime and all functions with native code are resolved using the symbols of the current process,
+    // like `lookup_symbol_in_cur_exe` does
+    LLVMOrcDefinitionGeneratorRef gen;
+    if (!check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&gen, LLVMOrcLLJITGetGlobalPrefix(jit), nullptr, nullptr), error)) {
+        LLVMConsumeError(LLVMOrcDisposeLLJIT(jit));
+        return false;
+    }
+    LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(jit), gen);
+    g_jit = jit;
+    return true;
+}
+
+/** \brief Prepend `prefix` to the names of the functions and global variables of `mod` in `syms`. */
+static void add_prefix(LLVMModuleRef mod, std::string const & prefix, std::unordered_set<std::string> const & syms) {
+    auto rename = [&](LLVMValueRef v) {
+        size_t len;
+        char const * n = LLVMGetValueName2(v, &len);
+        std::string sym(n, len);
+        if (syms.count(sym)) {
+            sym = prefix + sym;
+            LLVMSetValueName2(v, sym.c_str(), sym.size());
+        }
+    };
+    for (LLVMValueRef f = LLVMGetFirstFunction(mod); f; f = LLVMGetNextFunction(f))
+        rename(f);
+    for (LLVMValueRef g = LLVMGetFirstGlobal(mod); g; g = LLVMGetNextGlobal(g))
+        rename(g);
+}
+
+/** \brief Emit the LLVM module for `fns` into `ctx`. */
+static bool emit_module(environment const & env, buffer<jit_function> const & fns, LLVMContextRef ctx, LLVMModuleRef & mod,
+                        std::string & error) {
+    buffer<name> names;
+    for (jit_function const & f : fns)
+        names.push_back(f.m_fn);
+    LLVMContextRef emit_ctx;
+    LLVMModuleRef emit_mod;
+    try {
+        object_ref r = get_io_result<object_ref>(lean_ir_emit_llvm_jit(env.to_obj_arg(), array_ref<name>(names).steal(), io_mk_world()));
+        emit_ctx = reinterpret_cast<LLVMContextRef>(lean_unbox_usize(cnstr_get(r.raw(), 0)));
+        emit_mod = reinterpret_cast<LLVMModuleRef>(lean_unbox_usize(cnstr_get(r.raw(), 1)));
+    } catch (exception & ex) {
+        error = ex.what();
+        return false;
+    }
+    // `EmitLLVM` creates its own context, so we move the module to the context of the JIT using bitcode
+    LLVMMemoryBufferRef buf = LLVMWriteBitcodeToMemoryBuffer(emit_mod);
+    LLVMDisposeModule(emit_mod);
+    LLVMContextDispose(emit_ctx);
+    bool failed = LLVMParseBitcodeInContext2(ctx, buf, &mod);
+    LLVMDisposeMemoryBuffer(buf);
+    if (failed) {
+        error = "failed to read the bitcode emitted by EmitLLVM";
+        return false;
+    }
+    return true;
+}
+
+bool jit_supported() { return true; }
+
+bool jit_compile(jit_library & lib, environment const & env, buffer<jit_function> const & fns,
+                 buffer<jit_constant> const & consts, buffer<void *> & addrs, std::string & error) {
+    lock_guard<mutex> _(*g_jit_mutex);
+    if (!init_jit(error))
+        return false;
+    LLVMOrcJITDylibRef jd = LLVMOrcLLJITGetMainJITDylib(g_jit);
+
+    buffer<LLVMJITCSymbolMapPair> new_consts;
+    for (jit_constant const & c : consts) {
+        if (lib.m_symbols.count(c.m_sym))
+            continue;
+        LLVMJITEvaluatedSymbol sym;
+        sym.Address = reinterpret_cast<LLVMOrcExecutorAddress>(c.m_addr);
+        sym.Flags.GenericFlags = LLVMJITSymbolGenericFlagsExported;
+        sym.Flags.TargetFlags = 0;
+        std::string prefixed = lib.m_prefix + c.m_sym;
+        new_consts.push_back(LLVMJITCSymbolMapPair { LLVMOrcLLJITMangleAndIntern(g_jit, prefixed.c_str()), sym });
+    }
+    if (!new_consts.empty()) {
+        LLVMOrcMaterializationUnitRef mu = LLVMOrcAbsoluteSymbols(new_consts.data(), new_consts.size());
+        if (!check(LLVMOrcJITDylibDefine(jd, mu), error)) {
+            LLVMOrcDisposeMaterializationUnit(mu);
+            return false;
+        }
+        for (jit_constant const & c : consts)
+            lib.m_symbols.insert(c.m_sym);
+    }
+
+    buffer<jit_function> new_fns;
+    for (jit_function const & f : fns) {
+        if (!lib.m_symbols.count(f.m_sym))
+            new_fns.push_back(f);
+    }
+    if (!new_fns.empty()) {
+        LLVMOrcThreadSafeContextRef tsc = LLVMOrcCreateNewThreadSafeContext();
+        LLVMModuleRef mod;
+        if (!emit_module(env, new_fns, LLVMOrcThreadSafeContextGetContext(tsc), mod, error)) {
+            LLVMOrcDisposeThreadSafeContext(tsc);
+            return false;
+        }
+        // `EmitLLVM` refers to the functions and constants of the library by their unprefixed symbols, all other
+        // symbols are resolved in the current process
+        std::unordered_set<std::string> syms(lib.m_symbols);
+        for (jit_function const & f : new_fns)
+            syms.insert(f.m_sym);
+        add_prefix(mod, lib.m_prefix, syms);
+        LLVMOrcThreadSafeModuleRef tsm = LLVMOrcCreateNewThreadSafeModule(mod, tsc);
+        // the module keeps the context alive
+        LLVMOrcDisposeThreadSafeContext(tsc);
+        // takes ownership of `tsm`, even on failure
+        if (!check(LLVMOrcLLJITAddLLVMIRModule(g_jit, jd, tsm), error))
+            return false;
+        for (jit_function const & f : new_fns)
+            lib.m_symbols.insert(f.m_sym);
+    }
+
+    // the module is compiled by the first lookup
+    for (jit_function const & f : fns) {
+        LLVMOrcExecutorAddress addr;
+        if (!check(LLVMOrcLLJITLookup(g_jit, &addr, (lib.m_prefix + f.m_sym).c_str()), error))
+            return false;
+        addrs.push_back(reinterpret_cast<void *>(addr));
+    }
+    return true;
+}
+#else
+bool jit_supported() { return false; }
+
+bool jit_compile(jit_library &, environment const &, buffer<jit_function> const &, buffer<jit_constant> const &,
+                 buffer<void *> &, std::string & error) {
+    error = "Lean was built without LLVM support";
+    return false;
+}
+#endif
+}
+
+void initialize_ir_jit() {
+#ifdef LEAN_LLVM
+    ir::g_jit_mutex = new mutex();
+#endif
+}
+
+void finalize_ir_jit() {
+#ifdef LEAN_LLVM
+    if (ir::g_jit)
+        LLVMConsumeError(LLVMOrcDisposeLLJIT(ir::g_jit));
+    delete ir::g_jit_mutex;
+#endif
+}
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+#include "runtime/thread.h"
+#include "runtime/compact.h"
+#include "library/compiler/ir.h"
+
+namespace lean {
+namespace ir {
+/** \brief IR function to be compiled by \c jit_compile, and the (unmangled) symbol of its native code. */
+struct jit_function {
+    name        m_fn;
+    std::string m_sym;
+};
+
+/** \brief Value of a constant used by functions compiled by \c jit_compile. \c m_addr is the address of the
+    global variable holding the value; the value must be persistent. */
+struct jit_constant {
+    std::string m_sym;
+    void *      m_addr;
+};
+
+/** \brief Set of functions and constants compiled by \c jit_compile. The symbols of different libraries are
+    independent, so that the same function can be compiled separately for environments with different imports.
+
+    The library owns the global variables holding the values of its constants, see \c mk_global, so its native code
+    must not be run after it has been destroyed. */
+class jit_library {
+    // prepended to the symbols of the library in the JIT
+    std::string                                    m_prefix;
+    // symbols of the functions and constants that have been added to the JIT, protected by the JIT's mutex
+    std::unordered_set<std::string>                m_symbols;
+    mutex                                          m_globals_mutex;
+    // global variables created by `mk_global`, and the regions holding the objects stored in them
+    std::vector<std::unique_ptr<uint64>>           m_globals;
+    std::vector<std::unique_ptr<compacted_region>> m_regions;
+    friend bool jit_compile(jit_library & lib, environment const & env, buffer<jit_function> const & fns,
+                            buffer<jit_constant> const & consts, buffer<void *> & addrs, std::string & error);
+public:
+    jit_library();
+    jit_library(jit_library const &) = delete;
+    jit_library & operator=(jit_library const &) = delete;
+
+    /** \brief Return a new zero-initialized global variable, large enough for any scalar or object value. It is
+        freed with the library. */
+    uint64 * mk_global();
+    /** \brief Return a persistent copy of the non-scalar object \c o, as expected by native code for the values of
+        constants. The copy is stored in a compacted region that is freed with the library. */
+    object * mk_persistent(object * o);
+};
+
+/** \brief Return true iff IR functions can be compiled just in time, i.e., Lean was built with `LLVM=ON`. */
+bool jit_supported();
+
+/** \brief Compile the IR functions \c fns of \c env to native code using `EmitLLVM` and an in-process LLVM ORC JIT,
+    and store the address of the native code of each function in \c addrs.
+
+    Within \c lib, functions and constants are identified by their symbols: entries of \c fns and \c consts that
+    have already been compiled or defined by a previous call for \c lib are not compiled again. All other functions
+    and constants used by \c fns must be in \c fns or \c consts, or have native code in the current process. Return
+    false and set \c error if the functions could not be compiled. */
+bool jit_compile(jit_library & lib, environment const & env, buffer<jit_function> const & fns,
+                 buffer<jit_constant> const & consts, buffer<void *> & addrs, std::string & error);
+}
+void initialize_ir_jit();
+void finalize_ir_jit();
+}
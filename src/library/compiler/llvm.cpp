@@ -233,6 +233,18 @@ extern "C" LEAN_EXPORT lean_object *lean_llvm_create_context(
 #endif  // LEAN_LLVM
 };
 
+extern "C" LEAN_EXPORT lean_object *lean_llvm_dispose_context(
+    size_t ctx, lean_object * /* w */) {
+#ifndef LEAN_LLVM
+    lean_always_assert(
+        false && ("Please build a version of Lean4 with -DLLVM=ON to invoke "
+                  "the LLVM backend function."));
+#else
+    LLVMContextDispose(lean_to_Context(ctx));
+    return lean_io_result_mk_ok(lean_box(0));
+#endif  // LEAN_LLVM
+}
+
 extern "C" LEAN_EXPORT lean_object *lean_llvm_create_module(
     size_t ctx, lean_object *str, lean_object * /* w */) {
 #ifndef LEAN_LLVM
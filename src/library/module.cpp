@@ -44,17 +44,55 @@ namespace lean {
 // manually padded to multiple of word size, see `initialize_module`
 static char const * g_olean_header   = "oleanfile!!!!!!!";
 
-extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, object *) {
+/*
+  An .olean file consists of
+  - the header string `g_olean_header`,
+  - the base address used for `mmap`ing the file,
+  - the compacted region. */
+static size_t olean_header_size() {
+    return strlen(g_olean_header) + sizeof(size_t);
+}
+
+/* Read the header of an .olean file. Return `false` if the header is not valid. */
+static bool read_olean_header(std::ifstream & in, size_t & base_addr) {
+    std::string header(strlen(g_olean_header), '\0');
+    in.read(&header[0], header.size());
+    if (!in || header != g_olean_header)
+        return false;
+    in.read(reinterpret_cast<char *>(&base_addr), sizeof(base_addr));
+    return static_cast<bool>(in);
+}
+
+/* Return `true` if `olean_fn` already contains a compacted region equal to `data` with the given base address. */
+static bool is_olean_up_to_date(std::string const & olean_fn, size_t base_addr, char const * data, size_t sz) {
+    std::ifstream in(olean_fn, std::ios_base::binary);
+    if (in.fail())
+        return false;
+    in.seekg(0, in.end);
+    if (static_cast<size_t>(in.tellg()) != olean_header_size() + sz)
+        return false;
+    in.seekg(0);
+    size_t file_base_addr;
+    if (!read_olean_header(in, file_base_addr) || file_base_addr != base_addr)
+        return false;
+    char buffer[1 << 16];
+    while (sz > 0) {
+        size_t n = std::min(sz, sizeof(buffer));
+        in.read(buffer, n);
+        if (!in || memcmp(buffer, data, n) != 0)
+            return false;
+        data += n;
+        sz   -= n;
+    }
+    return true;
+}
+
+extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, uint8 keep_unchanged, object *) {
     std::string olean_fn(string_cstr(fname));
     // we first write to a temp file and then move it to the correct path (possibly deleting an older file)
     // so that we neither expose partially-written files nor modify possibly memory-mapped files
     std::string olean_tmp_fn = olean_fn + ".tmp";
     try {
-        std::ofstream out(olean_tmp_fn, std::ios_base::binary);
-        if (out.fail()) {
-            return io_result_mk_error((sstream() << "failed to create file '" << olean_fn << "'").str());
-        }
-
         // Derive a base address that is uniformly distributed by deterministic, and should most likely
         // work for `mmap` on all interesting platforms
         // NOTE: an overlapping/non-compatible base address does not prevent the module from being imported,
@@ -73,8 +111,18 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
         // `MapViewOfFileEx` addresses must be aligned to the "memory allocation granularity", which is 64KB.
         base_addr = base_addr & ~((1LL<<16) - 1);
 
-        object_compactor compactor(reinterpret_cast<void *>(base_addr + strlen(g_olean_header) + sizeof(base_addr)));
+        object_compactor compactor(reinterpret_cast<void *>(base_addr + olean_header_size()));
         compactor(mdata);
+        // If requested, do not touch an existing file with the same content, so that its modification time is
+        // preserved and build systems comparing contents do not needlessly reconsider the modules depending on it.
+        // Build systems comparing modification times must not request it, see `saveModuleData`.
+        if (keep_unchanged && is_olean_up_to_date(olean_fn, base_addr, static_cast<char const *>(compactor.data()), compactor.size()))
+            return io_result_mk_ok(box(0));
+
+        std::ofstream out(olean_tmp_fn, std::ios_base::binary);
+        if (out.fail()) {
+            return io_result_mk_error((sstream() << "failed to create file '" << olean_fn << "'").str());
+        }
         out.write(g_olean_header, strlen(g_olean_header));
         out.write(reinterpret_cast<char *>(&base_addr), sizeof(base_addr));
         out.write(static_cast<char const *>(compactor.data()), compactor.size());
@@ -105,6 +153,65 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
     }
 }
 
+/*
+  Prefetch policy for memory-mapped .olean files, set using the environment variable `LEAN_OLEAN_PREFETCH`.
+  Without prefetching, the first traversal of the imported data takes page faults all over the mapped
+  files in random order, which is slow on a cold page cache.
+  - `none` (default): rely on the OS fault-around and readahead heuristics.
+  - `populate`: map files with `MAP_POPULATE`, reading them eagerly at `mmap` time.
+  - `willneed`: use `madvise(MADV_WILLNEED)` to request asynchronous readahead of each mapped file.
+  - `background`: after all imported files have been mapped, request readahead on a background thread,
+    in the order in which `finalizeImport` processes them (i.e., dependencies first). */
+enum class olean_prefetch { none, populate, willneed, background };
+
+static olean_prefetch get_olean_prefetch() {
+    static olean_prefetch g_policy = []() {
+        char const * v = std::getenv("LEAN_OLEAN_PREFETCH");
+        if (!v) return olean_prefetch::none;
+        if (strcmp(v, "populate") == 0) return olean_prefetch::populate;
+        if (strcmp(v, "willneed") == 0) return olean_prefetch::willneed;
+        if (strcmp(v, "background") == 0) return olean_prefetch::background;
+        return olean_prefetch::none;
+    }();
+    return g_policy;
+}
+
+#if !defined(LEAN_WINDOWS) && defined(LEAN_MMAP)
+/* Return the page-aligned range containing the data of a memory-mapped region. Recall that the region
+   starts after the .olean header, at an offset of the page-aligned base address. */
+static std::pair<char *, size_t> get_mapped_range(compacted_region const * region) {
+    size_t page_sz = sysconf(_SC_PAGESIZE);
+    char * begin   = static_cast<char *>(const_cast<void *>(region->data()));
+    char * end     = begin + region->size();
+    char * aligned = reinterpret_cast<char *>(reinterpret_cast<size_t>(begin) & ~(page_sz - 1));
+    return mk_pair(aligned, static_cast<size_t>(end - aligned));
+}
+#endif
+
+/*
+@[extern "lean_prefetch_module_regions"]
+opaque prefetchModuleRegions (regions : @& Array CompactedRegion) : IO Unit */
+extern "C" LEAN_EXPORT object * lean_prefetch_module_regions(b_obj_arg regions, object *) {
+#if !defined(LEAN_WINDOWS) && defined(LEAN_MMAP) && defined(LEAN_MULTI_THREAD)
+    if (get_olean_prefetch() != olean_prefetch::background)
+        return io_result_mk_ok(box(0));
+    std::vector<std::pair<char *, size_t>> ranges;
+    for (size_t i = 0; i < array_size(regions); i++) {
+        compacted_region const * region = reinterpret_cast<compacted_region *>(unbox_size_t(array_get(regions, i)));
+        if (region->is_memory_mapped())
+            ranges.push_back(get_mapped_range(region));
+    }
+    // `MADV_WILLNEED` is only a hint, so it is harmless if a region is freed while the thread is running
+    std::thread([=]() {
+            for (auto const & r : ranges)
+                madvise(r.first, r.second, MADV_WILLNEED);
+        }).detach();
+#else
+    static_cast<void>(regions);
+#endif
+    return io_result_mk_ok(box(0));
+}
+
 extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *) {
     std::string olean_fn(string_cstr(fname));
     try {
@@ -116,19 +223,12 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
         in.seekg(0, in.end);
         size_t size = in.tellg();
         in.seekg(0);
-        size_t header_size = strlen(g_olean_header);
-        if (size < header_size) {
+        size_t header_size = olean_header_size();
+        size_t file_base_addr;
+        if (size < header_size || !read_olean_header(in, file_base_addr)) {
             return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
         }
-        char * header = new char[header_size];
-        in.read(header, header_size);
-        if (strncmp(header, g_olean_header, header_size) != 0) {
-            return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
-        }
-        delete[] header;
-        char * base_addr;
-        in.read(reinterpret_cast<char *>(&base_addr), sizeof(base_addr));
-        header_size += sizeof(base_addr);
+        char * base_addr = reinterpret_cast<char *>(file_base_addr);
         char * buffer = nullptr;
         bool is_mmap = false;
         std::function<void()> free_data;
@@ -156,7 +256,12 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
             return io_result_mk_error((sstream() << "failed to open '" << olean_fn << "': " << strerror(errno)).str());
         }
 #ifdef LEAN_MMAP
-        buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (get_olean_prefetch() == olean_prefetch::populate)
+            flags |= MAP_POPULATE;
+#endif
+        buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, flags, fd, 0));
 #endif
         close(fd);
         free_data = [=]() {
@@ -166,6 +271,10 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
         };
 #endif
         if (buffer && buffer == base_addr) {
+#if !defined(LEAN_WINDOWS) && defined(LEAN_MMAP)
+            if (get_olean_prefetch() == olean_prefetch::willneed)
+                madvise(buffer, size, MADV_WILLNEED);
+#endif
             buffer += header_size;
             is_mmap = true;
         } else {
@@ -201,11 +310,11 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
 }
 
 /*
-@[export lean.write_module_core]
-def writeModule (env : Environment) (fname : String) : IO Unit := */
-extern "C" object * lean_write_module(object * env, object * fname, object *);
+@[export lean_write_module]
+def writeModule (env : Environment) (fname : System.FilePath) (keepUnchanged := false) : IO Unit := */
+extern "C" object * lean_write_module(object * env, object * fname, uint8 keep_unchanged, object *);
 
-void write_module(environment const & env, std::string const & olean_fn) {
-    consume_io_result(lean_write_module(env.to_obj_arg(), mk_string(olean_fn), io_mk_world()));
+void write_module(environment const & env, std::string const & olean_fn, bool keep_unchanged) {
+    consume_io_result(lean_write_module(env.to_obj_arg(), mk_string(olean_fn), keep_unchanged, io_mk_world()));
 }
 }
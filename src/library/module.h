@@ -13,6 +13,7 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 #include "kernel/environment.h"
 
 namespace lean {
-/** \brief Store module using \c env. */
-void write_module(environment const & env, std::string const & olean_fn);
+/** \brief Store module using \c env. If \c keep_unchanged is true, an existing file with the same contents is not
+    rewritten, see `saveModuleData`. */
+void write_module(environment const & env, std::string const & olean_fn, bool keep_unchanged = false);
 }
@@ -477,6 +477,15 @@ extern "C" LEAN_EXPORT void lean_inc_heartbeat() {
 #endif
 }
 
+void add_num_heartbeats(uint64_t n) {
+#ifdef LEAN_SMALL_ALLOCATOR
+    if (g_heap)
+        g_heap->m_heartbeat += n;
+#else
+    g_heartbeat += n;
+#endif
+}
+
 uint64_t get_num_heartbeats() {
 #ifdef LEAN_SMALL_ALLOCATOR
     if (g_heap)
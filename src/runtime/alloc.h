@@ -13,6 +13,8 @@ void init_thread_heap();
 void * alloc(size_t sz);
 void dealloc(void * o, size_t sz);
 uint64_t get_num_heartbeats();
+/* Add `n` to the heartbeats of the current thread, e.g., for allocations done on its behalf by other threads. */
+void add_num_heartbeats(uint64_t n);
 void initialize_alloc();
 void finalize_alloc();
 }
@@ -4,8 +4,8 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
-#include <unordered_set>
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <cstring>
@@ -18,46 +18,79 @@ Author: Leonardo de Moura
 #endif
 
 #define LEAN_COMPACTOR_INIT_SZ 1024*1024
-#define LEAN_MAX_SHARING_TABLE_INITIAL_SIZE 1024*1024
+#define LEAN_MAX_SHARING_TABLE_MIN_CAPACITY 1024
+// Used to estimate the number of objects in a compacted region of a given size.
+#define LEAN_MAX_SHARING_AVG_OBJECT_SZ 32
 
 // uncomment to track the number of each kind of object in an .olean file
 // #define LEAN_TAG_COUNTERS
 
 namespace lean {
 
-struct max_sharing_key {
-    size_t m_offset;
-    size_t m_size;
-    max_sharing_key(size_t offset, size_t sz):m_offset(offset), m_size(sz) {}
-};
-
-struct max_sharing_hash {
-    object_compactor * m;
-    max_sharing_hash(object_compactor * manager):m(manager) {}
-    unsigned operator()(max_sharing_key const & k) const {
-        return hash_str(k.m_size, reinterpret_cast<unsigned char const *>(m->m_begin) + k.m_offset, 17);
+/* Flat open-addressing table (linear probing) of the objects already in the compacted region, used to
+   maximize sharing. Each slot stores the 64-bit hash of the object bytes next to its offset and size,
+   so that probing rarely touches the region and growing the table never rehashes object contents. */
+struct object_compactor::max_sharing_table {
+    struct entry {
+        uint64 m_hash;
+        size_t m_offset;
+        size_t m_size; // 0 for empty slots, compacted objects are never empty
+    };
+    std::vector<entry> m_entries;
+    size_t             m_num_entries = 0;
+
+    static size_t capacity_for(size_t num_objs) {
+        size_t r = LEAN_MAX_SHARING_TABLE_MIN_CAPACITY;
+        while (r < 2 * num_objs)
+            r *= 2;
+        return r;
     }
-};
 
-struct max_sharing_eq {
-    object_compactor * m;
-    max_sharing_eq(object_compactor * manager):m(manager) {}
-    bool operator()(max_sharing_key const & k1, max_sharing_key const & k2) const {
-        if (k1.m_size != k2.m_size) return false;
-        return memcmp(reinterpret_cast<char*>(m->m_begin) + k1.m_offset, reinterpret_cast<char*>(m->m_begin) + k2.m_offset, k1.m_size) == 0;
+    size_t find_empty(uint64 h) const {
+        size_t mask = m_entries.size() - 1;
+        size_t i    = h & mask;
+        while (m_entries[i].m_size != 0)
+            i = (i + 1) & mask;
+        return i;
     }
-};
 
+    explicit max_sharing_table(size_t num_objs):m_entries(capacity_for(num_objs)) {}
+
+    /* Make sure the table can store `num_objs` objects with a load factor of at most 1/2. */
+    void reserve(size_t num_objs) {
+        size_t new_capacity = capacity_for(num_objs);
+        if (new_capacity <= m_entries.size())
+            return;
+        std::vector<entry> old_entries(new_capacity);
+        old_entries.swap(m_entries);
+        for (entry const & e : old_entries) {
+            if (e.m_size != 0)
+                m_entries[find_empty(e.m_hash)] = e;
+        }
+    }
 
-struct object_compactor::max_sharing_table {
-    std::unordered_set<max_sharing_key, max_sharing_hash, max_sharing_eq> m_table;
-    max_sharing_table(object_compactor * manager):
-        m_table(LEAN_MAX_SHARING_TABLE_INITIAL_SIZE, max_sharing_hash(manager), max_sharing_eq(manager)) {
+    /* If the table contains an object with the same `sz` bytes as the object at `begin + offset`,
+       return its offset. Otherwise, insert the new object and return `offset`. */
+    size_t find_or_insert(char const * begin, size_t offset, size_t sz) {
+        uint64 h    = hash_str(sz, reinterpret_cast<unsigned char const *>(begin) + offset, 17);
+        size_t mask = m_entries.size() - 1;
+        size_t i    = h & mask;
+        while (m_entries[i].m_size != 0) {
+            entry const & e = m_entries[i];
+            if (e.m_hash == h && e.m_size == sz && memcmp(begin + e.m_offset, begin + offset, sz) == 0)
+                return e.m_offset;
+            i = (i + 1) & mask;
+        }
+        m_entries[i] = entry{h, offset, sz};
+        m_num_entries++;
+        if (2 * m_num_entries > m_entries.size())
+            reserve(m_num_entries);
+        return offset;
     }
 };
 
 object_compactor::object_compactor(void * base_addr):
-    m_max_sharing_table(new max_sharing_table(this)),
+    m_max_sharing_table(new max_sharing_table(LEAN_COMPACTOR_INIT_SZ / LEAN_MAX_SHARING_AVG_OBJECT_SZ)),
     m_base_addr(base_addr),
     m_begin(malloc(LEAN_COMPACTOR_INIT_SZ)),
     m_end(m_begin),
@@ -87,6 +120,8 @@ void * object_compactor::alloc(size_t sz) {
         m_capacity = static_cast<char*>(new_begin) + new_capacity;
         free(m_begin);
         m_begin    = new_begin;
+        // grow the max sharing table together with the region instead of waiting for it to fill up
+        m_max_sharing_table->reserve(new_capacity / LEAN_MAX_SHARING_AVG_OBJECT_SZ);
     }
     void * r = m_end;
     memset(r, 0, sz);
@@ -101,13 +136,11 @@ void object_compactor::save(object * o, object * new_o) {
 }
 
 void object_compactor::save_max_sharing(object * o, object * new_o, size_t new_o_sz) {
-    max_sharing_key k(reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin), new_o_sz);
-    auto it = m_max_sharing_table->m_table.find(k);
-    if (it != m_max_sharing_table->m_table.end()) {
+    size_t offset = reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin);
+    size_t shared_offset = m_max_sharing_table->find_or_insert(static_cast<char const *>(m_begin), offset, new_o_sz);
+    if (shared_offset != offset) {
         m_end = new_o;
-        new_o = reinterpret_cast<lean_object*>(reinterpret_cast<char*>(m_begin) + it->m_offset);
-    } else {
-        m_max_sharing_table->m_table.insert(k);
+        new_o = reinterpret_cast<lean_object*>(reinterpret_cast<char*>(m_begin) + shared_offset);
     }
     save(o, new_o);
 }
@@ -367,13 +400,15 @@ compacted_region::compacted_region(size_t sz, void * data, void * base_addr, boo
     m_free_data(free_data),
     m_begin(data),
     m_next(data),
-    m_end(static_cast<char*>(data)+sz) {
+    m_end(static_cast<char*>(data)+sz),
+    m_size(sz) {
 }
 
 compacted_region::compacted_region(object_compactor const & c):
     m_begin(malloc(c.size())),
     m_next(m_begin),
-    m_end(static_cast<char*>(m_begin) + c.size()) {
+    m_end(static_cast<char*>(m_begin) + c.size()),
+    m_size(c.size()) {
     memcpy(m_begin, c.data(), c.size());
 }
 
@@ -484,7 +519,25 @@ extern "C" LEAN_EXPORT uint8 lean_compacted_region_is_memory_mapped(usize region
     return reinterpret_cast<compacted_region *>(region)->is_memory_mapped();
 }
 
+static std::vector<void (*)()> & get_compacted_region_free_fns() {
+    static std::vector<void (*)()> fns;
+    return fns;
+}
+
+static std::atomic<size_t> g_compacted_region_epoch{0};
+
+void register_compacted_region_free_fn(void (*fn)()) {
+    get_compacted_region_free_fns().push_back(fn);
+}
+
+size_t get_compacted_region_epoch() {
+    return g_compacted_region_epoch.load(std::memory_order_acquire);
+}
+
 extern "C" LEAN_EXPORT obj_res lean_compacted_region_free(usize region, object *) {
+    g_compacted_region_epoch.fetch_add(1, std::memory_order_acq_rel);
+    for (auto fn : get_compacted_region_free_fns())
+        fn();
     delete reinterpret_cast<compacted_region *>(region);
     return lean_io_result_mk_ok(lean_box(0));
 }
@@ -15,8 +15,6 @@ typedef lean_object * object_offset;
 
 class object_compactor {
     struct max_sharing_table;
-    friend struct max_sharing_hash;
-    friend struct max_sharing_eq;
     std::unordered_map<object*, object_offset, std::hash<object*>, std::equal_to<object*>> m_obj_table;
     std::unique_ptr<max_sharing_table> m_max_sharing_table;
     std::vector<object*> m_todo;
@@ -63,6 +61,7 @@ class compacted_region {
     void * m_begin;
     void * m_next;
     void * m_end;
+    size_t m_size;
     void move(size_t d);
     void move(object * o);
     object * fix_object_ptr(object * o);
@@ -86,5 +85,18 @@ public:
     compacted_region operator=(compacted_region &&) = delete;
     object * read();
     bool is_memory_mapped() const { return m_is_mmap; }
+    void const * data() const { return m_begin; }
+    size_t size() const { return m_size; }
 };
+
+/** \brief Register a function that is called by `lean_compacted_region_free` before freeing a region, in the thread
+    freeing it. Caches that may contain objects stored in compacted regions (e.g., imported declarations) must drop
+    these objects in this function, while they are still mapped. Must be called during initialization. */
+void register_compacted_region_free_fn(void (*fn)());
+
+/** \brief Number of compacted regions freed so far. The functions registered using
+    `register_compacted_region_free_fn` cannot clear the thread-local caches of other threads, so these caches must
+    check this number before using their entries. If it has changed, the entries may refer to unmapped memory, and
+    must be dropped without releasing them, i.e., they are leaked. */
+size_t get_compacted_region_epoch();
 }
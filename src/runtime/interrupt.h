@@ -17,6 +17,10 @@ void inc_heartbeat();
 
 /** \brief Reset thread local counter for approximating elapsed time. */
 void reset_heartbeat();
+/** \brief Return the thread local counter for approximating elapsed time. */
+size_t get_heartbeat();
+/** \brief Add \c n to the thread local counter, e.g., for work done on behalf of this thread by other threads. */
+void add_heartbeat(size_t n);
 
 /* Update the current heartbeat */
 class scope_heartbeat : flet<size_t> {
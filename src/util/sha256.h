@@ -0,0 +1,29 @@
+/*
+Copyright (c) 2026 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <array>
+#include <string>
+#include "runtime/int64.h"
+
+namespace lean {
+typedef std::array<unsigned char, 32> sha256_digest;
+
+/** \brief Incremental SHA-256 (FIPS 180-4). Used where a digest must be collision resistant, e.g.
+    for keys of persistent caches whose entries are trusted without rechecking. */
+class sha256 {
+    uint32_t      m_state[8];
+    unsigned char m_buffer[64];
+    uint64        m_length; // number of bytes consumed so far
+    void compress(unsigned char const * block);
+public:
+    sha256();
+    void update(void const * data, size_t sz);
+    /** \brief Return the digest of the bytes consumed so far. The object can still be updated afterwards. */
+    sha256_digest digest() const;
+};
+
+/** \brief Lowercase hexadecimal representation of `d` (64 characters). */
+std::string to_hex(sha256_digest const & d);
+}
@@ -36,6 +36,7 @@ Author: Leonardo de Moura
 #include "library/trace.h"
 #include "library/print.h"
 #include "initialize/init.h"
+#include "library/compiler/compiler.h"
 #include "library/compiler/ir_interpreter.h"
 #include "util/path.h"
 #include "stdlib_flags.h"
@@ -198,6 +199,8 @@ static void display_help(std::ostream & out) {
     std::cout << "  --o=oname -o       create olean file\n";
     std::cout << "  --i=iname -i       create ilean file\n";
     std::cout << "  --c=fname -c       name of the C output file\n";
+    std::cout << "  --keep-unchanged   do not rewrite .olean, .ilean and C output files whose contents did not change;\n"
+              << "                     only for build systems that compare contents rather than modification times\n";
     std::cout << "  --bc=fname -b      name of the LLVM bitcode file\n";
     std::cout << "  --target=target    target triple of object file produced by LLVM\n";
     std::cout << "  --stdin            take input from stdin\n";
@@ -229,7 +232,22 @@ static void display_help(std::ostream & out) {
     std::cout << "  -D name=value      set a configuration option (see set_option command)\n";
 }
 
+/* Return true iff the file `fn` exists and contains exactly `sz` bytes equal to `data`. */
+static bool has_file_contents(std::string const & fn, char const * data, size_t sz) {
+    std::ifstream in(fn, std::ios_base::binary);
+    if (in.fail())
+        return false;
+    in.seekg(0, in.end);
+    if (static_cast<size_t>(in.tellg()) != sz)
+        return false;
+    in.seekg(0);
+    std::string contents(sz, '\0');
+    in.read(&contents[0], sz);
+    return in && memcmp(contents.data(), data, sz) == 0;
+}
+
 static int print_prefix = 0;
+static int keep_unchanged = 0;
 static int print_libdir = 0;
 
 static struct option g_long_options[] = {
@@ -263,6 +281,7 @@ static struct option g_long_options[] = {
     {"plugin",       required_argument, 0, 'p'},
     {"load-dynlib",  required_argument, 0, 'l'},
     {"print-prefix", no_argument,       &print_prefix, 1},
+    {"keep-unchanged", no_argument,     &keep_unchanged, 1},
     {"print-libdir", no_argument,       &print_libdir, 1},
 #ifdef LEAN_DEBUG
     {"debug",        required_argument, 0, 'B'},
@@ -348,6 +367,7 @@ extern "C" object * lean_run_frontend(
     object * main_module_name,
     uint32_t trust_level,
     object * ilean_filename,
+    uint8_t keep_unchanged_outputs,
     object * w
 );
 pair_ref<environment, object_ref> run_new_frontend(
@@ -355,7 +375,8 @@ pair_ref<environment, object_ref> run_new_frontend(
     options const & opts, std::string const & file_name,
     name const & main_module_name,
     uint32_t trust_level,
-    optional<std::string> const & ilean_file_name
+    optional<std::string> const & ilean_file_name,
+    bool keep_unchanged_outputs = false
 ) {
     object * oilean_file_name = mk_option_none();
     if (ilean_file_name) {
@@ -368,6 +389,7 @@ pair_ref<environment, object_ref> run_new_frontend(
         main_module_name.to_obj_arg(),
         trust_level,
         oilean_file_name,
+        keep_unchanged_outputs,
         io_mk_world()
     ));
 }
@@ -723,7 +745,7 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
 
         if (!main_module_name)
             main_module_name = name("_stdin");
-        pair_ref<environment, object_ref> r = run_new_frontend(contents, opts, mod_fn, *main_module_name, trust_lvl, ilean_fn);
+        pair_ref<environment, object_ref> r = run_new_frontend(contents, opts, mod_fn, *main_module_name, trust_lvl, ilean_fn, keep_unchanged);
         env = r.fst();
         bool ok = unbox(r.snd().raw());
 
@@ -738,18 +760,22 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
         }
         if (olean_fn && ok) {
             time_task t(".olean serialization", opts);
-            write_module(env, *olean_fn);
+            write_module(env, *olean_fn, keep_unchanged);
         }
 
         if (c_output && ok) {
-            std::ofstream out(*c_output, std::ios_base::binary);
-            if (out.fail()) {
-                std::cerr << "failed to create '" << *c_output << "'\n";
-                return 1;
-            }
             time_task _("C code generation", opts);
-            out << lean::ir::emit_c(env, *main_module_name).data();
-            out.close();
+            string_ref c_code = lean::ir::emit_c(env, *main_module_name);
+            // like `.olean` files, do not touch an unchanged file if requested, see `saveModuleData`
+            if (!keep_unchanged || !has_file_contents(*c_output, c_code.data(), c_code.num_bytes())) {
+                std::ofstream out(*c_output, std::ios_base::binary);
+                if (out.fail()) {
+                    std::cerr << "failed to create '" << *c_output << "'\n";
+                    return 1;
+                }
+                out << c_code.data();
+                out.close();
+            }
         }
 
         // target triple is only used by the LLVM backend. Save users
@@ -774,6 +800,8 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
         }
 
         display_cumulative_profiling_times(std::cerr);
+        ir::display_interpreter_profile(std::cerr);
+        display_compiler_pass_stats(std::cerr);
 
 #ifdef LEAN_SMALL_ALLOCATOR
         // If the small allocator is not enabled, then we assume we are not using the sanitizer.
@@ -0,0 +1,29 @@
+/-!
+  `decide` proofs over fixed-width bit operations encoded with `Nat`, as produced by
+  bit-vector reasoning and hash computations. Without literal support for `Nat.land`,
+  `Nat.lor`, `Nat.xor`, `Nat.shiftLeft`, `Nat.shiftRight` and `Nat.log2`, both `whnf`
+  and the kernel have to unfold their definitions by well-founded recursion. -/
+
+-- `decide` evaluates the propositions using `whnf` first, which recurses deeply on them
+set_option maxRecDepth 100000
+
+def mask64 (x : Nat) : Nat := x &&& (2^64 - 1)
+
+def rotl64 (x k : Nat) : Nat := mask64 ((x <<< k) ||| (x >>> (64 - k)))
+
+/-- FNV-1a style hash of a list of bytes. -/
+def fnv1a (bs : List Nat) : Nat :=
+  bs.foldl (fun h b => mask64 ((h ^^^ b) * 0x100000001b3)) 0xcbf29ce484222325
+
+/-- A few rounds of a xorshift/rotate mixer. -/
+def mix : Nat → Nat → Nat
+  | 0,   x => x
+  | n+1, x => mix n (rotl64 (x ^^^ (x >>> 33)) 17 ^^^ (x <<< 5 &&& 0xffffffff))
+
+theorem fnv1a_eq : fnv1a ((List.range 64).map (· * 7 % 256)) = 0x336da95325f26025 := by decide
+
+theorem mix_eq : mix 200 1 = 2546730143072229311 := by decide
+
+theorem log2_eq : (List.range 200).map (fun i => Nat.log2 (2^i + i)) = List.range 200 := by decide
+
+theorem gray_sum : ((List.range 500).map (fun i => (i ^^^ (i >>> 1)) &&& 0xff)).foldl (· + ·) 0 = 65198 := by decide
@@ -0,0 +1,30 @@
+import Lean
+open Lean
+
+/-!
+  Performance of the kernel `replace` traversal (used by `instantiate` and `abstract`) on
+  deeply nested terms, and on many small terms, the common case. -/
+
+def succs (n : Nat) (x : Expr) : Expr := Id.run do
+  let mut e := x
+  for _ in [:n] do
+    e := mkApp (mkConst ``Nat.succ) e
+  return e
+
+/-- A small term that is not shared, so that `replace` does not hit its cache. -/
+def small (i : Nat) : Expr :=
+  mkApp2 (mkConst ``Nat.add) (mkApp2 (mkConst ``Nat.mul) (.bvar 0) (mkNatLit i)) (mkApp (mkConst ``Nat.succ) (.bvar 0))
+
+#eval show MetaM Unit from do
+  -- deep terms
+  let mut total := 0
+  for i in [:20] do
+    let e := (succs 200000 (.bvar 0)).instantiate1 (mkNatLit i)
+    total := total + e.approxDepth.toNat
+  IO.println total
+  -- shallow terms
+  let mut n := 0
+  for i in [:2000000] do
+    if (small i).instantiate1 (mkNatLit i) |>.hasLooseBVars then
+      n := n + 1
+  IO.println n
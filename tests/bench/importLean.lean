@@ -0,0 +1 @@
+import Lean
@@ -0,0 +1,36 @@
+/-!
+  Reduction-heavy declarations. Every theorem below is proved by `decide`, so most of the
+  time is spent in `whnf`, `whnf_core`, `infer_type` and `is_def_eq`, which all go through
+  the caches of the kernel type checker. -/
+
+-- `decide` evaluates the propositions using `whnf` first, which recurses deeply on them
+set_option maxRecDepth 100000
+
+def sumTo : Nat → Nat
+  | 0 => 0
+  | n+1 => (n+1) + sumTo n
+
+theorem sumTo_eq : sumTo 2000 = 2001000 := by decide
+
+def fib : Nat → Nat
+  | 0 => 0
+  | 1 => 1
+  | n+2 => fib n + fib (n+1)
+
+theorem fib_eq : fib 20 = 6765 := by decide
+
+theorem range_foldl : (List.range 300).foldl (· + ·) 0 = 44850 := by decide
+
+theorem iota_reverse : (List.iota 60).reverse = (List.range 61).tail! := by decide
+
+theorem all_lt : (List.range 200).all (· < 200) = true := by decide
+
+def insertSorted (a : Nat) : List Nat → List Nat
+  | [] => [a]
+  | b :: bs => if a ≤ b then a :: b :: bs else b :: insertSorted a bs
+
+def insertionSort : List Nat → List Nat
+  | [] => []
+  | a :: as => insertSorted a (insertionSort as)
+
+theorem insertionSort_eq : insertionSort (List.range 40).reverse = List.range 40 := by decide
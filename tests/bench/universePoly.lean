@@ -0,0 +1,129 @@
+/-!
+  Universe-polymorphic, category-theory style declarations. Type checking them compares many
+  `max`/`imax` universe levels, exercising universe level normalization and `is_geq` in the kernel. -/
+
+universe v v₁ v₂ v₃ v₄ v₅ u u₁ u₂ u₃ u₄ u₅
+
+class Category (C : Type u) where
+  Hom : C → C → Type v
+  id : ∀ X : C, Hom X X
+  comp : ∀ {X Y Z : C}, Hom X Y → Hom Y Z → Hom X Z
+  id_comp : ∀ {X Y : C} (f : Hom X Y), comp (id X) f = f
+  comp_id : ∀ {X Y : C} (f : Hom X Y), comp f (id Y) = f
+  assoc : ∀ {W X Y Z : C} (f : Hom W X) (g : Hom X Y) (h : Hom Y Z), comp (comp f g) h = comp f (comp g h)
+
+infixr:10 " ⟶ " => Category.Hom
+infixr:80 " ≫ " => Category.comp
+notation "𝟙" => Category.id
+
+attribute [simp] Category.id_comp Category.comp_id Category.assoc
+
+structure CatFunctor (C : Type u₁) [Category.{v₁} C] (D : Type u₂) [Category.{v₂} D] where
+  obj : C → D
+  map : ∀ {X Y : C}, (X ⟶ Y) → (obj X ⟶ obj Y)
+  map_id : ∀ X : C, map (𝟙 X) = 𝟙 (obj X)
+  map_comp : ∀ {X Y Z : C} (f : X ⟶ Y) (g : Y ⟶ Z), map (f ≫ g) = map f ≫ map g
+
+attribute [simp] CatFunctor.map_id CatFunctor.map_comp
+
+def CatFunctor.id (C : Type u₁) [Category.{v₁} C] : CatFunctor C C where
+  obj X := X
+  map f := f
+  map_id _ := rfl
+  map_comp _ _ := rfl
+
+def CatFunctor.comp {C : Type u₁} [Category.{v₁} C] {D : Type u₂} [Category.{v₂} D] {E : Type u₃} [Category.{v₃} E]
+    (F : CatFunctor C D) (G : CatFunctor D E) : CatFunctor C E where
+  obj X := G.obj (F.obj X)
+  map f := G.map (F.map f)
+  map_id X := by simp
+  map_comp f g := by simp
+
+theorem CatFunctor.id_comp {C : Type u₁} [Category.{v₁} C] {D : Type u₂} [Category.{v₂} D] (F : CatFunctor C D) :
+    (CatFunctor.id C).comp F = F := rfl
+
+theorem CatFunctor.comp_id {C : Type u₁} [Category.{v₁} C] {D : Type u₂} [Category.{v₂} D] (F : CatFunctor C D) :
+    F.comp (CatFunctor.id D) = F := rfl
+
+theorem CatFunctor.comp_assoc {A : Type u₁} [Category.{v₁} A] {B : Type u₂} [Category.{v₂} B]
+    {C : Type u₃} [Category.{v₃} C] {D : Type u₄} [Category.{v₄} D]
+    (F : CatFunctor A B) (G : CatFunctor B C) (H : CatFunctor C D) : (F.comp G).comp H = F.comp (G.comp H) := rfl
+
+instance Category.prod (C : Type u₁) [Category.{v₁} C] (D : Type u₂) [Category.{v₂} D] :
+    Category.{max v₁ v₂} (C × D) where
+  Hom X Y := (X.1 ⟶ Y.1) × (X.2 ⟶ Y.2)
+  id X := (𝟙 X.1, 𝟙 X.2)
+  comp f g := (f.1 ≫ g.1, f.2 ≫ g.2)
+  id_comp f := by cases f; simp
+  comp_id f := by cases f; simp
+  assoc f g h := by cases f; cases g; cases h; simp
+
+def CatFunctor.fst (C : Type u₁) [Category.{v₁} C] (D : Type u₂) [Category.{v₂} D] : CatFunctor (C × D) C where
+  obj X := X.1
+  map f := f.1
+  map_id _ := rfl
+  map_comp _ _ := rfl
+
+def CatFunctor.snd (C : Type u₁) [Category.{v₁} C] (D : Type u₂) [Category.{v₂} D] : CatFunctor (C × D) D where
+  obj X := X.2
+  map f := f.2
+  map_id _ := rfl
+  map_comp _ _ := rfl
+
+def CatFunctor.swap (C : Type u₁) [Category.{v₁} C] (D : Type u₂) [Category.{v₂} D] : CatFunctor (C × D) (D × C) where
+  obj X := (X.2, X.1)
+  map f := (f.2, f.1)
+  map_id _ := rfl
+  map_comp _ _ := rfl
+
+def CatFunctor.prod {A : Type u₁} [Category.{v₁} A] {B : Type u₂} [Category.{v₂} B]
+    {C : Type u₃} [Category.{v₃} C] {D : Type u₄} [Category.{v₄} D]
+    (F : CatFunctor A B) (G : CatFunctor C D) : CatFunctor (A × C) (B × D) where
+  obj X := (F.obj X.1, G.obj X.2)
+  map f := (F.map f.1, G.map f.2)
+  map_id X :=
+    (by rw [F.map_id, G.map_id] : (F.map (𝟙 X.1), G.map (𝟙 X.2)) = (𝟙 (F.obj X.1), 𝟙 (G.obj X.2)))
+  map_comp f g :=
+    (by rw [F.map_comp, G.map_comp] :
+      (F.map (f.1 ≫ g.1), G.map (f.2 ≫ g.2)) = (F.map f.1 ≫ F.map g.1, G.map f.2 ≫ G.map g.2))
+
+def CatFunctor.assocProd (A : Type u₁) [Category.{v₁} A] (B : Type u₂) [Category.{v₂} B] (C : Type u₃) [Category.{v₃} C] :
+    CatFunctor ((A × B) × C) (A × (B × C)) where
+  obj X := (X.1.1, (X.1.2, X.2))
+  map f := (f.1.1, (f.1.2, f.2))
+  map_id _ := rfl
+  map_comp _ _ := rfl
+
+section
+variable (A : Type u₁) [Category.{v₁} A] (B : Type u₂) [Category.{v₂} B] (C : Type u₃) [Category.{v₃} C]
+  (D : Type u₄) [Category.{v₄} D] (E : Type u₅) [Category.{v₅} E]
+
+theorem swap_swap : (CatFunctor.swap A B).comp (CatFunctor.swap B A) = CatFunctor.id (A × B) := rfl
+
+theorem swap_fst : (CatFunctor.swap A B).comp (CatFunctor.fst B A) = CatFunctor.snd A B := rfl
+
+theorem prod_id : (CatFunctor.id A).prod (CatFunctor.id B) = CatFunctor.id (A × B) := rfl
+
+theorem assoc₁ (F : CatFunctor A B) (G : CatFunctor B C) (H : CatFunctor C D) (K : CatFunctor D E) :
+    ((F.comp G).comp H).comp K = F.comp (G.comp (H.comp K)) := rfl
+
+theorem assoc₂ (F : CatFunctor A B) (G : CatFunctor B C) (H : CatFunctor C D) (K : CatFunctor D E) :
+    (F.comp (G.comp H)).comp K = (F.comp G).comp (H.comp K) := rfl
+
+theorem prod_comp (F : CatFunctor A B) (G : CatFunctor B C) (H : CatFunctor D E) :
+    (F.comp G).prod (H.comp (CatFunctor.id E)) = (F.prod H).comp (G.prod (CatFunctor.id E)) := rfl
+
+theorem assocProd_fst :
+    (CatFunctor.assocProd A B C).comp (CatFunctor.fst A (B × C)) = (CatFunctor.fst (A × B) C).comp (CatFunctor.fst A B) := rfl
+
+theorem swap_prod (F : CatFunctor A B) (G : CatFunctor C D) :
+    (F.prod G).comp (CatFunctor.swap B D) = (CatFunctor.swap A C).comp (G.prod F) := rfl
+
+theorem big_prod (F : CatFunctor A B) (G : CatFunctor C D) (H : CatFunctor E E) :
+    ((F.prod G).prod H).comp (CatFunctor.assocProd B D E) = (CatFunctor.assocProd A C E).comp (F.prod (G.prod H)) := rfl
+
+theorem nested_swap :
+    ((CatFunctor.swap (A × B) (C × D)).comp (CatFunctor.swap (C × D) (A × B))).comp
+      ((CatFunctor.swap A B).prod (CatFunctor.swap C D)) =
+    (CatFunctor.swap A B).prod (CatFunctor.swap C D) := rfl
+end
@@ -0,0 +1,23 @@
+import Lean
+open Lean
+
+/-!
+  Re-serializes the already imported module data of the `Lean` package, exercising the
+  object compactor behind `saveModuleData`/`writeModule`. -/
+
+def writeLeanModules (env : Environment) (fname : System.FilePath) : IO Nat := do
+  let mut n := 0
+  for mod in env.header.moduleNames, data in env.header.moduleData do
+    if (`Lean).isPrefixOf mod then
+      saveModuleData fname mod data
+      n := n + 1
+  return n
+
+def bench : CoreM Unit := do
+  let env ← getEnv
+  let fname : System.FilePath := "writeModule.olean.tmp"
+  let n ← timeit "write_module" (writeLeanModules env fname)
+  IO.FS.removeFile fname
+  IO.println s!"{n} modules"
+
+#eval bench
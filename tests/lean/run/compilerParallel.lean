@@ -0,0 +1,74 @@
+import Lean
+open Lean Elab Command
+
+/-!
+Compiling the declarations of a mutual block in parallel (`compiler.parallel`) must report the same errors, and
+account for the same heartbeats, as compiling them sequentially.
+-/
+
+set_option compiler.parallel true in
+mutual
+partial def isEven (n : Nat) : Bool := if n == 0 then true else isOdd (n - 1)
+partial def isOdd (n : Nat) : Bool := if n == 0 then false else isEven (n - 1)
+end
+
+#eval show IO Unit from do
+  unless isEven 10 && isOdd 7 && !isEven 3 do
+    throw <| IO.userError "unexpected result"
+
+/-- A mutual block with declarations named `ns.f` and `ns.g`, where `body` is the base case of `ns.f`. -/
+def block (ns : Name) (body : Term) : CommandElabM Syntax := do
+  let f := mkIdent (ns ++ `f)
+  let g := mkIdent (ns ++ `g)
+  `(mutual
+    partial def $f:ident (n : Nat) : Nat := if n == 0 then $body else $g:ident (n - 1) + 1
+    partial def $g:ident (n : Nat) : Nat := if n == 0 then 1 else $f:ident (n - 1) * 2
+    end)
+
+/--
+Elaborate `cmd` with the given options using the old code generator, and return the error messages it produced,
+which are removed from the log, and the number of heartbeats used. -/
+def elabWith (parallel : Bool) (maxHeartbeats : Nat) (cmd : Syntax) : CommandElabM (List String × Nat) := do
+  let saved := (← get).messages
+  modify fun s => { s with messages := {} }
+  let start ← IO.getNumHeartbeats
+  let setOpts (opts : Options) := opts
+    |>.setBool `compiler.parallel parallel
+    |>.setBool `compiler.enableNew false
+    |>.setNat `maxHeartbeats maxHeartbeats
+  withScope (fun scope => { scope with opts := setOpts scope.opts }) do
+    elabCommand cmd
+  let used := (← IO.getNumHeartbeats) - start
+  let msgs := (← get).messages
+  modify fun s => { s with messages := saved }
+  let errors ← msgs.toList.filter (·.severity == .error) |>.mapM (·.data.toString)
+  return (errors, used)
+
+/-- Elaborate the same block sequentially and in parallel, and check that the errors are the same. -/
+def compare (test : Name) (body : Term) (maxHeartbeats := 200000) : CommandElabM (List String × Nat × Nat) := do
+  -- names of the same length, so that elaborating both blocks does the same work, after a first block that fills
+  -- the caches
+  discard <| elabWith false maxHeartbeats (← block (`Tmp ++ test) body)
+  let (seqErrors, seqUsed) ← elabWith false maxHeartbeats (← block (`Seq ++ test) body)
+  let (parErrors, parUsed) ← elabWith true maxHeartbeats (← block (`Par ++ test) body)
+  let parErrors := parErrors.map (·.replace "Par." "Seq.")
+  unless seqErrors == parErrors do
+    throwError "parallel compilation reported {parErrors}, sequential compilation reported {seqErrors}"
+  return (parErrors, seqUsed, parUsed)
+
+-- successful compilation, the heartbeats used by helpers are added to the caller's
+#eval show CommandElabM Unit from do
+  let (errors, seqUsed, parUsed) ← compare `ok (← `(0))
+  unless errors.isEmpty do throwError "unexpected errors {errors}"
+  unless seqUsed * 9 ≤ parUsed * 10 && parUsed * 9 ≤ seqUsed * 10 do
+    throwError "sequential compilation used {seqUsed} heartbeats, parallel compilation used {parUsed}"
+
+-- the heartbeat limit is exceeded in the same way
+#eval show CommandElabM Unit from do
+  let (errors, _, _) ← compare `limit (← `(0)) (maxHeartbeats := 1)
+  if errors.isEmpty then throwError "heartbeat limit was not exceeded"
+
+-- errors are reported in the same way
+#eval show CommandElabM Unit from do
+  let (errors, _, _) ← compare `error (← `((Classical.choice ⟨0⟩ : Nat)))
+  if errors.isEmpty then throwError "missing error"
@@ -0,0 +1,44 @@
+/-!
+`compiler.pass_stats.csv` writes the statistics of each compiler pass at exit, so the test runs `lean` on a small file.
+-/
+
+def input : String := "
+def passStatsFoo (n : Nat) : Nat :=
+  let m := n * 2
+  if m > 10 then m - 10 else m + n
+"
+
+def main : IO Unit := do
+  let file : System.FilePath := "compilerPassStatsInput.lean"
+  let csv : System.FilePath := "compilerPassStatsInput.csv"
+  IO.FS.writeFile file input
+  if ← csv.pathExists then IO.FS.removeFile csv
+  let out ← IO.Process.output {
+    cmd := (← IO.appPath).toString
+    args := #[s!"-Dcompiler.pass_stats.csv={csv}", file.toString] }
+  unless out.exitCode == 0 do
+    throw <| IO.userError s!"unexpected result: {out.exitCode}\n{out.stdout}\n{out.stderr}"
+  -- the statistics are written instead of being displayed
+  if out.stderr.contains '\t' then
+    throw <| IO.userError s!"pass statistics were displayed:\n{out.stderr}"
+  let lines ← IO.FS.lines csv
+  unless lines[0]? == some "pass,runs,seconds,lets_before,lets_after,size_before,size_after" do
+    throw <| IO.userError s!"unexpected header: {lines[0]?}"
+  let rows ← lines[1:].toArray.mapM fun line => do
+    let fields := line.splitOn ","
+    unless fields.length == 7 && [1, 3, 4, 5, 6].all (fields[·]!.isNat) do
+      throw <| IO.userError s!"invalid row: {line}"
+    return (fields[0]!, fields[1]!.toNat!, fields[5]!.toNat!, fields[6]!.toNat!)
+  -- each pass has a single row, in the order the passes were first run
+  let passes := rows.map (·.1)
+  unless passes.toList.eraseDups.length == passes.size do
+    throw <| IO.userError s!"duplicate passes: {passes}"
+  unless passes[0]? == some "eta_expand" && passes.back? == some "compile_ir" && passes.contains "csimp" do
+    throw <| IO.userError s!"unexpected passes: {passes}"
+  for (pass, runs, sizeBefore, sizeAfter) in rows do
+    unless runs > 0 && sizeBefore > 0 && sizeAfter > 0 do
+      throw <| IO.userError s!"unexpected statistics for '{pass}': {runs} runs, size {sizeBefore} -> {sizeAfter}"
+  IO.FS.removeFile file
+  IO.FS.removeFile csv
+
+#eval main
@@ -0,0 +1,32 @@
+import Lean
+open Lean
+
+/-!
+`instantiate` and `abstract` (implemented using the kernel `replace`) must not use native recursion,
+otherwise deeply nested terms exhaust the stack.
+-/
+
+/-- `Nat.succ (Nat.succ (... (Nat.succ x)))` with `n` applications. -/
+def succs (n : Nat) (x : Expr) : Expr := Id.run do
+  let mut e := x
+  for _ in [:n] do
+    e := mkApp (mkConst ``Nat.succ) e
+  return e
+
+/-- Number of `Nat.succ` applications at the head of `e`, and the innermost term. -/
+partial def unSuccs (e : Expr) (n : Nat := 0) : Nat × Expr :=
+  if e.isAppOfArity ``Nat.succ 1 then unSuccs e.appArg! (n+1) else (n, e)
+
+def depth := 1000000
+
+#eval show MetaM Unit from do
+  let e := succs depth (.bvar 0)
+  let (n, x) := unSuccs (e.instantiate1 (mkNatLit 5))
+  unless n == depth && x == mkNatLit 5 do throwError "unexpected instantiate1 result"
+  let (n, x) := unSuccs ((succs depth (mkFVar ⟨`x⟩)).abstract #[mkFVar ⟨`x⟩])
+  unless n == depth && x == .bvar 0 do throwError "unexpected abstract result"
+  -- deep binders
+  let mut b := Expr.bvar depth
+  for i in [:depth] do
+    b := .lam (Name.mkSimple s!"x{i}") (mkConst ``Nat) b .default
+  if (b.instantiate1 (mkConst ``Nat.zero)).hasLooseBVars then throwError "unexpected loose bound variables"
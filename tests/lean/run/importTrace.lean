@@ -0,0 +1,36 @@
+import Lean
+open Lean
+
+def traceFile : System.FilePath := "importTrace.jsonl"
+
+#eval show IO Unit from do
+  if (← traceFile.pathExists) then IO.FS.removeFile traceFile
+  let opts := profiler.importTrace.set {} traceFile.toString
+  discard <| importModules #[{ module := `Init }] opts
+  let numLines := (← IO.FS.lines traceFile).size
+  -- records are appended
+  discard <| importModules #[{ module := `Init }] opts
+  let lines ← IO.FS.lines traceFile
+  IO.FS.removeFile traceFile
+  unless lines.size == 2 * numLines do
+    throw <| IO.userError s!"expected {2 * numLines} import trace records, got {lines.size}"
+  let mut modules := 0
+  let mut extensions := 0
+  for line in lines do
+    let j ← IO.ofExcept <| Json.parse line
+    match j.getObjValAs? String "event" with
+    | .ok "module" =>
+      modules := modules + 1
+      let _ ← IO.ofExcept <| j.getObjValAs? Name "module"
+      let _ ← IO.ofExcept <| j.getObjValAs? Nat "bytes"
+      let _ ← IO.ofExcept <| j.getObjValAs? Bool "mmap"
+      let _ ← IO.ofExcept <| j.getObjValAs? Nat "readNs"
+      let _ ← IO.ofExcept <| j.getObjValAs? Nat "constants"
+    | .ok "extension" =>
+      extensions := extensions + 1
+      let _ ← IO.ofExcept <| j.getObjValAs? Name "extension"
+      let _ ← IO.ofExcept <| j.getObjValAs? Nat "entries"
+      let _ ← IO.ofExcept <| j.getObjValAs? Nat "ns"
+    | _ => throw <| IO.userError s!"unexpected import trace record: {line}"
+  unless modules > 0 && extensions > 0 do
+    throw <| IO.userError s!"missing import trace records: {modules} modules, {extensions} extensions"
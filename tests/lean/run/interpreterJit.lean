@@ -0,0 +1,40 @@
+import Lean
+open Lean
+
+/-!
+Imported functions without native code are compiled just in time after `interpreter.jit.threshold` interpreted calls,
+if Lean was built with `LLVM=ON`; otherwise they keep being interpreted. Either way the results must be the same as
+without the JIT. The functions below are imported from a module written by the test itself, so that they have no
+native code in the `lean` executable.
+-/
+
+def jitTable : Array Nat := #[3, 5, 7]
+
+@[noinline] def jitStep (x i : Nat) : Nat := (x * 31 + jitTable[i % 3]!) % 1000003
+
+def jitRun : Nat → Nat → Nat
+  | acc, 0 => acc
+  | acc, n+1 => jitRun (jitStep acc n) n
+
+unsafe def runImported (env : Environment) (threshold : Nat) (n : Nat) : IO Nat := do
+  let opts := ({} : Options) |>.setNat `interpreter.jit.threshold threshold
+  let f ← IO.ofExcept <| env.evalConst (Nat → Nat → Nat) opts ``jitRun
+  return f 0 n
+
+unsafe def test : CoreM Unit := do
+  let fname : System.FilePath := "InterpreterJitTest.olean"
+  writeModule ((← getEnv).setMainModule `InterpreterJitTest) fname
+  searchPathRef.set ((← searchPathRef.get) ++ [← IO.currentDir])
+  let env ← importModules #[{ module := `InterpreterJitTest }] {}
+  try
+    for n in [0, 1, 2, 100, 10000] do
+      let expected := jitRun 0 n
+      for threshold in [0, 1, 2, 50] do
+        let r ← runImported env threshold n
+        unless r == expected do
+          throwError "jitRun 0 {n} returned {r} with threshold {threshold}, expected {expected}"
+  finally
+    env.freeRegions
+    IO.FS.removeFile fname
+
+#eval test
@@ -0,0 +1,46 @@
+/-!
+`interpreter.profile` displays the calls of each function called by interpreted code at exit, and
+`interpreter.profile.folded` writes the time spent in each call stack. The report is only displayed when `lean` exits,
+so the test runs `lean` on a small file.
+-/
+
+def input : String := "
+def profFib : Nat → Nat
+  | 0 => 0
+  | 1 => 1
+  | n+2 => profFib n + profFib (n+1)
+
+#eval profFib 15
+"
+
+def main : IO Unit := do
+  let file : System.FilePath := "interpreterProfileInput.lean"
+  let folded : System.FilePath := "interpreterProfileInput.folded"
+  IO.FS.writeFile file input
+  if ← folded.pathExists then IO.FS.removeFile folded
+  let out ← IO.Process.output {
+    cmd := (← IO.appPath).toString
+    args := #["-Dinterpreter.profile=true", s!"-Dinterpreter.profile.folded={folded}", file.toString] }
+  unless out.exitCode == 0 && out.stdout.trim == "610" do
+    throw <| IO.userError s!"unexpected result: {out.exitCode}\n{out.stdout}\n{out.stderr}"
+  -- report: a header, then one line per function with its name and five counters
+  let lines := out.stderr.splitOn "\n" |>.dropWhile (!·.startsWith "interpreter profile")
+  unless lines.head? == some "interpreter profile (exclusive time, inclusive time, calls, native calls, allocations):" do
+    throw <| IO.userError s!"missing profile header:\n{out.stderr}"
+  let some fib := lines.find? (·.startsWith "\tprofFib ")
+    | throw <| IO.userError s!"missing profile entry for 'profFib':\n{out.stderr}"
+  -- `profFib 15` makes 1973 calls
+  unless (fib.trim.splitOn " ").length == 6 && (fib.trim.splitOn " ")[3]! == "1973" do
+    throw <| IO.userError s!"unexpected profile entry: {fib}"
+  -- folded stacks: `f;g;h <microseconds>`, one line per call stack
+  let stacks ← (← IO.FS.lines folded).mapM fun line => do
+    let some i := line.revPosOf ' ' | throw <| IO.userError s!"invalid folded line: {line}"
+    unless (line.extract (line.next i) line.endPos).isNat do
+      throw <| IO.userError s!"invalid folded line: {line}"
+    return line.extract 0 i
+  unless stacks.any (·.endsWith "profFib;profFib;profFib") do
+    throw <| IO.userError s!"missing recursive call stacks of 'profFib': {stacks}"
+  IO.FS.removeFile file
+  IO.FS.removeFile folded
+
+#eval main
@@ -0,0 +1,28 @@
+/-!
+Calls from interpreted code to precompiled functions with unboxed parameters or results
+(`Char`, i.e. `UInt32`, `Bool`, `Float`) use the unboxed native code through trampolines.
+-/
+
+def check (b : Bool) (msg : String) : IO Unit :=
+  unless b do throw <| IO.userError s!"check failed: {msg}"
+
+def classify (c : Char) : Nat :=
+  (if c.isDigit then 1 else 0) + (if c.isWhitespace then 2 else 0) + (if c.isUpper then 4 else 0)
+
+#eval check (classify '7' == 1) "classify '7'"
+#eval check (classify ' ' == 2) "classify ' '"
+#eval check (classify 'Q' == 4) "classify 'Q'"
+#eval check ('A'.toLower == 'a' && 'z'.toUpper == 'Z') "toLower/toUpper"
+
+def sumClasses (n : Nat) : Nat :=
+  (List.range n).foldl (fun acc i => acc + classify (Char.ofNat (48 + i % 10))) 0
+
+#eval check (sumClasses 1000 == 1000) "sumClasses"
+
+-- closures still use the boxed versions
+#eval check ("HeLLo World".map Char.toLower == "hello world") "String.map"
+
+def floats (n : Nat) : Float :=
+  (List.range n).foldl (fun acc i => acc + Float.ofInt (Int.ofNat i - 5)) 0
+
+#eval check (floats 11 == 0) "floats"
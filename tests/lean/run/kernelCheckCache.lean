@@ -0,0 +1,90 @@
+import Lean
+open Lean
+
+/-!
+The key of the persistent kernel check cache must change whenever the declaration or one of its
+(transitive) dependencies changes, and must not depend on binder names. Entries are only trusted if the
+trust level is at least `2048` and the entry is intact.
+-/
+
+def thm (n : Name) (type value : Expr) : Declaration :=
+  .thmDecl { name := n, levelParams := [], type, value }
+
+def key (env : Environment) (d : Declaration) : IO String := do
+  let some k := Kernel.checkCacheKey? env d | throw <| IO.userError "declaration is not cached"
+  return k
+
+def natEq (a b : Expr) : Expr := mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) a b
+def rfl' (a : Expr) : Expr := mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) a
+
+def f := 2
+def g := 2
+
+#eval show CoreM Unit from do
+  let env ← getEnv
+  let d₁ := thm `t₁ (natEq (mkConst ``f) (mkNatLit 2)) (rfl' (mkNatLit 2))
+  let d₂ := thm `t₁ (natEq (mkConst ``g) (mkNatLit 2)) (rfl' (mkNatLit 2))
+  let d₃ := thm `t₁ (natEq (mkConst ``f) (mkNatLit 3)) (rfl' (mkNatLit 2))
+  let k₁ ← key env d₁
+  unless k₁ == (← key env d₁) do throwError "key is not deterministic"
+  -- `f` and `g` have the same definition but different names
+  unless k₁ != (← key env d₂) do throwError "key does not depend on the constants used"
+  unless k₁ != (← key env d₃) do throwError "key does not depend on literals"
+  -- binder names are ignored
+  let id₁ := mkLambda `x .default (mkConst ``Nat) (.bvar 0)
+  let id₂ := mkLambda `y .default (mkConst ``Nat) (.bvar 0)
+  let e₁ := thm `t₂ (natEq (mkApp id₁ (mkConst ``f)) (mkConst ``f)) (rfl' (mkConst ``f))
+  let e₂ := thm `t₂ (natEq (mkApp id₂ (mkConst ``f)) (mkConst ``f)) (rfl' (mkConst ``f))
+  unless (← key env e₁) == (← key env e₂) do throwError "key depends on binder names"
+  -- inductive declarations are not cached
+  let ind := Declaration.inductDecl [] 0 [{ name := `Foo, type := mkSort levelOne, ctors := [] }] false
+  if (Kernel.checkCacheKey? env ind).isSome then throwError "inductive declarations must not be cached"
+
+-- adding a cached declaration still checks that its name is fresh
+#eval show CoreM Unit from do
+  let dir := (← IO.currentDir) / "kernelCheckCache.tmp"
+  if (← dir.pathExists) then IO.FS.removeDirAll dir
+  Kernel.setCheckCacheDir dir
+  try
+    let d := thm `t₃ (natEq (mkConst ``f) (mkNatLit 2)) (rfl' (mkNatLit 2))
+    let env ← getEnv
+    let .ok env₁ := env.addDecl d | throwError "unexpected failure"
+    unless (← dir.readDir).size == 1 do throwError "cache entry was not written"
+    if let .ok _ := env₁.addDecl d then throwError "duplicate declaration was accepted"
+    let .ok _ := env.addDecl d | throwError "cached declaration was rejected"
+  finally
+    Kernel.setCheckCacheDir none
+    IO.FS.removeDirAll dir
+
+-- a forged entry for an ill-typed theorem is only used at an explicit trust level, and only if it is intact
+#eval show IO Unit from do
+  let dir := (← IO.currentDir) / "kernelCheckCache2.tmp"
+  if (← dir.pathExists) then IO.FS.removeDirAll dir
+  Kernel.setCheckCacheDir dir
+  try
+    let bad := thm `bad (natEq (mkNatLit 1) (mkNatLit 2)) (rfl' (mkNatLit 1))
+    let envDefault ← importModules #[{ module := `Init }] {} (trustLevel := 1025)
+    let envTrusted ← importModules #[{ module := `Init }] {} (trustLevel := 2048)
+    let k ← key envTrusted bad
+    unless k.length == 64 do throw <| IO.userError "unexpected key length"
+    IO.FS.createDirAll (dir / k.take 2)
+    let accepted (env : Environment) (contents : String) : IO Bool := do
+      IO.FS.writeFile (dir / k.take 2 / k) contents
+      match env.addDecl bad with
+      | .ok _    => return true
+      | .error _ => return false
+    let entry (digest githash decl : String) :=
+      s!"lean-kernel-check-cache 2\n{digest}\n{githash}\n{decl}\n"
+    if (← accepted envTrusted (entry (k.take 16) githash "bad")) then
+      throw <| IO.userError "entry with a truncated key was accepted"
+    if (← accepted envTrusted (entry k "0000" "bad")) then
+      throw <| IO.userError "entry written by another commit was accepted"
+    if (← accepted envTrusted (entry k githash "other")) then
+      throw <| IO.userError "entry for another declaration was accepted"
+    if (← accepted envDefault (entry k githash "bad")) then
+      throw <| IO.userError "entry was trusted at the default trust level"
+    unless (← accepted envTrusted (entry k githash "bad")) do
+      throw <| IO.userError "valid entry was not used at trust level 2048"
+  finally
+    Kernel.setCheckCacheDir none
+    IO.FS.removeDirAll dir
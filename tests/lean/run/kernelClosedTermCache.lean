@@ -0,0 +1,20 @@
+import Lean
+open Lean
+
+#eval show IO Unit from Kernel.setClosedTermCacheSize 1000
+
+theorem ex1 : 123 + 456 = 579 := by decide
+theorem ex2 : 123 + 456 = 579 := by decide
+
+def localConst := 579
+-- `localConst` is not imported, so these terms are not cached
+theorem ex3 : 123 + 456 = localConst := by decide
+
+#eval show IO Unit from do
+  let stats ← Kernel.getClosedTermCacheStats
+  unless stats.hits > 0 && stats.size > 0 do
+    throw <| IO.userError s!"unexpected statistics {repr stats}"
+  Kernel.setClosedTermCacheSize 0
+  let stats ← Kernel.getClosedTermCacheStats
+  unless stats.size == 0 do
+    throw <| IO.userError s!"cache was not cleared {repr stats}"
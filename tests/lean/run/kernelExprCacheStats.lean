@@ -0,0 +1,27 @@
+import Lean
+open Lean
+
+/-!
+The `replace` cache grows when a traversal visits more shared subterms than it can hold.
+-/
+
+/-- A term with `n` distinct shared subterms `tᵢ := Nat.add tᵢ₋₁ tᵢ₋₁`, each one containing `#0`. -/
+def dag (n : Nat) : Expr := Id.run do
+  let mut e : Expr := .bvar 0
+  for _ in [:n] do
+    e := mkApp2 (mkConst ``Nat.add) e e
+  return e
+
+#eval show IO Unit from do
+  let s₁ ← Kernel.getExprCacheStats
+  let mut r := 0
+  for i in [:100] do
+    -- keep `dag` shared so that its subterms are cached
+    let e := dag 50000
+    r := r + ((e.instantiate1 (mkNatLit i)).approxDepth.toNat)
+  let s₂ ← Kernel.getExprCacheStats
+  unless s₂.replaceHits > s₁.replaceHits do
+    throw <| IO.userError "replace cache hits were not counted"
+  unless s₂.replaceResizes > s₁.replaceResizes do
+    throw <| IO.userError "replace cache did not grow"
+  IO.println r
@@ -0,0 +1,59 @@
+import Lean
+open Lean
+
+/-!
+The kernel reduces `Nat.land`, `Nat.lor`, `Nat.xor`, `Nat.shiftLeft`, `Nat.shiftRight` and `Nat.log2` applied to
+literals, including literals that do not fit in 64 bits. The declarations below are added using `Environment.addDecl`,
+so they are only checked by the kernel.
+-/
+
+def natEq (a b : Expr) : Expr := mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) a b
+
+def op (f : Name) (args : List Expr) : Expr := mkAppN (mkConst f) args.toArray
+
+/-- Check `lhs = rhs` by `rfl` in the kernel, return `false` if it is rejected. -/
+def kernelRfl (lhs rhs : Expr) : CoreM Bool := do
+  let n ← mkFreshUserName `t
+  let decl := Declaration.thmDecl {
+    name := n, levelParams := [], type := natEq lhs rhs
+    value := mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) lhs }
+  match (← getEnv).addDecl decl with
+  | .ok _    => return true
+  | .error _ => return false
+
+def a : Nat := 2^100 + 2^70 + 12345
+def b : Nat := 2^90 + 2^70 + 54321
+
+#eval show CoreM Unit from do
+  let cases : List (Name × List Nat × Nat) := [
+    (``Nat.land, [12, 10], 8),
+    (``Nat.lor, [12, 10], 14),
+    (``Nat.xor, [12, 10], 6),
+    (``Nat.shiftLeft, [3, 4], 48),
+    (``Nat.shiftRight, [48, 4], 3),
+    (``Nat.log2, [1000], 9),
+    (``Nat.log2, [0], 0),
+    -- operands beyond 64 bits
+    (``Nat.land, [a, b], 1180591620717411307569),
+    (``Nat.lor, [a, b], 1268888541448106402489013695545),
+    (``Nat.xor, [a, b], 1268888540267514781771602387976),
+    (``Nat.shiftLeft, [a, 5], 40564819245082272710851664676640),
+    (``Nat.shiftLeft, [1, 100], 1267650600228229401496703205376),
+    (``Nat.shiftRight, [a, 66], 17179869200),
+    (``Nat.log2, [a], 100)
+  ]
+  for (f, args, r) in cases do
+    let lhs := op f (args.map mkRawNatLit)
+    unless (← kernelRfl lhs (mkRawNatLit r)) do
+      throwError "kernel failed to reduce {lhs} to {r}"
+    if (← kernelRfl lhs (mkRawNatLit (r + 1))) then
+      throwError "kernel accepted {lhs} = {r + 1}"
+
+-- `Nat.shiftLeft` is not reduced if the shift does not fit in an `unsigned`, but the kernel can still compare its
+-- arguments
+#eval show CoreM Unit from do
+  for shift in [4294967296, 2^64] do
+    let lhs := op ``Nat.shiftLeft [mkRawNatLit 1, mkRawNatLit shift]
+    let rhs := op ``Nat.shiftLeft [mkRawNatLit 1, op ``Nat.add [mkRawNatLit (shift - 1), mkRawNatLit 1]]
+    unless (← kernelRfl lhs rhs) do
+      throwError "kernel failed to check {lhs} = {rhs}"
@@ -0,0 +1,52 @@
+import Lean
+open Lean
+
+/-!
+Differential test: the kernel evaluator `Kernel.nbeEvalConstructor?` must agree with the
+head constructor of `Kernel.whnf`, and must get stuck instead of producing a wrong answer.
+-/
+
+def checkNbe (e : Expr) (expectStuck := false) : CoreM Unit := do
+  let env ← getEnv
+  let r := Kernel.nbeEvalConstructor? env e
+  if expectStuck then
+    if let some c := r then
+      throwError "nbe was expected to get stuck at{indentExpr e}\nbut returned {c}"
+    return
+  let some c := r | throwError "nbe got stuck at{indentExpr e}"
+  match Kernel.whnf env {} e with
+  | .ok v =>
+    let c' := if let .lit (.natVal n) := v then (if n == 0 then ``Nat.zero else ``Nat.succ) else v.getAppFn.constName!
+    unless c == c' do
+      throwError "nbe mismatch at{indentExpr e}\nnbe: {c}\nwhnf:{indentExpr v}"
+  | .error ex => throwKernelException ex
+
+def isPrime (n : Nat) : Bool :=
+  n ≥ 2 && (List.range (n - 2)).all fun i => n % (i + 2) != 0
+
+structure Point where
+  x : Nat
+  y : Nat
+
+def Point.norm1 (p : Point) : Nat := p.x + p.y
+
+def collatz : Nat → Nat → Nat
+  | 0,     n => n
+  | f+1,   n => if n % 2 == 0 then collatz f (n / 2) else collatz f (3 * n + 1)
+
+axiom mystery : Nat
+
+#eval show MetaM Unit from do
+  checkNbe (← Meta.mkDecide (← Meta.mkEq (mkApp2 (mkConst ``Nat.add) (mkNatLit 2) (mkNatLit 2)) (mkNatLit 4)))
+  checkNbe (← Meta.mkDecide (← Meta.mkEq (mkApp (mkConst ``isPrime) (mkNatLit 97)) (mkConst ``Bool.true)))
+  checkNbe (← Meta.mkDecide (← Meta.mkEq (toExpr [1, 2, 3]) (toExpr [1, 2, 4])))
+  checkNbe (toExpr [1, 2, 3])
+  checkNbe (mkApp (mkConst ``isPrime) (mkNatLit 97))
+  checkNbe (mkApp (mkConst ``isPrime) (mkNatLit 91))
+  checkNbe (mkApp2 (mkConst ``Nat.beq) (mkApp (mkConst ``Point.norm1) (mkApp2 (mkConst ``Point.mk) (mkNatLit 3) (mkNatLit 4))) (mkNatLit 7))
+  checkNbe (mkApp2 (mkConst ``collatz) (mkNatLit 100) (mkNatLit 27))
+  checkNbe (mkApp2 (mkConst ``Nat.land) (mkNatLit 0xff00) (mkNatLit 0x0ff0))
+  checkNbe (mkLet `x (mkConst ``Nat) (mkNatLit 3) (mkApp2 (mkConst ``Nat.ble) (.bvar 0) (mkNatLit 2)))
+  -- stuck terms
+  checkNbe (mkApp2 (mkConst ``Nat.beq) (mkConst ``mystery) (mkNatLit 2)) (expectStuck := true)
+  checkNbe (mkApp2 (mkConst ``Nat.beq) (.bvar 0) (mkNatLit 2)) (expectStuck := true)
@@ -0,0 +1,19 @@
+import Lean
+open Lean
+
+def f (n : Nat) : Nat := n + 1
+
+#eval show CoreM Unit from do
+  let type := mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) (mkApp (mkConst ``f) (mkNatLit 1)) (mkNatLit 2)
+  let value := mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) (mkNatLit 2)
+  let decl := Declaration.thmDecl { name := `f_one, levelParams := [], type, value }
+  match (← getEnv).addDeclWithStats decl with
+  | .ok (env, stats) =>
+    unless env.contains `f_one do
+      throwError "declaration was not added"
+    unless stats.isDefEqCoreCalls > 0 && stats.unfoldings.any (·.1 == ``f) do
+      throwError "unexpected statistics\n{stats}"
+  | .error ex => throwKernelException ex
+
+set_option kernel.stats true in
+theorem f_two : f 2 = 3 := rfl
@@ -0,0 +1,55 @@
+import Lean
+open Lean
+
+/-!
+Differential test: the abstract machine used for beta/zeta reduction in the kernel `whnf_core`
+must produce the same results as the `instantiate`-based implementation.
+-/
+
+def checkWhnfCore (e : Expr) : CoreM Unit := do
+  let env ← getEnv
+  match Kernel.whnfCore env {} e false, Kernel.whnfCore env {} e true with
+  | .ok r₁, .ok r₂ =>
+    unless r₁ == r₂ do
+      throwError "whnfCore mismatch at{indentExpr e}\ninstantiate:{indentExpr r₁}\nmachine:{indentExpr r₂}"
+  | .error ex, _ | _, .error ex => throwKernelException ex
+
+def nat := mkConst ``Nat
+def lam (n : Name) (b : Expr) := mkLambda n .default nat b
+def app := mkAppN
+
+/-- `(fun x₁ ... xₙ => body) a₁ ... aₙ` where `body` refers to every `xᵢ`. -/
+def chain (n : Nat) : Expr := Id.run do
+  let mut body := mkNatLit 0
+  for i in [:n] do
+    body := mkApp2 (mkConst ``Nat.add) (.bvar i) body
+  for i in [:n] do
+    body := lam (Name.mkSimple s!"x{i}") body
+  return app body ((List.range n).map mkNatLit).toArray
+
+/-- `let x₀ := 0; let x₁ := x₀ + 1; ...; xₙ` -/
+def lets (n : Nat) : Expr := Id.run do
+  let mut body : Expr := .bvar 0
+  for i in [:n] do
+    body := mkLet (Name.mkSimple s!"x{n - i}") nat (mkApp2 (mkConst ``Nat.add) (.bvar 0) (mkNatLit 1)) body
+  return mkLet `x0 nat (mkNatLit 0) body
+
+#eval show CoreM Unit from do
+  -- simple redexes
+  checkWhnfCore (app (lam `x (.bvar 0)) #[mkNatLit 1])
+  checkWhnfCore (app (lam `x (lam `y (.bvar 1))) #[mkNatLit 1])
+  checkWhnfCore (app (lam `x (lam `y (.bvar 1))) #[mkNatLit 1, mkNatLit 2, mkNatLit 3])
+  checkWhnfCore (app (lam `f (app (.bvar 0) #[mkNatLit 1])) #[lam `x (lam `y (mkApp2 (mkConst ``Nat.add) (.bvar 0) (.bvar 1)))])
+  -- argument closures that capture the environment
+  checkWhnfCore (app (lam `x (app (lam `y (lam `z (mkApp2 (mkConst ``Nat.add) (.bvar 1) (.bvar 2)))) #[.bvar 0])) #[mkNatLit 7])
+  -- head is stuck after reduction, remaining arguments are read back
+  checkWhnfCore (app (lam `x (mkConst ``Nat.succ)) #[mkNatLit 1, mkNatLit 2])
+  -- `mdata` and `let`
+  checkWhnfCore (app (.mdata {} (lam `x (.mdata {} (.bvar 0)))) #[mkNatLit 1])
+  checkWhnfCore (mkLet `x nat (mkNatLit 1) (lam `y (.bvar 1)))
+  checkWhnfCore (app (mkLet `x nat (mkNatLit 1) (lam `y (mkApp2 (mkConst ``Nat.add) (.bvar 0) (.bvar 1)))) #[mkNatLit 2])
+  -- beta reduction exposing a projection and a recursor
+  checkWhnfCore (app (lam `p (.proj ``Prod 0 (.bvar 0))) #[mkApp4 (mkConst ``Prod.mk [levelOne, levelOne]) nat nat (mkNatLit 1) (mkNatLit 2)])
+  -- long chains
+  checkWhnfCore (chain 200)
+  checkWhnfCore (lets 200)
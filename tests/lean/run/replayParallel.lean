@@ -0,0 +1,42 @@
+import Lean
+import Lean.Replay
+open Lean
+
+def foo (n : Nat) : Nat := n + 1
+theorem foo_pos (n : Nat) : 0 < foo n := Nat.succ_pos n
+inductive T | a | b
+def T.toNat : T → Nat
+  | .a => 0
+  | .b => 1
+theorem T.toNat_le (t : T) : t.toNat ≤ 1 := by cases t <;> decide
+
+def replayLocal (newConstants : HashMap Name ConstantInfo) (parallel : Bool) : CoreM (Except String (Array Name)) := do
+  let base ← importModules (← getEnv).imports {}
+  try
+    let env ← base.replay newConstants (parallel := parallel)
+    return .ok <| newConstants.fold (init := #[]) fun ns n _ => if env.contains n then ns.push n else ns
+  catch ex =>
+    return .error (← ex.toMessageData.toString)
+
+def localConstants : CoreM (HashMap Name ConstantInfo) := do
+  return (← getEnv).constants.foldStage2 (fun m n c => m.insert n c) {}
+
+#eval show CoreM Unit from do
+  let newConstants ← localConstants
+  let seq ← replayLocal newConstants (parallel := false)
+  let par ← replayLocal newConstants (parallel := true)
+  -- auxiliary declarations of the code generator are not replayed
+  let expected := [``foo, ``foo_pos, ``T, ``T.a, ``T.rec, ``T.toNat, ``T.toNat_le]
+  match seq, par with
+  | .ok ns, .ok ns' => unless expected.all ns.contains && ns == ns' do throwError "unexpected result {ns} {ns'}"
+  | _, _ => throwError "replay failed"
+
+#eval show CoreM Unit from do
+  let bad : ConstantInfo := .thmInfo {
+    name := `bad, levelParams := [], type := mkConst ``False, value := mkConst ``True.intro, all := [`bad] }
+  let newConstants := (← localConstants).insert `bad bad
+  let seq ← replayLocal newConstants (parallel := false)
+  let par ← replayLocal newConstants (parallel := true)
+  match seq, par with
+  | .error msg, .error msg' => unless msg == msg' do throwError "different errors: {msg}, {msg'}"
+  | _, _ => throwError "bad theorem was not rejected"
@@ -0,0 +1,26 @@
+import Lean
+open Lean
+
+def test : CoreM Unit := do
+  let env ← getEnv
+  let fname : System.FilePath := "saveModuleDataUnchanged.olean"
+  writeModule env fname (keepUnchanged := true)
+  let contents := (← IO.FS.readBinFile fname).toList
+  let mtime := (← fname.metadata).modified
+  IO.sleep 10
+  -- writing the same data again must not touch the file
+  writeModule env fname (keepUnchanged := true)
+  unless (← IO.FS.readBinFile fname).toList == contents && (← fname.metadata).modified == mtime do
+    throwError "unchanged .olean file was rewritten"
+  -- by default, the file is always written, so that its modification time can be used by build systems
+  IO.sleep 10
+  writeModule env fname
+  if (← fname.metadata).modified == mtime then
+    throwError "unchanged .olean file was not rewritten by default"
+  -- changing the data must update the file
+  writeModule (env.setMainModule `Foo) fname (keepUnchanged := true)
+  if (← IO.FS.readBinFile fname).toList == contents then
+    throwError "modified .olean file was not rewritten"
+  IO.FS.removeFile fname
+
+#eval test